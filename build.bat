@@ -6,14 +6,44 @@ call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build
 set VCPKG_INC=C:\Users\user\github\vcpkg\installed\x64-windows-static\include
 set VCPKG_LIB=C:\Users\user\github\vcpkg\installed\x64-windows-static\lib
 
-cl.exe /W3 /WX- /std:c17 /MT /O2 /D_CRT_SECURE_NO_WARNINGS /DPCRE2_STATIC /Isrc /I%VCPKG_INC% ^
-    src\ccze.c src\color.c src\rules.c src\tool.c ^
+set CFLAGS=/nologo /W3 /WX- /std:c17 /MT /O2 /D_CRT_SECURE_NO_WARNINGS /DPCRE2_STATIC /Isrc /I%VCPKG_INC%
+
+if not exist obj mkdir obj
+
+REM libccze: the colorizing engine, usable on its own
+cl.exe %CFLAGS% /c src\libccze.c src\automaton.c src\check.c src\fanout.c src\ansi.c src\color.c src\filter.c src\rules.c src\tool.c src\wordcolor.c /Fo:obj\
+if errorlevel 1 goto failed
+lib.exe /nologo /OUT:libccze.lib obj\libccze.obj obj\automaton.obj obj\check.obj obj\fanout.obj obj\ansi.obj obj\color.obj obj\filter.obj obj\rules.obj obj\tool.obj obj\wordcolor.obj
+if errorlevel 1 goto failed
+
+REM conf2c: compiles ccze.conf into the default rule set of ccze.exe
+cl.exe %CFLAGS% tools\conf2c.c /Fo:obj\ /Fe:obj\conf2c.exe /link libccze.lib %VCPKG_LIB%\pcre2-8.lib
+if errorlevel 1 goto failed
+obj\conf2c.exe ccze.conf src\gen_rules.c
+if errorlevel 1 goto failed
+
+REM wordbench: wordcolor microbenchmark (obj\wordbench.exe [MB] [RULEFILE])
+cl.exe %CFLAGS% tools\wordbench.c /Fo:obj\ /Fe:obj\wordbench.exe /link libccze.lib %VCPKG_LIB%\pcre2-8.lib
+if errorlevel 1 goto failed
+
+REM rulebench: cost of 50/200/1000 rules with and without -o automaton (obj\rulebench.exe [MB])
+cl.exe %CFLAGS% tools\rulebench.c /Fo:obj\ /Fe:obj\rulebench.exe /link libccze.lib %VCPKG_LIB%\pcre2-8.lib
+if errorlevel 1 goto failed
+
+REM linebench: one 50 MB line on 1-8 line threads (obj\linebench.exe [MB] [RULEFILE] [THREADS])
+cl.exe %CFLAGS% tools\linebench.c /Fo:obj\ /Fe:obj\linebench.exe /link libccze.lib %VCPKG_LIB%\pcre2-8.lib
+if errorlevel 1 goto failed
+
+REM ccze.exe: thin CLI on top of libccze
+cl.exe %CFLAGS% src\ccze.c src\adapt.c src\batch.c src\gen_rules.c src\index.c src\input.c src\metrics.c src\pool.c src\record.c src\reload.c src\render.c src\serve.c src\spans.c src\stats.c src\tail.c src\tee.c /Fo:obj\ ^
     /Fe:ccze.exe ^
-    /link %VCPKG_LIB%\pcre2-8.lib
+    /link libccze.lib %VCPKG_LIB%\pcre2-8.lib ws2_32.lib
 
 if %errorlevel%==0 (
-    echo Build successful: ccze.exe
-) else (
-    echo Build FAILED
-    exit /b 1
+    echo Build successful: ccze.exe, libccze.lib
+    exit /b 0
 )
+
+:failed
+echo Build FAILED
+exit /b 1
@@ -0,0 +1,89 @@
+#include "adapt.h"
+#include <windows.h>
+#include <string.h>
+
+static long long ticks(void) {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+int adapt_init(Adapt *a, Input *in, FILE *fp) {
+    LARGE_INTEGER freq;
+
+    memset(a, 0, sizeof(*a));
+    if (input_backlog(in) < 0) return 0;
+    QueryPerformanceFrequency(&freq);
+    a->freq = freq.QuadPart;
+    a->fp = fp;
+    a->tier = CCZE_TIER_FULL;
+    a->window_start = ticks();
+    a->window_pos = in->pos;
+    /* Room for a flush's worth, so stdio doesn't write behind our back */
+    setvbuf(fp, NULL, _IOFBF, ADAPT_FLUSH * 2);
+    return 1;
+}
+
+static void adapt_flush(Adapt *a, const ColorOut *out) {
+    long long t0 = ticks();
+    fflush(a->fp);
+    a->write += ticks() - t0;
+    a->flushed = out->written;
+}
+
+static void adapt_decide(Adapt *a, Input *in, long long now) {
+    long long wall = now - a->window_start;
+    unsigned long long bytes = in->pos - a->window_pos;
+    int tier = a->tier;
+
+    /* Busy time includes output writes, so a slow terminal raises the
+     * cost of the tiers that write the most escape sequences */
+    if (bytes >= 4096) {
+        double cost = (double)(wall - a->idle) / (double)bytes;
+        a->cost[tier] = a->cost[tier] > 0 ? (a->cost[tier] + cost) / 2 : cost;
+    }
+    a->backlog = input_backlog(in);
+    a->write_share = (double)a->write / (double)wall;
+
+    if (!a->waited) {
+        a->calm = 0;
+        if (tier < CCZE_TIER_PLAIN) tier++;
+    } else if (tier > CCZE_TIER_FULL) {
+        double need = (double)bytes / (double)wall * a->cost[tier - 1];
+        a->calm++;
+        if (a->calm >= ADAPT_PROBE || (a->calm >= 2 && need < ADAPT_HEADROOM)) {
+            tier--;
+            a->calm = 0;
+        }
+    }
+    if (tier != (int)a->tier) {
+        a->tier = (CczeTier)tier;
+        a->changes++;
+    }
+
+    a->window_start = now;
+    a->window_pos = in->pos;
+    a->idle = a->write = 0;
+    a->waited = 0;
+}
+
+void adapt_step(Adapt *a, Input *in, const ColorOut *out) {
+    int check = (++a->lines & 63) == 0;
+    long long t0;
+
+    if (!input_wait(in, 0)) {
+        /* Caught up: nothing may sit in the output buffer while we wait */
+        adapt_flush(a, out);
+        t0 = ticks();
+        while (!input_wait(in, 1000)) {}
+        a->idle += ticks() - t0;
+        a->waited = check = 1;
+    } else if (out->written - a->flushed >= ADAPT_FLUSH) {
+        adapt_flush(a, out);
+    }
+
+    if (check) {
+        long long now = ticks();
+        if (now - a->window_start >= a->freq * ADAPT_WINDOW_MS / 1000) adapt_decide(a, in, now);
+    }
+}
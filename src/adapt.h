@@ -0,0 +1,56 @@
+#ifndef CCZE_ADAPT_H
+#define CCZE_ADAPT_H
+
+#include <stdio.h>
+#include "color.h"
+#include "input.h"
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Adaptive degradation (--adaptive)
+ *
+ * For piped input that can arrive faster than the terminal takes it.
+ * Before each line, adapt_step() notes whether ccze has caught up with
+ * the pipe (reading the next line would block); output is flushed before
+ * every such wait and after ADAPT_FLUSH bytes, and the flushes are timed.
+ * Every ADAPT_WINDOW_MS it picks the engine tier for the next window:
+ *
+ *   - a window that never caught up steps one tier down (cheaper);
+ *   - a window that did counts as calm. After two calm windows it steps
+ *     one tier up if that tier's measured cost per byte, at the current
+ *     input rate, fits in ADAPT_HEADROOM of the time; after ADAPT_PROBE
+ *     it steps up anyway to measure again.
+ * ---------------------------------------------------------------- */
+#define ADAPT_WINDOW_MS 250
+#define ADAPT_FLUSH     (64 * 1024)
+#define ADAPT_HEADROOM  0.5
+#define ADAPT_PROBE     20
+
+typedef struct {
+    volatile CczeTier  tier;
+    FILE              *fp;
+    long long          freq;
+    long long          window_start;
+    unsigned long long window_pos;  /* in->pos at window_start */
+    long long          idle;        /* ticks waiting for input, this window */
+    long long          write;       /* ticks in output flushes, this window */
+    int                waited;      /* caught up with the input this window */
+    int                calm;        /* calm windows in a row */
+    double             cost[CCZE_TIER_COUNT]; /* busy ticks per input byte */
+    unsigned long long flushed;     /* out->written at the last flush */
+    unsigned           lines;
+    /* The last window, for metrics */
+    volatile long long backlog;     /* bytes waiting in the pipe and buffer */
+    volatile double    write_share; /* of the time, spent writing output */
+    volatile unsigned long long changes;
+} Adapt;
+
+/* Start at CCZE_TIER_FULL. Returns 0 if in isn't a pipe. Call before
+ * anything is written to fp, whose buffer is enlarged. */
+int adapt_init(Adapt *a, Input *in, FILE *fp);
+
+/* Call before reading each line; may block until input arrives. The
+ * tier for the line is a->tier afterwards. */
+void adapt_step(Adapt *a, Input *in, const ColorOut *out);
+
+#endif /* CCZE_ADAPT_H */
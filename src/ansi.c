@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+
+/* ----------------------------------------------------------------
+ * Escape sequences in the input (--ansi)
+ *
+ * Lines from docker, systemd or a test runner often carry their own
+ * colors. Left alone, the rules match inside the sequences ("31m" is a
+ * number to wordcolor) and cut them apart. Callers look for ESC with
+ * memchr(), which the CRT vectorizes, so a line without one costs a
+ * single scan; a line with one is colorized without its sequences and
+ * they are put back in between the spans.
+ * ---------------------------------------------------------------- */
+#define ESC 0x1B
+
+size_t ansi_seq_len(const char *p, size_t len) {
+    const unsigned char *s = (const unsigned char *)p;
+    size_t i;
+
+    if (len < 2) return len;
+    switch (s[1]) {
+    case '[':
+        /* CSI: parameter bytes, intermediate bytes, one final byte */
+        for (i = 2; i < len && s[i] >= 0x30 && s[i] <= 0x3F; i++) {}
+        while (i < len && s[i] >= 0x20 && s[i] <= 0x2F) i++;
+        if (i < len && s[i] >= 0x40 && s[i] <= 0x7E) i++;
+        return i;
+    case ']': case 'P': case 'X': case '^': case '_':
+        /* OSC, DCS, SOS, PM, APC: a string up to BEL or ESC \; one
+         * that isn't ended stops at the end of the line */
+        for (i = 2; i < len && s[i] != '\n'; i++) {
+            if (s[i] == 0x07) return i + 1;
+            if (s[i] == ESC && i + 1 < len && s[i + 1] == '\\') return i + 2;
+        }
+        return i;
+    default:
+        /* Intermediate bytes, then one final byte */
+        for (i = 1; i < len && s[i] >= 0x20 && s[i] <= 0x2F; i++) {}
+        if (i < len && s[i] >= 0x30 && s[i] <= 0x7E) i++;
+        return i;
+    }
+}
+
+void ansi_split(const char *buf, size_t len, AnsiLine *al) {
+    size_t pos = 0;
+    int cap = 0;
+
+    al->text = (char *)malloc(len + 1);
+    al->len = 0;
+    al->seqs = NULL;
+    al->nseqs = 0;
+    while (pos < len) {
+        const char *e = (const char *)memchr(buf + pos, ESC, len - pos);
+        size_t run = e ? (size_t)(e - buf) - pos : len - pos;
+        AnsiSeq *q;
+
+        memcpy(al->text + al->len, buf + pos, run);
+        al->len += run;
+        pos += run;
+        if (!e) break;
+        if (al->nseqs == cap) {
+            cap = cap ? cap * 2 : 8;
+            al->seqs = (AnsiSeq *)realloc(al->seqs, cap * sizeof(AnsiSeq));
+        }
+        q = &al->seqs[al->nseqs++];
+        q->at = al->len;
+        q->from = pos;
+        q->len = ansi_seq_len(buf + pos, len - pos);
+        pos += q->len;
+    }
+    al->text[al->len] = '\0';
+}
+
+void ansi_free(AnsiLine *al) {
+    free(al->text);
+    free(al->seqs);
+}
+
+/* ----------------------------------------------------------------
+ * Spans of the stripped text, mapped back onto the line
+ * ---------------------------------------------------------------- */
+typedef struct {
+    const AnsiLine *al;
+    const char     *buf;
+    CczeSpanFn      fn;
+    void           *ud;
+    CczeSpanKind    kind;   /* CCZE_SPAN_ANSI, or CCZE_SPAN_HIDDEN to strip */
+    int             next;   /* first sequence not yet reported */
+    size_t          shift;  /* bytes of the sequences reported so far */
+} AnsiMap;
+
+static void map_seq(AnsiMap *m) {
+    const AnsiSeq *q = &m->al->seqs[m->next++];
+    CczeSpan sp;
+
+    sp.offset = q->from;
+    sp.length = q->len;
+    sp.color = COL_RESET;
+    sp.kind = m->kind;
+    sp.rule_id = 0;
+    m->fn(m->buf, &sp, m->ud);
+    m->shift += q->len;
+}
+
+static void map_span(const char *text, const CczeSpan *sp, void *ud) {
+    AnsiMap *m = (AnsiMap *)ud;
+    size_t pos = sp->offset, end = sp->offset + sp->length;
+    CczeSpan out = *sp;
+
+    (void)text;
+    while (pos < end) {
+        size_t stop = end;
+        while (m->next < m->al->nseqs && m->al->seqs[m->next].at == pos) map_seq(m);
+        if (m->next < m->al->nseqs && m->al->seqs[m->next].at < end)
+            stop = m->al->seqs[m->next].at;
+        out.offset = pos + m->shift;
+        out.length = stop - pos;
+        m->fn(m->buf, &out, m->ud);
+        pos = stop;
+    }
+}
+
+void ansi_colorize(const Ccze *h, const char *buf, size_t len, CczeTier tier,
+                   CczeSpanFn fn, void *ud, CczeTimes *t) {
+    AnsiLine al;
+    AnsiMap m;
+
+    ansi_split(buf, len, &al);
+    m.al = &al;
+    m.buf = buf;
+    m.fn = fn;
+    m.ud = ud;
+    m.kind = h->ansi == CCZE_ANSI_KEEP ? CCZE_SPAN_ANSI : CCZE_SPAN_HIDDEN;
+    m.next = 0;
+    m.shift = 0;
+    ccze_colorize_tier(h, al.text, al.len, tier, map_span, &m, t);
+    /* Sequences after the last character */
+    while (m.next < al.nseqs) map_seq(&m);
+    ansi_free(&al);
+}
@@ -0,0 +1,1058 @@
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+
+/* ----------------------------------------------------------------
+ * Rule automaton (-o automaton)
+ *
+ * PCRE2 runs each rule over each line, so a line costs more with every
+ * rule added, even when none of them match. Here the rules are parsed
+ * into one Thompson NFA and turned into a DFA over byte classes, built
+ * in full when the engine is opened. One pass over a line then tells
+ * which rules can match it, and only those go to PCRE2, which still
+ * finds the matches.
+ *
+ * The automaton only has to be generous: it may name a rule that PCRE2
+ * then doesn't match, but never misses one that does. So \b, ^, $,
+ * lookaround and \K are taken to always hold, backreferences and \p
+ * match anything, counted repeats beyond AUTO_MAX_REPEAT are loosened,
+ * and each rule is cut down to its most telling run of literals and
+ * narrow classes (see factor()). Rules the parser doesn't take (verbs,
+ * conditionals) and rules that can match the empty string always go to
+ * PCRE2. When the rules together would need more than AUTO_MAX_STATES
+ * DFA states, they are split into groups with a DFA each.
+ * ---------------------------------------------------------------- */
+
+#define AUTO_MAX_NFA    4096   /* NFA states per rule */
+#define AUTO_MAX_REPEAT 16     /* x{n,m}: larger counts become x{16,} */
+#define AUTO_MAX_STATES 4096   /* DFA states per group */
+
+typedef unsigned char ByteSet[32];
+
+#define SET_HAS(s, c) ((s)[(c) >> 3] & (1 << ((c) & 7)))
+#define SET_ADD(s, c) ((s)[(c) >> 3] |= (unsigned char)(1 << ((c) & 7)))
+
+/* ----------------------------------------------------------------
+ * Parsing: pattern -> syntax tree
+ * ---------------------------------------------------------------- */
+typedef enum { N_SET, N_CAT, N_ALT, N_REP } NodeType;
+
+typedef struct {
+    NodeType type;
+    int      set;        /* N_SET */
+    int      a, b;       /* N_CAT, N_ALT; N_REP repeats a; -1 is empty */
+    int      min, max;   /* N_REP; max -1 is unbounded */
+} Node;
+
+typedef struct {
+    const char *p;
+    int         caseless;
+    int         extended;    /* (?x): whitespace and # comments ignored */
+    int         ok;
+    Node       *nodes;
+    int         nnodes, cap;
+    ByteSet    *sets;    /* shared by all rules */
+    int        *nsets, *setcap;
+} Parser;
+
+static int node_new(Parser *P, NodeType type, int a, int b) {
+    Node *n;
+    if (P->nnodes == P->cap) {
+        P->cap = P->cap ? P->cap * 2 : 64;
+        P->nodes = (Node *)realloc(P->nodes, P->cap * sizeof(Node));
+    }
+    n = &P->nodes[P->nnodes];
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    n->a = a;
+    n->b = b;
+    return P->nnodes++;
+}
+
+static int cat(Parser *P, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return node_new(P, N_CAT, a, b);
+}
+
+static int set_node(Parser *P, const ByteSet s) {
+    int n = node_new(P, N_SET, -1, -1);
+    if (*P->nsets == *P->setcap) {
+        *P->setcap = *P->setcap ? *P->setcap * 2 : 64;
+        P->sets = (ByteSet *)realloc(P->sets, *P->setcap * sizeof(ByteSet));
+    }
+    memcpy(P->sets[*P->nsets], s, sizeof(ByteSet));
+    P->nodes[n].set = (*P->nsets)++;
+    return n;
+}
+
+static void set_range(ByteSet s, int lo, int hi) {
+    int c;
+    for (c = lo; c <= hi; c++) SET_ADD(s, c);
+}
+
+static void set_fold(ByteSet s) {
+    int c;
+    for (c = 'a'; c <= 'z'; c++)
+        if (SET_HAS(s, c) || SET_HAS(s, c - 32)) {
+            SET_ADD(s, c);
+            SET_ADD(s, c - 32);
+        }
+}
+
+static void set_invert(ByteSet s) {
+    int i;
+    for (i = 0; i < 32; i++) s[i] = (unsigned char)~s[i];
+}
+
+/* \d \w \s \h \v and their negations, as PCRE2 defines them without UTF */
+static int set_class_escape(ByteSet s, char e) {
+    ByteSet t;
+    int i;
+    memset(t, 0, sizeof(t));
+    switch (e | 0x20) {
+    case 'd': set_range(t, '0', '9'); break;
+    case 'w': set_range(t, '0', '9'); set_range(t, 'a', 'z'); set_range(t, 'A', 'Z'); SET_ADD(t, '_'); break;
+    case 's': set_range(t, 9, 13); SET_ADD(t, ' '); break;
+    case 'h': SET_ADD(t, 9); SET_ADD(t, ' '); SET_ADD(t, 0xa0); break;
+    case 'v': set_range(t, 10, 13); SET_ADD(t, 0x85); break;
+    default: return 0;
+    }
+    if (e >= 'A' && e <= 'Z') set_invert(t);
+    for (i = 0; i < 32; i++) s[i] |= t[i];
+    return 1;
+}
+
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') return (c | 0x20) - 'a' + 10;
+    return -1;
+}
+
+/* A character escape (after the backslash); -1 if it isn't one */
+static int char_escape(Parser *P) {
+    char e = *P->p++;
+    int v = 0, n;
+    switch (e) {
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    case 'f': return '\f';
+    case 'e': return 27;
+    case 'a': return 7;
+    case 'x':
+        if (*P->p == '{') {
+            for (P->p++; hexval(*P->p) >= 0; P->p++) v = v * 16 + hexval(*P->p);
+            if (*P->p++ != '}' || v > 255) return -1;
+            return v;
+        }
+        for (n = 0; n < 2 && hexval(*P->p) >= 0; n++, P->p++) v = v * 16 + hexval(*P->p);
+        return v;
+    case '0':
+        for (n = 0; n < 2 && *P->p >= '0' && *P->p <= '7'; n++, P->p++) v = v * 8 + (*P->p - '0');
+        return v;
+    default:
+        /* Escaped punctuation stands for itself; unknown letters don't parse */
+        if ((e >= 'a' && e <= 'z') || (e >= 'A' && e <= 'Z') || (e >= '0' && e <= '9') || !e)
+            return -1;
+        return (unsigned char)e;
+    }
+}
+
+static int posix_class(Parser *P, ByteSet s) {
+    /* Ranges as pairs of ends; NUL, which a string can't hold, is added below */
+    static const struct { const char *name; const char *ranges; } classes[] = {
+        { "alpha", "azAZ" }, { "digit", "09" }, { "alnum", "azAZ09" }, { "upper", "AZ" },
+        { "lower", "az" }, { "xdigit", "09afAF" }, { "word", "azAZ09__" }, { "space", "\t\r  " },
+        { "blank", "\t\t  " }, { "punct", "!/:@[`{~" }, { "cntrl", "\x01\x1f\x7f\x7f" },
+        { "graph", "!~" }, { "print", " ~" }, { "ascii", "\x01\x7f" },
+    };
+    ByteSet t;
+    const char *end = strstr(P->p, ":]");
+    int neg = P->p[2] == '^', i, k;
+    const char *name = P->p + 2 + neg;
+
+    if (!end) return 0;
+    memset(t, 0, sizeof(t));
+    for (i = 0; i < (int)(sizeof(classes) / sizeof(classes[0])); i++) {
+        const char *rg = classes[i].ranges;
+        if ((size_t)(end - name) != strlen(classes[i].name) || strncmp(name, classes[i].name, end - name))
+            continue;
+        for (k = 0; rg[k]; k += 2) set_range(t, (unsigned char)rg[k], (unsigned char)rg[k + 1]);
+        if (!strcmp(classes[i].name, "cntrl") || !strcmp(classes[i].name, "ascii")) SET_ADD(t, 0);
+        if (neg) set_invert(t);
+        for (k = 0; k < 32; k++) s[k] |= t[k];
+        P->p = end + 2;
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_class(Parser *P) {
+    ByteSet s;
+    int neg = 0, first = 1;
+
+    memset(s, 0, sizeof(s));
+    if (*P->p == '^') { neg = 1; P->p++; }
+    for (;;) {
+        int lo, hi;
+        if (!*P->p) { P->ok = 0; return -1; }
+        if (*P->p == ']' && !first) { P->p++; break; }
+        first = 0;
+        if (P->p[0] == '[' && P->p[1] == ':') {
+            if (!posix_class(P, s)) { P->ok = 0; return -1; }
+            continue;
+        }
+        if (*P->p == '\\') {
+            P->p++;
+            if (set_class_escape(s, *P->p)) { P->p++; continue; }
+            if (*P->p == 'b') { P->p++; lo = 8; }
+            else if ((lo = char_escape(P)) < 0) { P->ok = 0; return -1; }
+        } else {
+            lo = (unsigned char)*P->p++;
+        }
+        hi = lo;
+        if (P->p[0] == '-' && P->p[1] && P->p[1] != ']') {
+            P->p++;
+            if (*P->p == '\\') {
+                P->p++;
+                if (*P->p == 'b') { P->p++; hi = 8; }
+                else if ((hi = char_escape(P)) < 0) { P->ok = 0; return -1; }
+            } else {
+                hi = (unsigned char)*P->p++;
+            }
+            if (hi < lo) { P->ok = 0; return -1; }
+        }
+        set_range(s, lo, hi);
+    }
+    if (P->caseless) set_fold(s);
+    if (neg) set_invert(s);
+    return set_node(P, s);
+}
+
+static int literal(Parser *P, int c) {
+    ByteSet s;
+    memset(s, 0, sizeof(s));
+    SET_ADD(s, c);
+    if (P->caseless) set_fold(s);
+    return set_node(P, s);
+}
+
+static int parse_alt(Parser *P);
+
+/* "(?" flags, either "(?i)" for the rest of the group or "(?i:". The
+ * caller restores them where the group ends. */
+static int parse_flags(Parser *P, int *scoped) {
+    int on = 1;
+    for (;; P->p++) {
+        char c = *P->p;
+        if (c == ')' || c == ':') break;
+        if (c == '-') on = 0;
+        else if (c == 'i') P->caseless = on;
+        else if (c == 'x') P->extended = on;
+        else if (!c || !strchr("smnUJ", c)) return 0;
+    }
+    *scoped = *P->p++ == ':';
+    return 1;
+}
+
+/* Any text at all: stands in for what the automaton can't follow */
+static int anything(Parser *P) {
+    ByteSet s;
+    int n;
+    memset(s, 0xff, sizeof(s));
+    n = node_new(P, N_REP, set_node(P, s), -1);
+    P->nodes[n].min = 0;
+    P->nodes[n].max = -1;
+    return n;
+}
+
+/* Skip a name or number in the given brackets, as after \g or \k */
+static void skip_ref(Parser *P) {
+    const char *close = *P->p == '{' ? "}" : *P->p == '<' ? ">" : *P->p == '\'' ? "'" : NULL;
+    if (close) {
+        const char *end = strstr(P->p, close);
+        P->p = end ? end + 1 : P->p + strlen(P->p);
+    } else {
+        if (*P->p == '-' || *P->p == '+') P->p++;
+        while (*P->p >= '0' && *P->p <= '9') P->p++;
+    }
+}
+
+static int parse_group(Parser *P) {
+    int saved = P->caseless, saved_x = P->extended, n, assertion = 0;
+
+    if (*P->p == '*') { P->ok = 0; return -1; }
+    if (*P->p == '?') {
+        char c = *++P->p;
+        if (c == '#') {
+            while (*P->p && *P->p != ')') P->p++;
+            if (*P->p) P->p++;
+            return -1;
+        }
+        if (c == '=' || c == '!') {
+            /* Lookaround only narrows a match; taken to hold */
+            P->p++;
+            assertion = 1;
+        } else if (c == '<' && (P->p[1] == '=' || P->p[1] == '!')) {
+            P->p += 2;
+            assertion = 1;
+        } else if (c == ':' || c == '>' || c == '|') {
+            P->p++;
+        } else if (c == '<' || c == '\'' || (c == 'P' && P->p[1] == '<')) {
+            const char *end = strchr(P->p, c == '\'' ? '\'' : '>');
+            if (!end) { P->ok = 0; return -1; }
+            P->p = end + 1;
+        } else if (c == 'R' || c == '&' || (c >= '0' && c <= '9') || c == '+' ||
+                   (c == '-' && P->p[1] >= '0' && P->p[1] <= '9') ||
+                   (c == 'P' && (P->p[1] == '>' || P->p[1] == '='))) {
+            /* Recursion into a group, or (?P=name) */
+            const char *end = strchr(P->p, ')');
+            if (!end) { P->ok = 0; return -1; }
+            P->p = end + 1;
+            return anything(P);
+        } else if (c == 'C') {
+            const char *end = strchr(P->p, ')');
+            if (!end) { P->ok = 0; return -1; }
+            P->p = end + 1;
+            return -1;
+        } else {
+            int scoped, f = parse_flags(P, &scoped);
+            if (!f) { P->ok = 0; return -1; }
+            if (!scoped) return -1;
+        }
+    }
+    n = parse_alt(P);
+    if (*P->p != ')') { P->ok = 0; return -1; }
+    P->p++;
+    P->caseless = saved;
+    P->extended = saved_x;
+    return assertion ? -1 : n;
+}
+
+static int parse_escape(Parser *P) {
+    ByteSet s;
+    char e = *P->p;
+    int c;
+
+    memset(s, 0, sizeof(s));
+    if (set_class_escape(s, e)) {
+        P->p++;
+        return set_node(P, s);
+    }
+    if (e && strchr("bBAzZGEK", e)) {
+        /* Assertions are taken to hold; \K only moves the start */
+        P->p++;
+        return -1;
+    }
+    if (e >= '1' && e <= '9') {
+        /* A backreference can be anything the group matched */
+        while (*P->p >= '0' && *P->p <= '9') P->p++;
+        return anything(P);
+    }
+    if (e == 'g' || e == 'k') {
+        P->p++;
+        skip_ref(P);
+        return anything(P);
+    }
+    if (e == 'p' || e == 'P' || e == 'C') {
+        /* One character of a Unicode property, or any byte */
+        P->p++;
+        if (e != 'C') skip_ref(P);
+        if (e != 'C' && *P->p && P->p[-1] != '}') P->p++;
+        memset(s, 0xff, sizeof(s));
+        return set_node(P, s);
+    }
+    if (e == 'X') {
+        P->p++;
+        return anything(P);
+    }
+    if (e == 'N') {
+        P->p++;
+        memset(s, 0xff, sizeof(s));
+        s['\n' >> 3] &= (unsigned char)~(1 << ('\n' & 7));
+        return set_node(P, s);
+    }
+    if (e == 'R') {
+        /* \r\n or one vertical space */
+        int n;
+        P->p++;
+        set_range(s, 10, 13);
+        SET_ADD(s, 0x85);
+        n = node_new(P, N_REP, set_node(P, s), -1);
+        P->nodes[n].min = 1;
+        P->nodes[n].max = 2;
+        return n;
+    }
+    if (e == 'c' && P->p[1]) {
+        c = (unsigned char)P->p[1];
+        P->p += 2;
+        return literal(P, (c >= 'a' && c <= 'z' ? c - 32 : c) ^ 0x40);
+    }
+    if (e == 'Q') {
+        const char *end = strstr(++P->p, "\\E");
+        int n = -1;
+        if (!end) end = P->p + strlen(P->p);
+        while (P->p < end) n = cat(P, n, literal(P, (unsigned char)*P->p++));
+        if (*P->p) P->p += 2;
+        return n;
+    }
+    if ((c = char_escape(P)) < 0) { P->ok = 0; return -1; }
+    return literal(P, c);
+}
+
+static int parse_atom(Parser *P) {
+    char c = *P->p++;
+    ByteSet s;
+
+    switch (c) {
+    case '(': return parse_group(P);
+    case '[': return parse_class(P);
+    case '\\': return parse_escape(P);
+    case '^': case '$': return -1;
+    case '.':
+        memset(s, 0xff, sizeof(s));   /* PCRE2_DOTALL */
+        return set_node(P, s);
+    case '*': case '+': case '?':
+        P->ok = 0;
+        return -1;
+    default:
+        return literal(P, (unsigned char)c);
+    }
+}
+
+/* Only digits, commas and blanks up to a closing brace */
+static int count_like(const char *q) {
+    for (; *q && *q != '}'; q++)
+        if (!(*q >= '0' && *q <= '9') && *q != ',' && *q != ' ' && *q != '\t') return 0;
+    return *q == '}';
+}
+
+/* {n}, {n,} or {n,m}; anything else after '{' is a literal, except that
+ * {,m} and counts with blanks in them are quantifiers from PCRE2 10.43
+ * on, so a rule with one is left to PCRE2 */
+static int parse_count(Parser *P, int *min, int *max) {
+    const char *q = P->p + 1;
+    int n = 0, m;
+    if (*q < '0' || *q > '9') goto literal;
+    while (*q >= '0' && *q <= '9') n = n * 10 + (*q++ - '0');
+    m = n;
+    if (*q == ',') {
+        q++;
+        if (*q == '}') {
+            m = -1;
+        } else {
+            if (*q < '0' || *q > '9') goto literal;
+            for (m = 0; *q >= '0' && *q <= '9'; q++) m = m * 10 + (*q - '0');
+        }
+    }
+    if (*q != '}' || (m >= 0 && m < n)) goto literal;
+    P->p = q + 1;
+    *min = n;
+    *max = m;
+    return 1;
+
+literal:
+    if (count_like(P->p + 1)) P->ok = 0;
+    return 0;
+}
+
+static void skip_space(Parser *P) {
+    while (P->extended) {
+        if (*P->p == ' ' || (*P->p >= '\t' && *P->p <= '\r')) {
+            P->p++;
+        } else if (*P->p == '#') {
+            while (*P->p && *P->p != '\n') P->p++;
+        } else {
+            break;
+        }
+    }
+}
+
+static int parse_seq(Parser *P) {
+    int seq = -1;
+
+    for (skip_space(P); P->ok && *P->p && *P->p != '|' && *P->p != ')'; skip_space(P)) {
+        int atom, min, max, n;
+        if (*P->p == '{' && parse_count(P, &min, &max)) { P->ok = 0; break; }
+        atom = parse_atom(P);
+        for (;;) {
+            skip_space(P);
+            if (*P->p == '*')      { min = 0; max = -1; P->p++; }
+            else if (*P->p == '+') { min = 1; max = -1; P->p++; }
+            else if (*P->p == '?') { min = 0; max = 1; P->p++; }
+            else if (*P->p != '{' || !parse_count(P, &min, &max)) break;
+            /* Lazy and possessive forms match no strings the greedy one can't */
+            if (*P->p == '?' || *P->p == '+') P->p++;
+            if (atom < 0) continue;
+            if (min > AUTO_MAX_REPEAT) { min = AUTO_MAX_REPEAT; max = -1; }
+            if (max > AUTO_MAX_REPEAT) max = -1;
+            n = node_new(P, N_REP, atom, -1);
+            P->nodes[n].min = min;
+            P->nodes[n].max = max;
+            atom = n;
+        }
+        seq = cat(P, seq, atom);
+    }
+    return seq;
+}
+
+static int parse_alt(Parser *P) {
+    int n = parse_seq(P);
+    while (P->ok && *P->p == '|') {
+        int m;
+        P->p++;
+        m = parse_seq(P);
+        /* An empty branch makes the whole alternation optional */
+        if (n < 0 || m < 0) {
+            int r = node_new(P, N_REP, n < 0 ? m : n, -1);
+            P->nodes[r].min = 0;
+            P->nodes[r].max = 1;
+            n = n < 0 && m < 0 ? -1 : r;
+        } else {
+            n = node_new(P, N_ALT, n, m);
+        }
+    }
+    return n;
+}
+
+/* ----------------------------------------------------------------
+ * Cutting rules down
+ *
+ * A match of a sequence holds a match of any run of its items, so a
+ * rule can be looked for by its most telling run: "[^"]*timeout[^"]*"
+ * by timeout. Loops over broad classes are left out that way; in the
+ * DFA they stay live through the rest of the line and multiply the
+ * states of every other rule.
+ * ---------------------------------------------------------------- */
+#define AUTO_ENOUGH_BITS 24    /* a run this telling needs no more items */
+
+/* How telling one character of s is: 8 for one byte, 0 for any */
+static int set_bits(const ByteSet s) {
+    int n = 0, c, bits = 8, k;
+    for (c = 0; c < 256; c++) n += SET_HAS(s, c) != 0;
+    for (k = 1; k < n; k <<= 1) bits--;
+    return bits;
+}
+
+static int node_bits(const Parser *P, int n) {
+    const Node *nd;
+    int a, b;
+    if (n < 0) return 0;
+    nd = &P->nodes[n];
+    switch (nd->type) {
+    case N_SET: return set_bits(P->sets[nd->set]);
+    case N_CAT: return node_bits(P, nd->a) + node_bits(P, nd->b);
+    case N_ALT:
+        a = node_bits(P, nd->a);
+        b = node_bits(P, nd->b);
+        return a < b ? a : b;
+    case N_REP: return nd->min * node_bits(P, nd->a);
+    }
+    return 0;
+}
+
+/* Holds a loop over a class of more than 64 bytes */
+static int broad(const Parser *P, int n) {
+    const Node *nd;
+    if (n < 0) return 0;
+    nd = &P->nodes[n];
+    switch (nd->type) {
+    case N_SET: return 0;
+    case N_CAT: case N_ALT: return broad(P, nd->a) || broad(P, nd->b);
+    case N_REP: return (nd->max < 0 && node_bits(P, nd->a) <= 1) || broad(P, nd->a);
+    }
+    return 0;
+}
+
+static void flatten(const Parser *P, int n, int **items, int *nitems, int *cap) {
+    if (n < 0) return;
+    if (P->nodes[n].type == N_CAT) {
+        flatten(P, P->nodes[n].a, items, nitems, cap);
+        flatten(P, P->nodes[n].b, items, nitems, cap);
+        return;
+    }
+    if (*nitems == *cap) *items = (int *)realloc(*items, (*cap = *cap ? *cap * 2 : 16) * sizeof(int));
+    (*items)[(*nitems)++] = n;
+}
+
+/* The part of n to look for; -1 if nothing in it is worth it */
+static int factor(Parser *P, int n) {
+    int *items = NULL, nitems = 0, cap = 0;
+    int i, j, best_i = -1, best_j = -1, best_bits = 0, best_enough = 0, out = -1;
+
+    if (n < 0) return -1;
+    if (P->nodes[n].type == N_ALT) {
+        int a = factor(P, P->nodes[n].a), b = factor(P, P->nodes[n].b);
+        return a < 0 || b < 0 ? -1 : node_new(P, N_ALT, a, b);
+    }
+    flatten(P, n, &items, &nitems, &cap);
+    for (i = 0; i < nitems; i++) {
+        int bits = 0, last = -1, enough = 0;
+        for (j = i; j < nitems && !broad(P, items[j]); j++) {
+            int b = node_bits(P, items[j]);
+            bits += b;
+            if (b > 0) last = j;
+            if (bits >= AUTO_ENOUGH_BITS) { enough = 1; break; }
+        }
+        if (last < 0) continue;
+        /* Enough beats not enough; then fewer items, or more bits */
+        if (best_i < 0 || enough > best_enough ||
+            (enough == best_enough && enough && (last - i < best_j - best_i ||
+                                                 (last - i == best_j - best_i && bits > best_bits))) ||
+            (enough == best_enough && !enough && bits > best_bits)) {
+            best_i = i;
+            best_j = last;
+            best_bits = bits;
+            best_enough = enough;
+        }
+    }
+    for (i = best_i; i >= 0 && i <= best_j; i++) out = cat(P, out, items[i]);
+    free(items);
+    return out;
+}
+
+/* ----------------------------------------------------------------
+ * Syntax tree -> NFA
+ *
+ * Built back to front: each node is compiled with the state that
+ * follows it already known.
+ * ---------------------------------------------------------------- */
+typedef enum { S_SET, S_SPLIT, S_MATCH } StateType;
+
+typedef struct {
+    StateType type;
+    int       set;       /* S_SET */
+    int       out, out1; /* S_SPLIT takes both */
+    int       rule;
+} NState;
+
+typedef struct {
+    NState *st;
+    int     n, cap;
+    int     limit;       /* fail past this many states */
+    int     rule;
+} Nfa;
+
+static int state_new(Nfa *N, StateType type, int set, int out, int out1) {
+    if (N->n >= N->limit) return -1;
+    if (N->n == N->cap) {
+        N->cap = N->cap ? N->cap * 2 : 256;
+        N->st = (NState *)realloc(N->st, N->cap * sizeof(NState));
+    }
+    N->st[N->n].type = type;
+    N->st[N->n].set = set;
+    N->st[N->n].out = out;
+    N->st[N->n].out1 = out1;
+    N->st[N->n].rule = N->rule;
+    return N->n++;
+}
+
+static int compile(Nfa *N, const Node *nodes, int node, int next) {
+    const Node *nd;
+    int e, s, i;
+
+    if (node < 0 || next < 0) return next;
+    nd = &nodes[node];
+    switch (nd->type) {
+    case N_SET:
+        return state_new(N, S_SET, nd->set, next, -1);
+    case N_CAT:
+        return compile(N, nodes, nd->a, compile(N, nodes, nd->b, next));
+    case N_ALT:
+        e = compile(N, nodes, nd->a, next);
+        s = compile(N, nodes, nd->b, next);
+        return e < 0 || s < 0 ? -1 : state_new(N, S_SPLIT, -1, e, s);
+    case N_REP:
+        e = next;
+        if (nd->max < 0) {
+            /* x* loops through a split that was made before its body */
+            if ((s = state_new(N, S_SPLIT, -1, -1, next)) < 0) return -1;
+            if ((e = compile(N, nodes, nd->a, s)) < 0) return -1;
+            N->st[s].out = e;
+            e = s;
+        } else {
+            for (i = nd->min; i < nd->max && e >= 0; i++) {
+                int body = compile(N, nodes, nd->a, e);
+                e = body < 0 ? -1 : state_new(N, S_SPLIT, -1, body, next);
+            }
+        }
+        for (i = 0; i < nd->min && e >= 0; i++) e = compile(N, nodes, nd->a, e);
+        return e;
+    }
+    return -1;
+}
+
+/* ----------------------------------------------------------------
+ * NFA -> DFA, one group of rules at a time
+ * ---------------------------------------------------------------- */
+typedef struct {
+    unsigned char cls[256];   /* byte -> class */
+    int           nclass;
+    int           nstates;
+    int          *next;       /* [state * nclass + class] */
+    int          *acc;        /* rules accepted in state d: acc_rules[acc[d] .. acc[d+1]) */
+    int          *acc_rules;
+} AutoGroup;
+
+struct Automaton {
+    AutoGroup     *groups;
+    int            ngroups;
+    unsigned char *covered;   /* per rule: found through the automaton */
+    int            nrules;
+};
+
+typedef struct {
+    const Nfa     *nfa;
+    const ByteSet *sets;
+    int           *mark;      /* per NFA state: == gen when in the set being built */
+    int            gen;
+    unsigned char *implied;   /* per NFA state: in every DFA state, never stored */
+    int           *stack;
+    int           *buf;       /* the set being built */
+    int            nbuf;
+} Builder;
+
+/* Add the SET and MATCH states reachable from s without input */
+static void closure(Builder *B, int s) {
+    int sp = 0;
+    B->stack[sp++] = s;
+    while (sp) {
+        const NState *st;
+        s = B->stack[--sp];
+        if (B->mark[s] == B->gen || (B->implied && B->implied[s])) continue;
+        B->mark[s] = B->gen;
+        st = &B->nfa->st[s];
+        if (st->type == S_SPLIT) {
+            B->stack[sp++] = st->out1;
+            B->stack[sp++] = st->out;
+        } else {
+            B->buf[B->nbuf++] = s;
+        }
+    }
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    int     *pool;            /* DFA state sets, back to back */
+    size_t   npool, poolcap;
+    size_t  *start;           /* set of state d: pool[start[d] .. start[d+1]) */
+    int     *hash;            /* open addressing, -1 empty */
+    int      hcap;
+} StateTable;
+
+static unsigned set_hash(const int *s, int n) {
+    unsigned h = 2166136261u;
+    int i;
+    for (i = 0; i < n; i++) h = (h ^ (unsigned)s[i]) * 16777619u;
+    return h;
+}
+
+/* Id of the DFA state for the sorted set s, adding it if new */
+static int state_find(StateTable *T, int *nstates, const int *s, int n) {
+    unsigned h = set_hash(s, n) & (unsigned)(T->hcap - 1);
+    int d;
+    for (; (d = T->hash[h]) >= 0; h = (h + 1) & (unsigned)(T->hcap - 1)) {
+        size_t len = T->start[d + 1] - T->start[d];
+        if ((int)len == n && !memcmp(T->pool + T->start[d], s, n * sizeof(int))) return d;
+    }
+    d = (*nstates)++;
+    if (d >= AUTO_MAX_STATES) return -1;
+    if (T->npool + n > T->poolcap) {
+        while (T->npool + n > T->poolcap) T->poolcap = T->poolcap ? T->poolcap * 2 : 1024;
+        T->pool = (int *)realloc(T->pool, T->poolcap * sizeof(int));
+    }
+    memcpy(T->pool + T->npool, s, n * sizeof(int));
+    T->npool += n;
+    T->start[d + 1] = T->npool;
+    T->hash[h] = d;
+    return d;
+}
+
+/* Group byte values that every set in use treats alike */
+static void byte_classes(AutoGroup *g, const Nfa *N, const ByteSet *sets, const int *in_group) {
+    int in[256], out[256], s, c;
+    unsigned char rep[256];
+    int used = 0;
+
+    memset(g->cls, 0, sizeof(g->cls));
+    g->nclass = 1;
+    for (s = 0; s < N->n; s++) {
+        const NState *st = &N->st[s];
+        if (st->type != S_SET || !in_group[st->rule]) continue;
+        memset(in, -1, sizeof(in));
+        memset(out, -1, sizeof(out));
+        used = 0;
+        for (c = 0; c < 256; c++) {
+            int *slot = SET_HAS(sets[st->set], c) ? &in[g->cls[c]] : &out[g->cls[c]];
+            if (*slot < 0) *slot = used++;
+            rep[c] = (unsigned char)*slot;
+        }
+        memcpy(g->cls, rep, sizeof(rep));
+        g->nclass = used;
+    }
+}
+
+static void builder_step(Builder *B, const int *s, int n, int c) {
+    int i;
+    for (i = 0; i < n; i++) {
+        const NState *st = &B->nfa->st[s[i]];
+        if (st->type == S_SET && SET_HAS(B->sets[st->set], c)) closure(B, st->out);
+    }
+}
+
+static int build_group(AutoGroup *g, const Nfa *N, const ByteSet *sets, const int *entry,
+                       const int *rules, int nr, int nrules) {
+    Builder B;
+    StateTable T;
+    int *in_group = (int *)calloc(nrules, sizeof(int));
+    int *start_set, nstart, nstates = 0, d, c, i, ok = 1;
+    int *step_at, *step_pool;
+    int *rep = (int *)malloc(256 * sizeof(int));
+    int *matched = (int *)calloc(nrules, sizeof(int));
+    int nacc = 0, acccap = 64;
+
+    memset(g, 0, sizeof(*g));
+    for (i = 0; i < nr; i++) in_group[rules[i]] = 1;
+    byte_classes(g, N, sets, in_group);
+    for (c = 255; c >= 0; c--) rep[g->cls[c]] = c;
+
+    memset(&B, 0, sizeof(B));
+    B.nfa = N;
+    B.sets = sets;
+    B.mark = (int *)calloc(N->n, sizeof(int));
+    B.stack = (int *)malloc((2 * N->n + 2) * sizeof(int));
+    B.buf = (int *)malloc((N->n + 1) * sizeof(int));
+
+    /* Every state also holds the start states: a match can begin anywhere */
+    B.gen++;
+    for (i = 0; i < nr; i++) closure(&B, entry[rules[i]]);
+    nstart = B.nbuf;
+    start_set = (int *)malloc((nstart + 1) * sizeof(int));
+    memcpy(start_set, B.buf, nstart * sizeof(int));
+    B.implied = (unsigned char *)calloc(N->n, 1);
+    for (i = 0; i < nstart; i++) B.implied[start_set[i]] = 1;
+
+    /* Where the start states go on each class is the same from every state */
+    step_at = (int *)malloc((g->nclass + 1) * sizeof(int));
+    step_pool = (int *)malloc(((size_t)g->nclass * nstart + 1) * sizeof(int));
+    for (c = 0, i = 0; c < g->nclass; c++) {
+        step_at[c] = i;
+        B.gen++;
+        B.nbuf = 0;
+        builder_step(&B, start_set, nstart, rep[c]);
+        step_pool = (int *)realloc(step_pool, ((size_t)i + B.nbuf + 1) * sizeof(int));
+        memcpy(step_pool + i, B.buf, B.nbuf * sizeof(int));
+        i += B.nbuf;
+    }
+    step_at[c] = i;
+
+    memset(&T, 0, sizeof(T));
+    T.hcap = 2 * AUTO_MAX_STATES;
+    T.hash = (int *)malloc(T.hcap * sizeof(int));
+    memset(T.hash, -1, T.hcap * sizeof(int));
+    T.start = (size_t *)calloc(AUTO_MAX_STATES + 1, sizeof(size_t));
+    g->next = (int *)malloc((size_t)AUTO_MAX_STATES * g->nclass * sizeof(int));
+    g->acc = (int *)malloc((AUTO_MAX_STATES + 1) * sizeof(int));
+    g->acc_rules = (int *)malloc(acccap * sizeof(int));
+    state_find(&T, &nstates, B.buf, 0);  /* 0: only the start states */
+
+    for (d = 0; d < nstates && ok; d++) {
+        g->acc[d] = nacc;
+        for (i = (int)T.start[d]; i < (int)T.start[d + 1]; i++) {
+            const NState *st = &N->st[T.pool[i]];
+            if (st->type != S_MATCH) continue;
+            if (nacc == acccap) g->acc_rules = (int *)realloc(g->acc_rules, (acccap *= 2) * sizeof(int));
+            g->acc_rules[nacc++] = st->rule;
+        }
+        for (c = 0; c < g->nclass; c++) {
+            int k, n;
+            B.gen++;
+            B.nbuf = 0;
+            for (i = step_at[c]; i < step_at[c + 1]; i++) {
+                B.mark[step_pool[i]] = B.gen;
+                B.buf[B.nbuf++] = step_pool[i];
+            }
+            builder_step(&B, T.pool + T.start[d], (int)(T.start[d + 1] - T.start[d]), rep[c]);
+            /* Once a rule has matched, its other threads add nothing */
+            for (i = 0; i < B.nbuf; i++)
+                if (N->st[B.buf[i]].type == S_MATCH) matched[N->st[B.buf[i]].rule] = B.gen;
+            for (i = k = 0; i < B.nbuf; i++) {
+                const NState *st = &N->st[B.buf[i]];
+                if (st->type == S_MATCH || matched[st->rule] != B.gen) B.buf[k++] = B.buf[i];
+            }
+            n = k;
+            qsort(B.buf, n, sizeof(int), cmp_int);
+            if ((k = state_find(&T, &nstates, B.buf, n)) < 0) { ok = 0; break; }
+            g->next[(size_t)d * g->nclass + c] = k;
+        }
+    }
+    g->acc[nstates < AUTO_MAX_STATES ? nstates : AUTO_MAX_STATES] = nacc;
+    g->nstates = nstates;
+
+    free(in_group);
+    free(rep);
+    free(matched);
+    free(B.mark);
+    free(B.stack);
+    free(B.buf);
+    free(start_set);
+    free(B.implied);
+    free(step_at);
+    free(step_pool);
+    free(T.pool);
+    free(T.start);
+    free(T.hash);
+    if (!ok) {
+        free(g->next);
+        free(g->acc);
+        free(g->acc_rules);
+        memset(g, 0, sizeof(*g));
+    }
+    return ok;
+}
+
+/* Build a DFA for the rules, or split them in two and try again */
+static void build_groups(Automaton *a, const Nfa *N, const ByteSet *sets, const int *entry,
+                         const int *rules, int nr) {
+    AutoGroup g;
+    if (!nr) return;
+    if (build_group(&g, N, sets, entry, rules, nr, a->nrules)) {
+        a->groups = (AutoGroup *)realloc(a->groups, (a->ngroups + 1) * sizeof(AutoGroup));
+        a->groups[a->ngroups++] = g;
+        return;
+    }
+    if (nr == 1) {
+        a->covered[rules[0]] = 0;
+        return;
+    }
+    build_groups(a, N, sets, entry, rules, nr / 2);
+    build_groups(a, N, sets, entry, rules + nr / 2, nr - nr / 2);
+}
+
+/* ----------------------------------------------------------------
+ * Public (engine) interface
+ * ---------------------------------------------------------------- */
+Automaton *automaton_build(Rule *const *rules, int nrules) {
+    Automaton *a;
+    Nfa N;
+    Parser P;
+    ByteSet *sets = NULL;
+    int nsets = 0, setcap = 0;
+    int *entry = (int *)malloc(nrules * sizeof(int));
+    int *list = (int *)malloc(nrules * sizeof(int));
+    int r, nlist = 0;
+
+    a = (Automaton *)calloc(1, sizeof(Automaton));
+    a->nrules = nrules;
+    a->covered = (unsigned char *)calloc(nrules, 1);
+    memset(&N, 0, sizeof(N));
+    memset(&P, 0, sizeof(P));
+    P.nsets = &nsets;
+    P.setcap = &setcap;
+
+    for (r = 0; r < nrules; r++) {
+        int root, match, first = N.n;
+        P.p = rules[r]->pattern_src;
+        P.caseless = 0;
+        P.extended = 0;
+        P.ok = 1;
+        P.nnodes = 0;
+        P.sets = sets;
+        root = parse_alt(&P);
+        sets = P.sets;
+        if (!P.ok || *P.p) continue;
+        root = factor(&P, root);
+        N.rule = r;
+        N.limit = first + AUTO_MAX_NFA;
+        match = state_new(&N, S_MATCH, -1, -1, -1);
+        entry[r] = match < 0 ? -1 : compile(&N, P.nodes, root, match);
+        /* A rule that fails to compile, or matches "", goes to PCRE2 */
+        if (entry[r] < 0 || entry[r] == match) {
+            N.n = first;
+            continue;
+        }
+        a->covered[r] = 1;
+        list[nlist++] = r;
+    }
+    if (nlist) {
+        /* The empty-match check above misses x* inside a group; closure does not */
+        Builder B;
+        int i, k = 0;
+        memset(&B, 0, sizeof(B));
+        B.nfa = &N;
+        B.mark = (int *)calloc(N.n, sizeof(int));
+        B.stack = (int *)malloc((2 * N.n + 2) * sizeof(int));
+        B.buf = (int *)malloc((N.n + 1) * sizeof(int));
+        for (i = 0; i < nlist; i++) {
+            int j, empty = 0;
+            B.gen++;
+            B.nbuf = 0;
+            closure(&B, entry[list[i]]);
+            for (j = 0; j < B.nbuf; j++)
+                if (N.st[B.buf[j]].type == S_MATCH) empty = 1;
+            if (empty) a->covered[list[i]] = 0;
+            else list[k++] = list[i];
+        }
+        nlist = k;
+        free(B.mark);
+        free(B.stack);
+        free(B.buf);
+        build_groups(a, &N, (const ByteSet *)sets, entry, list, nlist);
+    }
+
+    free(P.nodes);
+    free(sets);
+    free(N.st);
+    free(entry);
+    free(list);
+    if (!a->ngroups) {
+        automaton_free(a);
+        return NULL;
+    }
+    return a;
+}
+
+void automaton_free(Automaton *a) {
+    int g;
+    if (!a) return;
+    for (g = 0; g < a->ngroups; g++) {
+        free(a->groups[g].next);
+        free(a->groups[g].acc);
+        free(a->groups[g].acc_rules);
+    }
+    free(a->groups);
+    free(a->covered);
+    free(a);
+}
+
+int automaton_covers(const Automaton *a, int rule) {
+    return a->covered[rule];
+}
+
+int automaton_scan(const Automaton *a, const char *text, size_t len, unsigned char *seen, int *hits) {
+    int g, n = 0;
+    size_t i;
+
+    for (g = 0; g < a->ngroups; g++) {
+        const AutoGroup *gr = &a->groups[g];
+        const int *next = gr->next;
+        int nclass = gr->nclass, d = 0, k;
+        for (i = 0; i < len; i++) {
+            d = next[d * nclass + gr->cls[(unsigned char)text[i]]];
+            for (k = gr->acc[d]; k < gr->acc[d + 1]; k++) {
+                int r = gr->acc_rules[k];
+                if (!seen[r]) {
+                    seen[r] = 1;
+                    if (hits) hits[n] = r;
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
@@ -0,0 +1,300 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "batch.h"
+#include "input.h"
+#include "pool.h"
+#include "render.h"
+
+/* Lines are colorized this much at a time (ccze_colorize_lines) */
+#define BATCH_CHUNK (256 * 1024)
+
+typedef struct {
+    char              *rel;      /* path under indir, and under outdir */
+    unsigned long long size;
+    unsigned long long lines;
+    double             secs;
+    int                ok;
+} BatchFile;
+
+typedef struct {
+    const Ccze *h;
+    const char *indir;
+    const char *outdir;
+    int         mode;
+    const char *cssfile;
+    char       *skip;       /* outdir as a full path, not scanned */
+    BatchFile  *files;
+    int         nfiles, cap;
+} Batch;
+
+static double seconds(LARGE_INTEGER t0, LARGE_INTEGER t1) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart;
+}
+
+/* dir\name, or name alone when dir is empty; suffix may be "" */
+static char *path_join(const char *dir, const char *name, const char *suffix) {
+    size_t dl = strlen(dir);
+    char *p = (char *)malloc(dl + strlen(name) + strlen(suffix) + 2);
+    int sep = dl && dir[dl - 1] != '\\' && dir[dl - 1] != '/';
+    sprintf(p, "%s%s%s%s", dir, sep ? "\\" : "", name, suffix);
+    return p;
+}
+
+/* The full path of a file or directory, which needn't exist yet; the
+ * path as given if that fails */
+static char *full_path(const char *path) {
+    DWORD n = GetFullPathNameA(path, 0, NULL, NULL);
+    char *p = n ? (char *)malloc(n) : NULL;
+
+    if (!p || GetFullPathNameA(path, n, p, NULL) >= n) {
+        free(p);
+        return _strdup(path);
+    }
+    return p;
+}
+
+/* Drop trailing separators, but not the one of a root like C:\ */
+static void trim_sep(char *p) {
+    size_t i;
+    for (i = strlen(p); i > 1 && (p[i - 1] == '\\' || p[i - 1] == '/') && p[i - 2] != ':'; i--)
+        p[i - 1] = '\0';
+}
+
+/* The same path, give or take case and the kind of slash */
+static int same_path(const char *a, const char *b) {
+    for (; *a && *b; a++, b++) {
+        int ca = *a == '/' ? '\\' : tolower((unsigned char)*a);
+        int cb = *b == '/' ? '\\' : tolower((unsigned char)*b);
+        if (ca != cb) return 0;
+    }
+    return *a == *b;
+}
+
+/* Create the directories leading up to path */
+static void make_parents(char *path) {
+    char *p;
+    for (p = path + 1; *p; p++) {
+        if (*p != '\\' && *p != '/') continue;
+        *p = '\0';
+        CreateDirectoryA(path, NULL);
+        *p = '\\';
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Finding the files
+ * ---------------------------------------------------------------- */
+static int batch_scan(Batch *b, const char *rel) {
+    WIN32_FIND_DATAA fd;
+    char *dir = *rel ? path_join(b->indir, rel, "") : _strdup(b->indir);
+    char *pattern = path_join(dir, "*", "");
+    HANDLE hf = FindFirstFileA(pattern, &fd);
+
+    free(pattern);
+    if (hf == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "ccze: error: cannot read directory %s\n", dir);
+        free(dir);
+        return 0;
+    }
+    free(dir);
+    do {
+        char *sub;
+        if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) continue;
+        sub = path_join(rel, fd.cFileName, "");
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            char *dir = path_join(b->indir, sub, "");
+            char *full = full_path(dir);
+            /* Junctions and links could lead back up the tree, and last
+             * run's output is no input, however -O spelled it */
+            if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && !same_path(full, b->skip))
+                batch_scan(b, sub);
+            free(dir);
+            free(full);
+            free(sub);
+            continue;
+        }
+        if (b->nfiles == b->cap) {
+            b->cap = b->cap ? b->cap * 2 : 64;
+            b->files = (BatchFile *)realloc(b->files, b->cap * sizeof(BatchFile));
+        }
+        memset(&b->files[b->nfiles], 0, sizeof(BatchFile));
+        b->files[b->nfiles].rel = sub;
+        b->files[b->nfiles].size = ((unsigned long long)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+        b->nfiles++;
+    } while (FindNextFileA(hf, &fd));
+    FindClose(hf);
+    return 1;
+}
+
+static int by_size_desc(const void *a, const void *b) {
+    const BatchFile *fa = *(const BatchFile *const *)a, *fb = *(const BatchFile *const *)b;
+    return fa->size < fb->size ? 1 : fa->size > fb->size ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------
+ * Workers: one file per task
+ * ---------------------------------------------------------------- */
+static void batch_file(void *task, int worker, void *ud) {
+    Batch *b = (Batch *)ud;
+    BatchFile *f = (BatchFile *)task;
+    char *in_path = path_join(b->indir, f->rel, "");
+    char *out_path = path_join(b->outdir, f->rel, b->mode == 'h' ? ".html" : "");
+    char *in_full = full_path(in_path), *out_full = full_path(out_path);
+    int same = same_path(in_full, out_full);
+    LARGE_INTEGER t0, t1;
+    FILE *fin, *fout = NULL;
+    ColorOut co;
+    Renderer r;
+    Input in;
+    LineBuf lb, chunk;
+
+    (void)worker;
+    free(in_full);
+    free(out_full);
+    /* Opening the output would empty the input before it is read */
+    if (same) {
+        fprintf(stderr, "ccze: error: %s would be written over itself, skipped\n", in_path);
+        free(in_path);
+        free(out_path);
+        return;
+    }
+    QueryPerformanceCounter(&t0);
+    fin = fopen(in_path, "rb");
+    if (fin) {
+        make_parents(out_path);
+        fout = fopen(out_path, "w");
+    }
+    if (!fin || !fout) {
+        fprintf(stderr, "ccze: error: cannot %s %s\n", fin ? "create" : "open", fin ? out_path : in_path);
+        if (fin) fclose(fin);
+        free(in_path);
+        free(out_path);
+        return;
+    }
+
+    color_init(&co, b->mode, fout);
+    memset(&r, 0, sizeof(r));
+    r.engine = b->h;
+    r.out = &co;
+    if (b->mode == 'h') color_html_header(&co, b->cssfile);
+    input_open(&in, fin);
+    linebuf_init(&lb);
+    linebuf_init(&chunk);
+    while (input_readline(&in, &lb)) {
+        f->lines++;
+        if (!ccze_filter(b->h, lb.buf, lb.len)) continue;
+        linebuf_append(&chunk, lb.buf, lb.len);
+        if (chunk.len >= BATCH_CHUNK) {
+            ccze_colorize_lines(b->h, chunk.buf, chunk.len, render_span, &r, NULL);
+            chunk.len = 0;
+        }
+    }
+    if (chunk.len) ccze_colorize_lines(b->h, chunk.buf, chunk.len, render_span, &r, NULL);
+    if (b->mode == 'h') color_html_footer(&co);
+    linebuf_free(&lb);
+    linebuf_free(&chunk);
+    input_close(&in);
+    fclose(fin);
+
+    f->ok = !ferror(fout);
+    if (fclose(fout) != 0) f->ok = 0;
+    if (!f->ok) fprintf(stderr, "ccze: error: writing %s failed\n", out_path);
+    QueryPerformanceCounter(&t1);
+    f->secs = seconds(t0, t1);
+    free(in_path);
+    free(out_path);
+}
+
+/* ----------------------------------------------------------------
+ * Summary
+ * ---------------------------------------------------------------- */
+static void batch_report(const Batch *b, double wall, int nthreads) {
+    unsigned long long bytes = 0;
+    int i, failed = 0;
+
+    printf("%-40s %12s %10s %9s %11s\n", "file", "bytes", "lines", "time", "rate");
+    for (i = 0; i < b->nfiles; i++) {
+        const BatchFile *f = &b->files[i];
+        if (!f->ok) {
+            failed++;
+            printf("%-40s %12llu %10s\n", f->rel, f->size, "failed");
+            continue;
+        }
+        bytes += f->size;
+        printf("%-40s %12llu %10llu %7.3f s %6.1f MB/s\n", f->rel, f->size, f->lines,
+               f->secs, f->secs > 0 ? f->size / 1048576.0 / f->secs : 0.0);
+    }
+    printf("%d file%s, %.1f MB colorized in %.2f s (%.1f MB/s) on %d thread%s", b->nfiles,
+           b->nfiles == 1 ? "" : "s", bytes / 1048576.0, wall,
+           wall > 0 ? bytes / 1048576.0 / wall : 0.0, nthreads, nthreads == 1 ? "" : "s");
+    if (failed) printf(", %d failed", failed);
+    printf("\n");
+}
+
+int batch_run(const Ccze *h, const char *indir, const char *outdir, int mode,
+              const char *cssfile, int nthreads) {
+    Batch b;
+    BatchFile **order;
+    Pool *pool;
+    LARGE_INTEGER t0, t1;
+    char *in_full;
+    int i, ok, status = 0;
+
+    memset(&b, 0, sizeof(b));
+    b.h = h;
+    b.indir = indir;
+    b.outdir = outdir;
+    b.mode = mode;
+    b.cssfile = cssfile;
+    b.skip = full_path(outdir);
+    trim_sep(b.skip);
+    in_full = full_path(indir);
+    trim_sep(in_full);
+    ok = !same_path(in_full, b.skip);
+    free(in_full);
+    if (!ok) {
+        fprintf(stderr, "ccze: error: -O %s is the -R directory, its files would be written over\n", outdir);
+        free(b.skip);
+        return 1;
+    }
+
+    QueryPerformanceCounter(&t0);
+    ok = batch_scan(&b, "");
+    free(b.skip);
+    if (!ok) return 1;
+    if (!b.nfiles) {
+        fprintf(stderr, "ccze: warning: no files under %s\n", indir);
+        return 0;
+    }
+
+    /* Largest first: whatever is left over at the end is small */
+    order = (BatchFile **)malloc(b.nfiles * sizeof(BatchFile *));
+    for (i = 0; i < b.nfiles; i++) order[i] = &b.files[i];
+    qsort(order, b.nfiles, sizeof(BatchFile *), by_size_desc);
+
+    if (nthreads > b.nfiles) nthreads = b.nfiles;
+    pool = pool_create(nthreads, batch_file, &b);
+    if (pool) {
+        nthreads = pool_threads(pool);
+        for (i = 0; i < b.nfiles; i++) pool_submit(pool, order[i]);
+        pool_finish(pool);
+    } else {
+        nthreads = 1;
+        for (i = 0; i < b.nfiles; i++) batch_file(order[i], 0, &b);
+    }
+    QueryPerformanceCounter(&t1);
+
+    batch_report(&b, seconds(t0, t1), nthreads);
+    for (i = 0; i < b.nfiles; i++) {
+        if (!b.files[i].ok) status = 1;
+        free(b.files[i].rel);
+    }
+    free(b.files);
+    free(order);
+    return status;
+}
@@ -0,0 +1,21 @@
+#ifndef CCZE_BATCH_H
+#define CCZE_BATCH_H
+
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Batch mode (-R INDIR -O OUTDIR)
+ *
+ * Colorizes every file under a directory tree into the same relative
+ * path under another, with the rules compiled once for all of them.
+ * Files go to a pool of workers largest first, so a big file never
+ * starts last and leaves the other workers idle at the end. A table of
+ * the time and throughput of each file is printed at the end.
+ * ---------------------------------------------------------------- */
+
+/* mode as for color_init() ('h' appends ".html" to each name). Returns
+ * the exit status: 1 if any file failed. */
+int batch_run(const Ccze *h, const char *indir, const char *outdir, int mode,
+              const char *cssfile, int nthreads);
+
+#endif /* CCZE_BATCH_H */
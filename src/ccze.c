@@ -1,16 +1,32 @@
-#define PCRE2_CODE_UNIT_WIDTH 8
-#include <pcre2.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <windows.h>
+#include "adapt.h"
+#include "batch.h"
 #include "color.h"
-#include "rules.h"
-#include "tool.h"
+#include "index.h"
+#include "input.h"
+#include "libccze.h"
+#include "metrics.h"
+#include "pool.h"
+#include "record.h"
+#include "reload.h"
+#include "render.h"
+#include "serve.h"
+#include "spans.h"
+#include "stats.h"
+#include "tail.h"
+#include "tee.h"
 
 #define CCZE_VERSION "1.0.0"
 
+/* The default rule set, generated from ccze.conf into src\gen_rules.c
+ * by build.bat (tools\conf2c.c). Used when no ccze.conf sits next to
+ * the executable and -F isn't given. */
+extern const CczeBuiltin ccze_builtin;
+
 /* ----------------------------------------------------------------
  * Options
  * ---------------------------------------------------------------- */
@@ -18,424 +34,146 @@ typedef struct {
     int          mode_override;   /* 0=auto, 'n'=none, 'a'=ansi, 'h'=html */
     int          remove_facility; /* -r: strip syslog facility prefix */
     int          wordcolor;       /* -o wordcolor (default on) */
+    int          automaton;       /* -o automaton: prefilter rules with one DFA */
     int          transparent;     /* -o transparent (default on) */
     int          list_rules;      /* -l: list loaded rules and exit */
+    int          check_rules;     /* --check-rules: stress-test rules and exit */
     const char  *rcfile;          /* -F: override config file path */
     const char  *cssfile;         /* -o cssfile=FILE */
     const char  *input_file;      /* positional arg */
+    const char  *batch_in;        /* -R: colorize every file under this directory */
+    const char  *batch_out;       /* -O: ... into the same paths under this one */
+    const char  *color_overrides[CCZE_MAX_OVERRIDES]; /* -c KEY=COLOR */
+    int          num_overrides;
+    const char  *record_start;    /* --record-start: multi-line record pattern */
+    int          record_max_lines; /* --record-max-lines */
+    int          record_max_bytes; /* --record-max-bytes */
+    int          record_flush_ms; /* --record-timeout */
+    int          spans;           /* --spans: 0=off, 'j'=json, 'b'=binary */
+    const char  *tee_path[TEE_MAX]; /* --tee-html, --tee-text: extra output files */
+    int          tee_mode[TEE_MAX]; /* 'h' or 'n' */
+    int          ntees;
+    int          watch;           /* --watch: reload the rule file on change */
+    const char  *grep;            /* --grep: only show lines matching this */
+    int          min_level;       /* --min-level: only show lines this severe */
+    int          build_index;     /* --build-index: write FILE.cczi and exit */
+    RangeQuery   range;           /* --lines, --since, --until */
+    int          stats;           /* --stats: 0=off, 't'=table, 'j'=json */
+    int          threads;         /* --threads: worker threads (0 = one per CPU) */
+    int          line_threads;    /* --line-threads: threads per long line (0 = off) */
+    const char  *serve;           /* --serve: daemon socket path */
+    const char  *client;          /* --client: colorize through the daemon at this path */
+    unsigned long long tail;      /* --tail: only the last N lines (0 = all) */
+    int          reverse;         /* --reverse: newest line first */
+    const char  *metrics_file;    /* --metrics-file: rewrite live metrics here */
+    int          metrics_interval; /* --metrics-interval: seconds between rewrites */
+    int          metrics_json;    /* --metrics-format json */
+    int          adaptive;        /* --adaptive: cheaper tiers when behind a pipe */
+    CczeAnsi     ansi;            /* --ansi: escape sequences in the input */
+    const char  *engine_opt;      /* first option that only configures the engine,
+                                   * which --client doesn't load */
 } Options;
 
+
 /* ----------------------------------------------------------------
- * Dynamic line buffer
+ * Rendering
+ *
+ * The engine (libccze) reports spans; render.c draws them.
  * ---------------------------------------------------------------- */
 typedef struct {
-    char  *buf;
-    size_t cap;
-    size_t len;
-} LineBuf;
-
-static void linebuf_init(LineBuf *lb) {
-    lb->cap = 4096;
-    lb->buf = (char *)malloc(lb->cap);
-    lb->len = 0;
+    Renderer    r;
+    SpanWriter *spans;            /* non-NULL: --spans output instead of rendering */
+    StatsRun   *stats;            /* non-NULL: --stats, count instead of rendering */
+    Metrics    *metrics;          /* non-NULL: rendering, with live metrics */
+    CczeTier    tier;             /* --adaptive: how much of the engine to run */
+    int         bulk;             /* gather lines into chunk (plain lines only) */
+    LineBuf     chunk;            /* kept lines not yet colorized */
+    unsigned    chunk_lines;
+} RenderCtx;
+
+/* Rules run once over this much text of many lines (ccze_colorize_lines)
+ * rather than once per line */
+#define RENDER_CHUNK (256 * 1024)
+
+/* Colorize the lines gathered so far */
+static void flush_chunk(RenderCtx *rc) {
+    if (!rc->chunk.len) return;
+    if (rc->metrics)
+        metrics_render_lines(rc->metrics, &rc->r, rc->chunk.buf, rc->chunk.len, rc->chunk_lines);
+    else
+        ccze_colorize_lines(rc->r.engine, rc->chunk.buf, rc->chunk.len, render_span, &rc->r, NULL);
+    rc->chunk.len = 0;
+    rc->chunk_lines = 0;
 }
-static void linebuf_free(LineBuf *lb) { free(lb->buf); }
 
-static int linebuf_readline(LineBuf *lb, FILE *fp) {
-    int c;
-    lb->len = 0;
-    while ((c = fgetc(fp)) != EOF) {
-        if (lb->len + 1 >= lb->cap) {
-            lb->cap *= 2;
-            lb->buf = (char *)realloc(lb->buf, lb->cap);
-        }
-        lb->buf[lb->len++] = (char)c;
-        lb->buf[lb->len] = '\0';
-        if (c == '\n') break;
+/* Colorize one line or record read at the given input offset, unless
+ * --grep/--min-level drop it */
+static void process(RenderCtx *rc, const char *buf, size_t len, unsigned long long offset) {
+    if (rc->stats) {
+        /* Filtered and classified on a worker thread */
+        stats_feed(rc->stats, buf, len);
+        return;
     }
-    return lb->len > 0;
-}
-
-/* ----------------------------------------------------------------
- * Syslog facility stripping (-r)
- * ---------------------------------------------------------------- */
-static const char *strip_facility(const char *line, int *len) {
-    const char *p = line;
-    if (*p == '<') {
-        p++;
-        while (*p && *p != '>') p++;
-        if (*p == '>') p++;
+    if (rc->metrics) {
+        rc->metrics->lines_in++;
+        rc->metrics->bytes_in += len;
+    }
+    if (!ccze_filter(rc->r.engine, buf, len)) return;
+    if (rc->bulk && rc->tier == CCZE_TIER_FULL) {
+        linebuf_append(&rc->chunk, buf, len);
+        rc->chunk_lines++;
+        if (rc->chunk.len >= RENDER_CHUNK) flush_chunk(rc);
+        return;
+    }
+    flush_chunk(rc);
+    if (rc->spans) {
+        ccze_colorize(rc->r.engine, buf, len, spans_collect, rc->spans);
+        spans_write_line(rc->spans, offset, len);
+    } else if (rc->metrics) {
+        metrics_render(rc->metrics, &rc->r, buf, len, rc->tier);
     } else {
-        const char *colon = NULL;
-        const char *s = line;
-        while (*s && *s != ' ' && *s != '\n') {
-            if (*s == ':') { colon = s; break; }
-            s++;
-        }
-        if (colon && colon[1] == ' ') p = colon + 2;
+        ccze_colorize(rc->r.engine, buf, len, render_span, &rc->r);
     }
-    *len -= (int)(p - line);
-    return p;
 }
 
-/* ----------------------------------------------------------------
- * Word color (ccze-compatible)
- *
- * ccze uses prefix matching (strstr(word, prefix) == word).
- * We do the same: if a word *starts with* a bad/good/error/system
- * prefix, it gets that color. This handles "Failed", "Starting", etc.
- * ---------------------------------------------------------------- */
-
-static int starts_with_lower(const char *word, int wlen, const char *prefix) {
-    int plen = (int)strlen(prefix);
-    int i;
-    if (wlen < plen) return 0;
-    for (i = 0; i < plen; i++) {
-        if (tolower((unsigned char)word[i]) != prefix[i]) return 0;
+/* Report rules that were skipped on lines where they hit a PCRE2 limit */
+static void report_limits(const Ccze *engine) {
+    int r, n = ccze_rule_count(engine);
+    for (r = 1; r <= n; r++) {
+        long hits = ccze_limit_hits(engine, r);
+        if (hits > 0)
+            fprintf(stderr, "ccze: warning: rule %d hit its match limit and was skipped on %ld line%s\n",
+                    r, hits, hits == 1 ? "" : "s");
     }
-    return 1;
-}
-
-static Color wordcolor_lookup(const char *word, int wlen) {
-    /* ccze error words - bold red */
-    static const char *words_error[] = {
-        "error", "crit", "invalid", "fail", "false", "alarm", "fatal", NULL
-    };
-    /* ccze bad words - bold yellow */
-    static const char *words_bad[] = {
-        "warn", "restart", "exit", "stop", "end", "shutting", "down", "close",
-        "unreach", "can't", "cannot", "skip", "deny", "disable", "ignored",
-        "miss", "oops", "not", "backdoor", "blocking", "ignoring",
-        "unable", "readonly", "offline", "terminate", "empty", "virus", NULL
-    };
-    /* ccze good words - bold green */
-    static const char *words_good[] = {
-        "activ", "start", "ready", "online", "load", "ok", "register", "detected",
-        "configured", "enable", "listen", "open", "complete", "attempt", "done",
-        "check", "connect", "finish", "clean", "succeed", NULL
-    };
-    /* ccze system words - bold cyan */
-    static const char *words_system[] = {
-        "ext2-fs", "reiserfs", "vfs", "iso", "isofs", "cslip", "ppp", "bsd",
-        "linux", "tcp/ip", "mtrr", "pci", "isa", "scsi", "ide", "atapi",
-        "bios", "cpu", "fpu", "discharging", "resume", NULL
-    };
-    int i;
-
-    for (i = 0; words_error[i]; i++)
-        if (starts_with_lower(word, wlen, words_error[i])) return COL_BRIGHT_RED;
-    for (i = 0; words_bad[i]; i++)
-        if (starts_with_lower(word, wlen, words_bad[i])) return COL_BRIGHT_YELLOW;
-    for (i = 0; words_good[i]; i++)
-        if (starts_with_lower(word, wlen, words_good[i])) return COL_BRIGHT_GREEN;
-    for (i = 0; words_system[i]; i++)
-        if (starts_with_lower(word, wlen, words_system[i])) return COL_BRIGHT_CYAN;
-    return COL_RESET;
 }
 
-/* Check if a span looks like a path (starts with /) */
-static int is_path(const char *word, int wlen) {
-    return wlen > 1 && word[0] == '/';
+/* Swap in a reloaded rule set (--watch); only called between lines */
+static void maybe_reload(Reloader *rl, Ccze **engine, RenderCtx *rc) {
+    Ccze *fresh = reload_poll(rl);
+    if (!fresh) return;
+    flush_chunk(rc);
+    report_limits(*engine);
+    ccze_close(*engine);
+    *engine = fresh;
+    rc->r.engine = fresh;
 }
 
-/* Check if a span looks like a URI */
-static int is_uri(const char *word, int wlen) {
-    return wlen > 5 && (
-        (wlen > 7 && memcmp(word, "http://", 7) == 0) ||
-        (wlen > 8 && memcmp(word, "https://", 8) == 0) ||
-        (wlen > 6 && memcmp(word, "ftp://", 6) == 0));
-}
-
-/* Check if a span is all digits (a number) */
-static int is_number(const char *word, int wlen) {
-    int i;
-    if (wlen == 0) return 0;
-    for (i = 0; i < wlen; i++)
-        if (!isdigit((unsigned char)word[i])) return 0;
-    return 1;
-}
-
-/* Emit a plain-text span, applying wordcolor if enabled */
-static void emit_plain(const char *text, int len, int wordcolor_on) {
-    int i, ws, we;
-    Color wc;
-
-    if (!wordcolor_on) {
-        color_write_plain(text, len);
-        return;
-    }
-    i = 0;
-    while (i < len) {
-        /* Non-word characters: pass through */
-        if (!isalnum((unsigned char)text[i]) && text[i] != '/' && text[i] != ':' && text[i] != '-' && text[i] != '_' && text[i] != '.') {
-            ws = i;
-            while (i < len && !isalnum((unsigned char)text[i]) && text[i] != '/' && text[i] != ':' && text[i] != '-' && text[i] != '_' && text[i] != '.')
-                i++;
-            color_write_plain(text + ws, i - ws);
-            continue;
-        }
-        /* Extract a "token" (word or path or uri) */
-        ws = i;
-        while (i < len && (isalnum((unsigned char)text[i]) || text[i] == '/' || text[i] == ':' || text[i] == '-' || text[i] == '_' || text[i] == '.'))
-            i++;
-        we = i;
-
-        /* Classify token */
-        if (is_uri(text + ws, we - ws))
-            color_write(COL_BRIGHT_GREEN, text + ws, we - ws);
-        else if (is_path(text + ws, we - ws))
-            color_write(COL_GREEN, text + ws, we - ws);
-        else if (is_number(text + ws, we - ws))
-            color_write(COL_BRIGHT_WHITE, text + ws, we - ws);
-        else {
-            wc = wordcolor_lookup(text + ws, we - ws);
-            if (wc != COL_RESET)
-                color_write(wc, text + ws, we - ws);
-            else
-                color_write_plain(text + ws, we - ws);
-        }
-    }
-}
-
-#define NO_RULE -1
-
 /* ----------------------------------------------------------------
- * Syslog structural parser
- *
- * Matches: "Feb 22 00:00:18 hostname process[pid]: message"
- * Colors each field like ccze's mod_syslog.c:
- *   date     = bright cyan
- *   hostname = bright blue
- *   process  = green
- *   [        = bright green
- *   pid      = bright white
- *   ]        = bright green
- *   :        = green
- *   message  = wordcolor + rules
+ * Multi-line records (--record-start)
  *
- * Returns 1 if line was handled as syslog, 0 otherwise.
+ * Each assembled record is colorized in one pass, so rules (which are
+ * compiled with PCRE2_MULTILINE | PCRE2_DOTALL) can match across the
+ * physical lines of a stack trace or a wrapped message.
  * ---------------------------------------------------------------- */
-static pcre2_code *g_syslog_re = NULL;
-
-static void syslog_init(void) {
-    int err;
-    PCRE2_SIZE erroff;
-    /* ccze regex: ^(\S*\s{1,2}\d{1,2}\s\d\d:\d\d:\d\d)\s(\S+)\s+((\S+:?)\s(.*))$ */
-    g_syslog_re = pcre2_compile(
-        (PCRE2_SPTR)"^(\\S+\\s{1,2}\\d{1,2}\\s\\d\\d:\\d\\d:\\d\\d)\\s(\\S+)\\s+((\\S+?)(?:\\[(\\d+)\\])?:\\s(.*))$",
-        PCRE2_ZERO_TERMINATED, PCRE2_DOTALL, &err, &erroff, NULL);
-}
-
-static int process_syslog(const char *line, int line_len, Rule *rules, const Options *opts) {
-    pcre2_match_data *md;
-    PCRE2_SIZE *ov;
-    int rc;
-
-    if (!g_syslog_re) return 0;
-
-    md = pcre2_match_data_create(16, NULL);
-    rc = pcre2_match(g_syslog_re, (PCRE2_SPTR)line, line_len, 0, 0, md, NULL);
-    if (rc < 0) {
-        pcre2_match_data_free(md);
-        return 0;
-    }
-
-    ov = pcre2_get_ovector_pointer(md);
-
-    /* Group 1: date */
-    color_write(COL_BRIGHT_CYAN, line + ov[2], (int)(ov[3] - ov[2]));
-    color_write_plain(" ", 1);
-
-    /* Group 2: hostname */
-    color_write(COL_BRIGHT_BLUE, line + ov[4], (int)(ov[5] - ov[4]));
-    color_write_plain(" ", 1);
-
-    /* Group 4: process name */
-    color_write(COL_GREEN, line + ov[8], (int)(ov[9] - ov[8]));
-
-    /* Group 5: pid (optional) */
-    if (ov[10] != PCRE2_UNSET) {
-        color_write(COL_BRIGHT_GREEN, "[", 1);
-        color_write(COL_BRIGHT_WHITE, line + ov[10], (int)(ov[11] - ov[10]));
-        color_write(COL_BRIGHT_GREEN, "]", 1);
-    }
-
-    color_write(COL_GREEN, ":", 1);
-    color_write_plain(" ", 1);
-
-    /* Group 6: message — apply rules + wordcolor */
-    {
-        const char *msg = line + ov[12];
-        int msg_len = (int)(ov[13] - ov[12]);
-
-        if (rules) {
-            /* Apply regex rules to the message portion */
-            int *color_map = (int *)malloc(msg_len * sizeof(int));
-            Rule **rule_arr = NULL;
-            int nrules = 0, ri, r, i, j;
-            Rule *rp;
-            pcre2_match_data *rmd;
-
-            for (i = 0; i < msg_len; i++) color_map[i] = NO_RULE;
-            for (rp = rules; rp; rp = rp->next) nrules++;
-            rule_arr = (Rule **)malloc(nrules * sizeof(Rule *));
-            ri = 0;
-            for (rp = rules; rp; rp = rp->next) rule_arr[ri++] = rp;
-
-            rmd = pcre2_match_data_create(16, NULL);
-            for (r = 0; r < nrules; r++) {
-                pcre2_code *re = (pcre2_code *)rule_arr[r]->re;
-                PCRE2_SIZE offset = 0;
-                while (offset < (PCRE2_SIZE)msg_len) {
-                    int mrc = pcre2_match(re, (PCRE2_SPTR)msg, msg_len, offset, 0, rmd, NULL);
-                    if (mrc < 0) break;
-                    {
-                        PCRE2_SIZE *mov = pcre2_get_ovector_pointer(rmd);
-                        int mstart = (int)mov[0], mend = (int)mov[1], claimed = 0;
-                        if (mend <= mstart) { offset = mend + 1; continue; }
-                        for (i = mstart; i < mend; i++)
-                            if (color_map[i] != NO_RULE) { claimed = 1; break; }
-                        if (!claimed)
-                            for (i = mstart; i < mend; i++) color_map[i] = r;
-                        offset = (PCRE2_SIZE)mend;
-                    }
-                }
-            }
-            pcre2_match_data_free(rmd);
-
-            /* Emit message with rules + wordcolor */
-            i = 0;
-            while (i < msg_len) {
-                if (color_map[i] == NO_RULE) {
-                    j = i;
-                    while (j < msg_len && color_map[j] == NO_RULE) j++;
-                    emit_plain(msg + i, j - i, opts->wordcolor);
-                    i = j;
-                } else {
-                    r = color_map[i];
-                    j = i;
-                    while (j < msg_len && color_map[j] == r) j++;
-                    if (rule_arr[r]->type == RULE_COLOR)
-                        color_write(rule_arr[r]->color, msg + i, j - i);
-                    else {
-                        int olen = 0;
-                        char *out = tool_run(rule_arr[r]->tool_cmd, msg + i, j - i, &olen);
-                        if (out) {
-                            while (olen > 0 && (out[olen-1]=='\n'||out[olen-1]=='\r')) olen--;
-                            color_write(COL_CYAN, out, olen);
-                            free(out);
-                        } else {
-                            color_write_plain(msg + i, j - i);
-                        }
-                    }
-                    i = j;
-                }
-            }
-            free(color_map);
-            free(rule_arr);
-        } else {
-            emit_plain(msg, msg_len, opts->wordcolor);
-        }
-    }
-
-    /* Trailing newline if present */
-    {
-        int end = (int)(ov[13]);
-        if (end < line_len)
-            color_write_plain(line + end, line_len - end);
-    }
-
-    pcre2_match_data_free(md);
-    return 1;
+static void emit_record(const char *rec, int len, unsigned long long offset, void *ctx) {
+    process((RenderCtx *)ctx, rec, (size_t)len, offset);
 }
 
 /* ----------------------------------------------------------------
- * Process one line (generic, non-syslog)
+ * Reading from the end (--tail, --reverse)
  * ---------------------------------------------------------------- */
-static void process_line(const char *line, int line_len, Rule *rules, const Options *opts) {
-    int *color_map;
-    Rule **rule_arr = NULL;
-    int nrules = 0;
-    int ri, r, i, j;
-    pcre2_match_data *md;
-    Rule *rp;
-
-    /* Strip syslog facility if requested */
-    if (opts->remove_facility)
-        line = strip_facility(line, &line_len);
-
-    /* Try syslog structural parse first */
-    if (process_syslog(line, line_len, rules, opts))
-        return;
-
-    /* Fallback: generic rule-based processing */
-    if (!rules) {
-        emit_plain(line, line_len, opts->wordcolor);
-        return;
-    }
-
-    color_map = (int *)malloc(line_len * sizeof(int));
-    for (i = 0; i < line_len; i++) color_map[i] = NO_RULE;
-
-    for (rp = rules; rp; rp = rp->next) nrules++;
-    rule_arr = (Rule **)malloc(nrules * sizeof(Rule *));
-    ri = 0;
-    for (rp = rules; rp; rp = rp->next) rule_arr[ri++] = rp;
-
-    md = pcre2_match_data_create(16, NULL);
-    for (r = 0; r < nrules; r++) {
-        pcre2_code *re = (pcre2_code *)rule_arr[r]->re;
-        PCRE2_SIZE offset = 0;
-        while (offset < (PCRE2_SIZE)line_len) {
-            int rc = pcre2_match(re, (PCRE2_SPTR)line, line_len, offset, 0, md, NULL);
-            if (rc < 0) break;
-            {
-                PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(md);
-                int mstart = (int)ovector[0];
-                int mend = (int)ovector[1];
-                int claimed;
-                if (mend <= mstart) { offset = mend + 1; continue; }
-                claimed = 0;
-                for (i = mstart; i < mend; i++)
-                    if (color_map[i] != NO_RULE) { claimed = 1; break; }
-                if (!claimed)
-                    for (i = mstart; i < mend; i++) color_map[i] = r;
-                offset = (PCRE2_SIZE)mend;
-            }
-        }
-    }
-    pcre2_match_data_free(md);
-
-    i = 0;
-    while (i < line_len) {
-        if (color_map[i] == NO_RULE) {
-            j = i;
-            while (j < line_len && color_map[j] == NO_RULE) j++;
-            emit_plain(line + i, j - i, opts->wordcolor);
-            i = j;
-        } else {
-            r = color_map[i];
-            j = i;
-            while (j < line_len && color_map[j] == r) j++;
-            if (rule_arr[r]->type == RULE_COLOR) {
-                color_write(rule_arr[r]->color, line + i, j - i);
-            } else {
-                int olen = 0;
-                char *out = tool_run(rule_arr[r]->tool_cmd, line + i, j - i, &olen);
-                if (out) {
-                    while (olen > 0 && (out[olen - 1] == '\n' || out[olen - 1] == '\r')) olen--;
-                    color_write(COL_CYAN, out, olen);
-                    free(out);
-                } else {
-                    color_write_plain(line + i, j - i);
-                }
-            }
-            i = j;
-        }
-    }
-
-    free(color_map);
-    free(rule_arr);
+static void emit_line(const char *line, size_t len, unsigned long long offset, void *ctx) {
+    process((RenderCtx *)ctx, line, len, offset);
 }
 
 /* ----------------------------------------------------------------
@@ -452,25 +190,6 @@ static char *find_conf(void) {
     return _strdup(exe_path);
 }
 
-/* ----------------------------------------------------------------
- * CLI color overrides
- * ---------------------------------------------------------------- */
-#define MAX_COLOR_OVERRIDES 64
-static struct { char key[64]; char val[64]; } g_color_overrides[MAX_COLOR_OVERRIDES];
-static int g_num_overrides = 0;
-
-static void apply_color_overrides(Rule *rules) {
-    int i;
-    Rule *r;
-    for (i = 0; i < g_num_overrides; i++) {
-        Color newcol = color_parse(g_color_overrides[i].val);
-        for (r = rules; r; r = r->next) {
-            if (r->type == RULE_COLOR && _stricmp(color_name(r->color), g_color_overrides[i].key) == 0)
-                r->color = newcol;
-        }
-    }
-}
-
 /* ----------------------------------------------------------------
  * Help & version
  * ---------------------------------------------------------------- */
@@ -494,9 +213,56 @@ static void print_help(void) {
         "  -c, --color KEY=COL   Override color KEY with COL\n"
         "  -r, --remove-facility Strip syslog facility/level prefix\n"
         "  -l, --list-rules      List loaded rules and exit\n"
+        "  -R, --recurse DIR     Colorize every file under DIR (needs -O), on\n"
+        "                        --threads workers, and print a summary\n"
+        "  -O, --outdir DIR      Write them to the same paths under DIR\n"
+        "                        (\".html\" added with -m html)\n"
+        "      --check-rules     Stress-test rules for catastrophic backtracking\n"
+        "      --record-start RE Group continuation lines into records that\n"
+        "                        start at lines matching RE\n"
+        "      --record-max-lines N  Flush a record after N lines (default 500)\n"
+        "      --record-max-bytes N  Flush a record after N bytes (default 1048576)\n"
+        "      --record-timeout MS   Flush a pending record after MS idle (default 250)\n"
+        "      --grep PATTERN    Only show lines matching PATTERN (a literal, or a\n"
+        "                        PCRE2 regex if it has metacharacters)\n"
+        "      --min-level LEVEL Only show lines at LEVEL or worse: debug, info,\n"
+        "                        notice, warn, error, crit\n"
+        "      --build-index     Write a line/time index next to FILE and exit\n"
+        "      --lines A-B       Only show lines A to B (\"A-\" for A to the end)\n"
+        "      --since TIME      Only show lines from TIME on\n"
+        "      --until TIME      Only show lines up to TIME\n"
+        "                        TIME: \"Feb 22 10:00[:00]\" or \"2026-02-22 10:00[:00]\"\n"
+        "      --tail N          Only show the last N lines (that pass --grep and\n"
+        "                        --min-level); FILE is read from the end\n"
+        "      --reverse         Show the newest line first\n"
+        "      --watch           Reload the rule file when it changes\n"
+        "      --adaptive        When piped input arrives faster than it can be\n"
+        "                        shown, step down to cheaper coloring until\n"
+        "                        it catches up\n"
+        "      --ansi MODE       Escape sequences already in the input: keep\n"
+        "                        (default; rules skip them, colors carry on),\n"
+        "                        strip, or raw (colorize them like text)\n"
+        "      --spans FORMAT    Print color spans instead of colored text:\n"
+        "                        json (NDJSON) or bin (binary framing)\n"
+        "      --tee-html FILE   Also write the output to FILE as HTML\n"
+        "      --tee-text FILE   Also write the output to FILE as plain text\n"
+        "      --stats           Print counts of levels, hosts, processes, keywords\n"
+        "                        and rule hits instead of colored text\n"
+        "      --stats-json      The same summary as one JSON object\n"
+        "      --threads N       Worker threads for --stats, --serve and -R\n"
+        "                        (default: one per CPU)\n"
+        "      --line-threads N  Run the rules on lines over 1 MB on N threads\n"
+        "                        (0: one per CPU)\n"
+        "      --serve SOCKET    Run as a daemon colorizing streams sent to SOCKET\n"
+        "      --client SOCKET   Colorize through the daemon listening on SOCKET\n"
+        "      --metrics-file FILE   Keep live metrics (lines, bytes, time per stage,\n"
+        "                        tool runs) in FILE; Ctrl+Break prints them anyway\n"
+        "      --metrics-interval SEC  Rewrite FILE every SEC seconds (default 10)\n"
+        "      --metrics-format FMT  text (default) or json\n"
         "  -o, --options OPT     Toggle options:\n"
         "                          wordcolor / nowordcolor\n"
         "                          transparent / notransparent\n"
+        "                          automaton / noautomaton (skip rules a DFA rules out)\n"
         "                          cssfile=FILE (HTML mode)\n"
         "      --no-color        Disable all color output\n"
         "  -V, --version         Print version and exit\n"
@@ -506,19 +272,28 @@ static void print_help(void) {
         "Rule format:\n"
         "  color  COLOR_NAME  PCRE2_REGEX\n"
         "  tool   COMMAND     PCRE2_REGEX\n"
+        "  set    match=N depth=N heap=KB   (global PCRE2 limits)\n"
+        "  limit  match=N depth=N heap=KB   (limits for the next rule)\n"
     );
 }
 
 /* ----------------------------------------------------------------
  * Parse -o option values
  * ---------------------------------------------------------------- */
+static void engine_option(Options *opts, const char *name) {
+    if (!opts->engine_opt) opts->engine_opt = name;
+}
+
 static void parse_option_flag(const char *opt, Options *opts) {
     if (strcmp(opt, "wordcolor") == 0)        opts->wordcolor = 1;
     else if (strcmp(opt, "nowordcolor") == 0)  opts->wordcolor = 0;
+    else if (strcmp(opt, "automaton") == 0)    opts->automaton = 1;
+    else if (strcmp(opt, "noautomaton") == 0)  opts->automaton = 0;
     else if (strcmp(opt, "transparent") == 0)  opts->transparent = 1;
     else if (strcmp(opt, "notransparent") == 0) opts->transparent = 0;
     else if (strncmp(opt, "cssfile=", 8) == 0) opts->cssfile = opt + 8;
     else fprintf(stderr, "ccze: warning: unknown option '%s'\n", opt);
+    if (strstr(opt, "wordcolor") || strstr(opt, "automaton")) engine_option(opts, "-o");
 }
 
 /* ----------------------------------------------------------------
@@ -526,15 +301,30 @@ static void parse_option_flag(const char *opt, Options *opts) {
  * ---------------------------------------------------------------- */
 int main(int argc, char *argv[]) {
     Options opts;
+    CczeConfig cfg;
     char *conf_path = NULL;
-    Rule *rules;
+    Ccze *engine;
+    ColorOut out;
+    RenderCtx rctx;
+    SpanWriter sw;
     FILE *fp;
+    Input in;
     LineBuf lb;
-    int i;
+    RecordAsm ra;
+    Reloader rl;
+    Metrics metrics;
+    Adapt adapt;
+    Range range;
+    unsigned long long start = 0;
+    int ranged, keep, status = 0, i;
 
     memset(&opts, 0, sizeof(opts));
     opts.wordcolor = 1;
+    opts.ansi = CCZE_ANSI_KEEP;
     opts.transparent = 1;
+    opts.record_max_lines = 500;
+    opts.record_max_bytes = 1048576;
+    opts.record_flush_ms = 250;
 
     for (i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--help") == 0) {
@@ -562,28 +352,165 @@ int main(int argc, char *argv[]) {
         else if (strcmp(argv[i], "-F") == 0 || strcmp(argv[i], "--rcfile") == 0) {
             if (++i >= argc) { fprintf(stderr, "ccze: -F requires an argument\n"); return 1; }
             opts.rcfile = argv[i];
+            engine_option(&opts, argv[i - 1]);
         }
         else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--color") == 0) {
             char *eq;
             if (++i >= argc) { fprintf(stderr, "ccze: -c requires KEY=COLOR\n"); return 1; }
             eq = strchr(argv[i], '=');
             if (!eq) { fprintf(stderr, "ccze: -c format is KEY=COLOR\n"); return 1; }
-            if (g_num_overrides < MAX_COLOR_OVERRIDES) {
-                int klen = (int)(eq - argv[i]);
-                if (klen > 63) klen = 63;
-                memcpy(g_color_overrides[g_num_overrides].key, argv[i], klen);
-                g_color_overrides[g_num_overrides].key[klen] = '\0';
-                strncpy(g_color_overrides[g_num_overrides].val, eq + 1, 63);
-                g_color_overrides[g_num_overrides].val[63] = '\0';
-                g_num_overrides++;
-            }
+            if (opts.num_overrides < CCZE_MAX_OVERRIDES)
+                opts.color_overrides[opts.num_overrides++] = argv[i];
+            engine_option(&opts, argv[i - 1]);
         }
         else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--remove-facility") == 0) {
             opts.remove_facility = 1;
+            engine_option(&opts, argv[i]);
+        }
+        else if (strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "--recurse") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: %s requires a directory\n", argv[i - 1]); return 1; }
+            opts.batch_in = argv[i];
+        }
+        else if (strcmp(argv[i], "-O") == 0 || strcmp(argv[i], "--outdir") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: %s requires a directory\n", argv[i - 1]); return 1; }
+            opts.batch_out = argv[i];
         }
         else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--list-rules") == 0) {
             opts.list_rules = 1;
         }
+        else if (strcmp(argv[i], "--check-rules") == 0) {
+            opts.check_rules = 1;
+        }
+        else if (strcmp(argv[i], "--record-start") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --record-start requires a pattern\n"); return 1; }
+            opts.record_start = argv[i];
+        }
+        else if (strcmp(argv[i], "--record-max-lines") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --record-max-lines requires an argument\n"); return 1; }
+            opts.record_max_lines = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--record-max-bytes") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --record-max-bytes requires an argument\n"); return 1; }
+            opts.record_max_bytes = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--record-timeout") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --record-timeout requires an argument\n"); return 1; }
+            opts.record_flush_ms = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--grep") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --grep requires a pattern\n"); return 1; }
+            opts.grep = argv[i];
+            engine_option(&opts, argv[i - 1]);
+        }
+        else if (strcmp(argv[i], "--min-level") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --min-level requires an argument\n"); return 1; }
+            opts.min_level = ccze_parse_level(argv[i]);
+            if (opts.min_level < 0) { fprintf(stderr, "ccze: unknown level '%s'\n", argv[i]); return 1; }
+            engine_option(&opts, argv[i - 1]);
+        }
+        else if (strcmp(argv[i], "--build-index") == 0) {
+            opts.build_index = 1;
+        }
+        else if (strcmp(argv[i], "--lines") == 0) {
+            char *end;
+            if (++i >= argc) { fprintf(stderr, "ccze: --lines requires A-B\n"); return 1; }
+            opts.range.first = strtoull(argv[i], &end, 10);
+            if (*end != '-')
+                opts.range.last = opts.range.first;
+            else if (*++end == '\0')
+                opts.range.last = ~0ULL;
+            else
+                opts.range.last = strtoull(end, &end, 10);
+            if (*end || opts.range.first == 0 || opts.range.last < opts.range.first) {
+                fprintf(stderr, "ccze: bad line range '%s'\n", argv[i]);
+                return 1;
+            }
+            opts.range.has_lines = 1;
+        }
+        else if (strcmp(argv[i], "--since") == 0 || strcmp(argv[i], "--until") == 0) {
+            int since = argv[i][2] == 's';
+            long long t;
+            if (++i >= argc) { fprintf(stderr, "ccze: %s requires a time\n", argv[i - 1]); return 1; }
+            if (!ccze_parse_time(argv[i], &t)) {
+                fprintf(stderr, "ccze: cannot parse time '%s'\n", argv[i]);
+                return 1;
+            }
+            if (since) { opts.range.since = t; opts.range.has_since = 1; }
+            else       { opts.range.until = t; opts.range.has_until = 1; }
+        }
+        else if (strcmp(argv[i], "--tail") == 0) {
+            char *end;
+            if (++i >= argc) { fprintf(stderr, "ccze: --tail requires a line count\n"); return 1; }
+            opts.tail = strtoull(argv[i], &end, 10);
+            if (*end || opts.tail == 0) { fprintf(stderr, "ccze: bad line count '%s'\n", argv[i]); return 1; }
+        }
+        else if (strcmp(argv[i], "--reverse") == 0) {
+            opts.reverse = 1;
+        }
+        else if (strcmp(argv[i], "--watch") == 0) {
+            opts.watch = 1;
+        }
+        else if (strcmp(argv[i], "--adaptive") == 0) {
+            opts.adaptive = 1;
+        }
+        else if (strcmp(argv[i], "--ansi") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --ansi requires an argument\n"); return 1; }
+            if (strcmp(argv[i], "keep") == 0)       opts.ansi = CCZE_ANSI_KEEP;
+            else if (strcmp(argv[i], "strip") == 0) opts.ansi = CCZE_ANSI_STRIP;
+            else if (strcmp(argv[i], "raw") == 0)   opts.ansi = CCZE_ANSI_RAW;
+            else { fprintf(stderr, "ccze: unknown --ansi mode '%s'\n", argv[i]); return 1; }
+            engine_option(&opts, argv[i - 1]);
+        }
+        else if (strcmp(argv[i], "--spans") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --spans requires an argument\n"); return 1; }
+            if (strcmp(argv[i], "json") == 0)      opts.spans = 'j';
+            else if (strcmp(argv[i], "bin") == 0)   opts.spans = 'b';
+            else { fprintf(stderr, "ccze: unknown span format '%s'\n", argv[i]); return 1; }
+        }
+        else if (strcmp(argv[i], "--tee-html") == 0 || strcmp(argv[i], "--tee-text") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: %s requires a path\n", argv[i - 1]); return 1; }
+            if (opts.ntees == TEE_MAX) { fprintf(stderr, "ccze: at most %d --tee files\n", TEE_MAX); return 1; }
+            opts.tee_path[opts.ntees] = argv[i];
+            opts.tee_mode[opts.ntees++] = argv[i - 1][6] == 'h' ? 'h' : 'n';
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            opts.stats = 't';
+        }
+        else if (strcmp(argv[i], "--stats-json") == 0) {
+            opts.stats = 'j';
+        }
+        else if (strcmp(argv[i], "--threads") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --threads requires an argument\n"); return 1; }
+            opts.threads = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--line-threads") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --line-threads requires an argument\n"); return 1; }
+            opts.line_threads = atoi(argv[i]);
+            if (opts.line_threads <= 0) opts.line_threads = pool_default_threads();
+            engine_option(&opts, argv[i - 1]);
+        }
+        else if (strcmp(argv[i], "--serve") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --serve requires a socket path\n"); return 1; }
+            opts.serve = argv[i];
+        }
+        else if (strcmp(argv[i], "--client") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --client requires a socket path\n"); return 1; }
+            opts.client = argv[i];
+        }
+        else if (strcmp(argv[i], "--metrics-file") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --metrics-file requires a path\n"); return 1; }
+            opts.metrics_file = argv[i];
+        }
+        else if (strcmp(argv[i], "--metrics-interval") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --metrics-interval requires an argument\n"); return 1; }
+            opts.metrics_interval = atoi(argv[i]);
+        }
+        else if (strcmp(argv[i], "--metrics-format") == 0) {
+            if (++i >= argc) { fprintf(stderr, "ccze: --metrics-format requires an argument\n"); return 1; }
+            if (strcmp(argv[i], "text") == 0)      opts.metrics_json = 0;
+            else if (strcmp(argv[i], "json") == 0)  opts.metrics_json = 1;
+            else { fprintf(stderr, "ccze: unknown metrics format '%s'\n", argv[i]); return 1; }
+        }
         else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--options") == 0) {
             if (++i >= argc) { fprintf(stderr, "ccze: -o requires an argument\n"); return 1; }
             parse_option_flag(argv[i], &opts);
@@ -597,51 +524,290 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    color_init(opts.mode_override);
-    syslog_init();
+    if ((opts.tail || opts.reverse) &&
+        (opts.record_start || opts.range.has_lines || opts.range.has_since || opts.range.has_until)) {
+        fprintf(stderr, "ccze: --tail and --reverse can't be combined with --record-start, "
+                        "--lines, --since or --until\n");
+        return 1;
+    }
+
+    if (!opts.batch_in != !opts.batch_out) {
+        fprintf(stderr, "ccze: -R and -O go together\n");
+        return 1;
+    }
+    if (opts.batch_in && (opts.input_file || opts.stats || opts.spans || opts.ntees || opts.serve ||
+                          opts.client || opts.record_start || opts.tail || opts.reverse ||
+                          opts.range.has_lines || opts.range.has_since || opts.range.has_until)) {
+        fprintf(stderr, "ccze: -R can't be combined with FILE, --stats, --spans, --tee-*, --serve, "
+                        "--client, --record-start, --tail, --reverse or a range\n");
+        return 1;
+    }
+
+    /* A client only streams FILE or stdin through the daemon */
+    if (opts.client && (opts.serve || opts.list_rules || opts.check_rules || opts.build_index ||
+                        opts.stats || opts.spans || opts.ntees || opts.record_start || opts.tail ||
+                        opts.reverse || opts.range.has_lines || opts.range.has_since ||
+                        opts.range.has_until || opts.watch || opts.adaptive || opts.metrics_file)) {
+        fprintf(stderr, "ccze: --client can't be combined with --serve, -l, --check-rules, "
+                        "--build-index, --stats, --spans, --tee-*, --record-start, --tail, "
+                        "--reverse, a range, --watch, --adaptive or --metrics-file\n");
+        return 1;
+    }
+
+    color_init(&out, opts.mode_override, stdout);
+
+    /* The daemon has the rules; a client needs nothing else loaded */
+    if (opts.client && opts.engine_opt) {
+        fprintf(stderr, "ccze: %s can't be used with --client: the daemon colorizes with its own "
+                        "settings (give it to --serve)\n", opts.engine_opt);
+        return 1;
+    }
+    if (opts.client) {
+        int rc;
+        fp = stdin;
+        if (opts.input_file && (fp = fopen(opts.input_file, "rb")) == NULL) {
+            fprintf(stderr, "ccze: error: cannot open file: %s\n", opts.input_file);
+            return 1;
+        }
+        rc = client_run(opts.client, &out, fp, opts.cssfile);
+        if (fp != stdin) fclose(fp);
+        return rc;
+    }
 
-    if (opts.rcfile)
+    if (opts.rcfile) {
         conf_path = _strdup(opts.rcfile);
-    else
+    } else {
+        WIN32_FILE_ATTRIBUTE_DATA fa;
         conf_path = find_conf();
+        if (!GetFileAttributesExA(conf_path, GetFileExInfoStandard, &fa)) {
+            free(conf_path);
+            conf_path = NULL;
+        }
+    }
 
-    rules = rules_load(conf_path);
-    free(conf_path);
-
-    if (g_num_overrides > 0 && rules)
-        apply_color_overrides(rules);
+    ccze_config_init(&cfg);
+    cfg.rcfile = conf_path;
+    if (!conf_path) cfg.builtin = &ccze_builtin;
+    cfg.wordcolor = opts.wordcolor;
+    cfg.automaton = opts.automaton;
+    cfg.line_threads = opts.line_threads;
+    cfg.ansi = opts.ansi;
+    cfg.remove_facility = opts.remove_facility;
+    memcpy(cfg.color_overrides, opts.color_overrides, sizeof(cfg.color_overrides));
+    cfg.num_overrides = opts.num_overrides;
+    cfg.grep = opts.grep;
+    cfg.min_level = (CczeLevel)opts.min_level;
+    cfg.jit = opts.serve != NULL;
+    engine = ccze_open(&cfg);
+
+    if (!ccze_filter_ok(engine)) {
+        ccze_close(engine);
+        free(conf_path);
+        return 1;
+    }
 
     if (opts.list_rules) {
-        rules_list(rules);
-        rules_free(rules);
+        ccze_list_rules(engine);
+        ccze_close(engine);
+        free(conf_path);
         return 0;
     }
 
+    if (opts.check_rules) {
+        int flagged = ccze_check_rules(engine);
+        ccze_close(engine);
+        free(conf_path);
+        return flagged ? 1 : 0;
+    }
+
+    if (opts.batch_in) {
+        int rc = batch_run(engine, opts.batch_in, opts.batch_out, opts.mode_override, opts.cssfile,
+                           opts.threads > 0 ? opts.threads : pool_default_threads());
+        report_limits(engine);
+        ccze_close(engine);
+        free(conf_path);
+        return rc;
+    }
+
+    if (opts.serve) {
+        int rc = serve_run(opts.serve, engine, opts.threads > 0 ? opts.threads : pool_default_threads());
+        ccze_close(engine);
+        free(conf_path);
+        return rc;
+    }
+
+    if (opts.build_index) {
+        int ok = 0;
+        if (!opts.input_file)
+            fprintf(stderr, "ccze: --build-index requires a FILE\n");
+        else
+            ok = index_build(engine, opts.input_file);
+        ccze_close(engine);
+        free(conf_path);
+        return ok ? 0 : 1;
+    }
+
+    if (opts.record_start &&
+        !record_init(&ra, opts.record_start, opts.record_max_lines, (size_t)opts.record_max_bytes,
+                     ccze_match_context(engine))) {
+        ccze_close(engine);
+        free(conf_path);
+        return 1;
+    }
+
     fp = stdin;
     if (opts.input_file) {
         fp = fopen(opts.input_file, "r");
         if (!fp) {
             fprintf(stderr, "ccze: error: cannot open file: %s\n", opts.input_file);
-            rules_free(rules);
+            ccze_close(engine);
+            free(conf_path);
             return 1;
         }
     }
 
-    if (color_mode() == COLOR_MODE_HTML)
-        color_html_header(opts.cssfile);
+    /* Range query: jump close to the first line, then filter forward */
+    memset(&range, 0, sizeof(range));
+    range.q = opts.range;
+    range.lineno = 1;
+    ranged = opts.range.has_lines || opts.range.has_since || opts.range.has_until;
+    if (ranged && fp != stdin &&
+        !index_seek(engine, opts.input_file, &opts.range, &start, &range.lineno)) {
+        fclose(fp);
+        ccze_close(engine);
+        free(conf_path);
+        return 1;
+    }
+
+    /* Workers share the engine, so it can't be swapped under them */
+    if (opts.stats && opts.watch) {
+        fprintf(stderr, "ccze: warning: --watch is ignored with --stats\n");
+        opts.watch = 0;
+    }
+
+    if (opts.watch && !conf_path) {
+        fprintf(stderr, "ccze: warning: --watch needs a rule file; using the built-in rules\n");
+        opts.watch = 0;
+    }
+
+    if (opts.watch && !reload_start(&rl, &cfg, 1000)) {
+        fprintf(stderr, "ccze: warning: cannot watch %s\n", conf_path);
+        opts.watch = 0;
+    }
+
+    if (opts.adaptive && (opts.stats || opts.spans || opts.record_start || opts.tail || opts.reverse)) {
+        fprintf(stderr, "ccze: warning: --adaptive is ignored with --stats, --spans, --record-start, "
+                        "--tail and --reverse\n");
+        opts.adaptive = 0;
+    }
+
+    if ((opts.stats || opts.spans) && opts.metrics_file) {
+        fprintf(stderr, "ccze: warning: --metrics-file is ignored with --stats and --spans\n");
+        opts.metrics_file = NULL;
+    }
+
+    if ((opts.stats || opts.spans) && opts.ntees) {
+        fprintf(stderr, "ccze: warning: --tee-html and --tee-text are ignored with --stats and --spans\n");
+        opts.ntees = 0;
+    }
 
+    input_open(&in, fp);
     linebuf_init(&lb);
-    while (linebuf_readline(&lb, fp)) {
-        process_line(lb.buf, (int)lb.len, rules, &opts);
+    if (start) input_seek(&in, start);
+    if (opts.adaptive && !adapt_init(&adapt, &in, stdout)) {
+        fprintf(stderr, "ccze: warning: --adaptive only applies to piped input\n");
+        opts.adaptive = 0;
+    }
+
+    memset(&rctx, 0, sizeof(rctx));
+    linebuf_init(&rctx.chunk);
+    rctx.r.engine = engine;
+    rctx.r.out = &out;
+    if (opts.stats) {
+        rctx.stats = stats_start(engine, opts.threads > 0 ? opts.threads : pool_default_threads());
+    } else if (opts.spans) {
+        spans_init(&sw, opts.spans == 'b' ? SPANS_BIN : SPANS_JSON, stdout);
+        rctx.spans = &sw;
+    } else if (color_mode(&out) == COLOR_MODE_HTML) {
+        color_html_header(&out, opts.cssfile);
+    }
+    for (i = 0; i < opts.ntees; i++) {
+        Tee *t = tee_open(opts.tee_path[i], opts.tee_mode[i], opts.cssfile);
+        if (t) rctx.r.tees[rctx.r.ntees++] = t;
+    }
+    if (!opts.stats && !opts.spans) {
+        metrics_start(&metrics, &rctx.r, &lb, opts.metrics_file, opts.metrics_interval, opts.metrics_json);
+        if (opts.adaptive) metrics.adapt = &adapt;
+        rctx.metrics = &metrics;
+    }
+
+    if (opts.tail || opts.reverse) {
+        /* From the end of a file where possible, else read it through */
+        int done = fp != stdin ? tail_file(engine, opts.input_file, opts.tail, opts.reverse, emit_line, &rctx) : 0;
+        if (done < 0) status = 1;
+        if (!done) tail_input(engine, &in, opts.tail, opts.reverse, emit_line, &rctx);
+    } else if (opts.record_start) {
+        for (;;) {
+            /* Never hold a partial record while the producer is idle */
+            if (record_pending(&ra) && !input_wait(&in, opts.record_flush_ms)) {
+                record_flush(&ra, emit_record, &rctx);
+                render_commit(&rctx.r);
+                fflush(stdout);
+            }
+            if (!input_readline(&in, &lb)) break;
+            keep = ranged ? range_line(engine, &range, lb.buf, lb.len) : 1;
+            if (keep < 0) break;
+            if (!keep) continue;
+            if (opts.watch) maybe_reload(&rl, &engine, &rctx);
+            record_push(&ra, lb.buf, lb.len, in.line_off, emit_record, &rctx);
+        }
+        record_flush(&ra, emit_record, &rctx);
+        record_free(&ra);
+    } else {
+        rctx.bulk = !opts.stats && !opts.spans;
+        for (;;) {
+            /* Nothing may wait in the chunk or for a --tee writer while the
+             * producer is idle */
+            if ((rctx.chunk.len || rctx.r.ntees) && !input_wait(&in, 0)) {
+                flush_chunk(&rctx);
+                render_commit(&rctx.r);
+            }
+            if (opts.adaptive) {
+                adapt_step(&adapt, &in, &out);
+                rctx.tier = adapt.tier;
+            }
+            if (!input_readline(&in, &lb)) break;
+            keep = ranged ? range_line(engine, &range, lb.buf, lb.len) : 1;
+            if (keep < 0) break;
+            if (!keep) continue;
+            if (opts.watch) maybe_reload(&rl, &engine, &rctx);
+            process(&rctx, lb.buf, lb.len, in.line_off);
+        }
+        flush_chunk(&rctx);
     }
     fflush(stdout);
     linebuf_free(&lb);
+    linebuf_free(&rctx.chunk);
+    input_close(&in);
+
+    if (rctx.stats) {
+        Stats total;
+        stats_end(rctx.stats, &total);
+        stats_print(&total, stdout, opts.stats == 'j');
+        stats_free(&total);
+    } else if (rctx.spans) {
+        spans_free(&sw);
+    } else if (color_mode(&out) == COLOR_MODE_HTML) {
+        color_html_footer(&out);
+    }
+    for (i = 0; i < rctx.r.ntees; i++)
+        if (!tee_close(rctx.r.tees[i])) status = 1;
+    if (rctx.metrics) metrics_stop(&metrics);
 
-    if (color_mode() == COLOR_MODE_HTML)
-        color_html_footer();
-
+    if (opts.watch) reload_stop(&rl);
     if (fp != stdin) fclose(fp);
-    if (g_syslog_re) pcre2_code_free(g_syslog_re);
-    rules_free(rules);
-    return 0;
+    report_limits(engine);
+    ccze_close(engine);
+    free(conf_path);
+    return status;
 }
@@ -0,0 +1,163 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "engine.h"
+
+/* ----------------------------------------------------------------
+ * Rule stress test (--check-rules)
+ *
+ * Each rule is run, the same way apply_rules() runs it, over inputs
+ * built to provoke backtracking: long runs of one character, an
+ * unterminated quote, runs of backslashes, and runs of every
+ * punctuation character the pattern itself mentions. Timing a short
+ * and an 8x longer input tells linear patterns (~8x slower) from
+ * super-linear ones (64x and up for quadratic).
+ * ---------------------------------------------------------------- */
+
+#define CHECK_SHORT   1024
+#define CHECK_LONG    8192
+#define CHECK_RATIO   24.0   /* flag above this slowdown for 8x input */
+#define CHECK_MIN_MS  1.0    /* ignore anything faster than this */
+
+typedef struct {
+    char lead;   /* first character, or 0 */
+    char fill;   /* repeated character */
+    char alt;    /* alternates with fill when non-zero */
+} Probe;
+
+static void probe_describe(const Probe *pb, char *out, size_t cap) {
+    if (pb->alt)
+        snprintf(out, cap, "\"%c%c\"*n", pb->fill, pb->alt);
+    else if (pb->lead)
+        snprintf(out, cap, "'%c' + '%c'*n", pb->lead, pb->fill);
+    else
+        snprintf(out, cap, "'%c'*n", pb->fill);
+}
+
+static void probe_build(const Probe *pb, char *buf, int n) {
+    int i;
+    for (i = 0; i < n; i++)
+        buf[i] = (pb->alt && (i & 1)) ? pb->alt : pb->fill;
+    if (pb->lead) buf[0] = pb->lead;
+}
+
+/* Scan the whole subject like apply_rules(). Returns the pcre2 error
+ * that stopped the scan (a limit), or 0. */
+static int scan_rule(const Ccze *h, int r, const char *text, int len,
+                     pcre2_match_data *md, double *ms) {
+    pcre2_code *re = (pcre2_code *)h->rule_arr[r]->re;
+    LARGE_INTEGER freq, t0, t1;
+    PCRE2_SIZE offset = 0;
+    int rc, err = 0;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+    while (offset < (PCRE2_SIZE)len) {
+        rc = pcre2_match(re, (PCRE2_SPTR)text, len, offset, 0, md, h->rule_mctx[r]);
+        if (rc < 0) {
+            if (engine_limit_error(rc)) err = rc;
+            break;
+        }
+        {
+            PCRE2_SIZE *ov = pcre2_get_ovector_pointer(md);
+            offset = ov[1] > ov[0] ? ov[1] : ov[1] + 1;
+        }
+    }
+    QueryPerformanceCounter(&t1);
+    *ms = (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart;
+    return err;
+}
+
+/* Best of three, to keep scheduler noise out of the ratio */
+static int time_probe(const Ccze *h, int r, const Probe *pb, char *buf, int n,
+                      pcre2_match_data *md, double *ms) {
+    double t, best = 0;
+    int k, err = 0;
+    probe_build(pb, buf, n);
+    for (k = 0; k < 3; k++) {
+        err = scan_rule(h, r, buf, n, md, &t);
+        if (err) break;
+        if (k == 0 || t < best) best = t;
+    }
+    *ms = best;
+    return err;
+}
+
+static const char *limit_name(int rc) {
+    switch (rc) {
+    case PCRE2_ERROR_MATCHLIMIT: return "match limit";
+    case PCRE2_ERROR_DEPTHLIMIT: return "depth limit";
+    case PCRE2_ERROR_HEAPLIMIT:  return "heap limit";
+    default:                     return "out of memory";
+    }
+}
+
+int ccze_check_rules(const Ccze *h) {
+    static const Probe base[] = {
+        {0, 'a', 0}, {0, ' ', 0}, {0, '0', 0}, {0, '\\', 0},
+        {'"', 'a', 0}, {'\'', 'a', 0}, {0, 'a', ' '}, {0, 'a', '-'}
+    };
+    Probe probes[64];
+    char *buf = (char *)malloc(CHECK_LONG);
+    pcre2_match_data *md = pcre2_match_data_create(16, NULL);
+    int nbase = (int)(sizeof(base) / sizeof(base[0]));
+    int r, flagged = 0;
+
+    fprintf(stderr, "Checking %d rules (%d vs %d byte inputs):\n", h->nrules, CHECK_SHORT, CHECK_LONG);
+    for (r = 0; r < h->nrules; r++) {
+        const char *src = h->rule_arr[r]->pattern_src;
+        const char *p;
+        char desc[32] = "";
+        double worst = 0, worst_ms = 0;
+        int np = 0, k, err = 0;
+
+        memcpy(probes, base, sizeof(base));
+        np = nbase;
+        /* Punctuation the pattern mentions, alone and as an unclosed opener */
+        for (p = src; *p && np < 62; p++) {
+            unsigned char c = (unsigned char)*p;
+            int dup = 0;
+            if (!ispunct(c) || c == '\\') continue;
+            for (k = nbase; k < np; k++) if (probes[k].fill == (char)c) dup = 1;
+            if (dup) continue;
+            probes[np].lead = 0; probes[np].fill = (char)c; probes[np].alt = 0; np++;
+            probes[np].lead = (char)c; probes[np].fill = 'a'; probes[np].alt = 0; np++;
+        }
+
+        for (k = 0; k < np && !err; k++) {
+            double t_short, t_long, ratio;
+            err = time_probe(h, r, &probes[k], buf, CHECK_SHORT, md, &t_short);
+            if (!err) err = time_probe(h, r, &probes[k], buf, CHECK_LONG, md, &t_long);
+            if (err) {
+                probe_describe(&probes[k], desc, sizeof(desc));
+                break;
+            }
+            if (t_long < CHECK_MIN_MS) continue;
+            ratio = t_long / (t_short > 1e-6 ? t_short : 1e-6);
+            if (ratio > worst) {
+                worst = ratio;
+                worst_ms = t_long;
+                probe_describe(&probes[k], desc, sizeof(desc));
+            }
+        }
+
+        if (err) {
+            fprintf(stderr, "  %3d  LIMIT  hits %s on %s  %s\n", r + 1, limit_name(err), desc, src);
+            flagged++;
+        } else if (worst > CHECK_RATIO) {
+            fprintf(stderr, "  %3d  SLOW   x%.0f time for 8x input (%.1f ms) on %s  %s\n",
+                    r + 1, worst, worst_ms, desc, src);
+            flagged++;
+        } else {
+            fprintf(stderr, "  %3d  ok     %s\n", r + 1, src);
+        }
+    }
+    if (h->nrules == 0) fprintf(stderr, "  (none)\n");
+    fprintf(stderr, "%d rule%s flagged\n", flagged, flagged == 1 ? "" : "s");
+
+    pcre2_match_data_free(md);
+    free(buf);
+    return flagged;
+}
@@ -1,17 +1,15 @@
 #include "color.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <windows.h>
 
-static ColorMode g_mode = COLOR_MODE_NONE;
-static HANDLE    g_hout = INVALID_HANDLE_VALUE;
-
 static const char *ANSI_CODES[COL_COUNT] = {
     "\033[0m",   "\033[30m", "\033[31m", "\033[32m",
     "\033[33m",  "\033[34m", "\033[35m", "\033[36m",
     "\033[37m",  "\033[90m", "\033[91m", "\033[92m",
     "\033[93m",  "\033[94m", "\033[95m", "\033[96m",
-    "\033[97m",
+    "\033[97m",  "\033[7m",
 };
 
 static const char *HTML_COLORS[COL_COUNT] = {
@@ -19,7 +17,7 @@ static const char *HTML_COLORS[COL_COUNT] = {
     "#aa0",      "#00c",     "#c0c",     "#0aa",
     "#ccc",      "#666",     "#f55",     "#5f5",
     "#ff5",      "#55f",     "#f5f",     "#5ff",
-    "#fff",
+    "#fff",      "#000;background:#ff5",
 };
 
 static const WORD WIN_ATTRS[COL_COUNT] = {
@@ -40,6 +38,7 @@ static const WORD WIN_ATTRS[COL_COUNT] = {
     FOREGROUND_RED | FOREGROUND_BLUE | FOREGROUND_INTENSITY,
     FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY,
     FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY,
+    BACKGROUND_RED | BACKGROUND_GREEN | BACKGROUND_INTENSITY,
 };
 
 static const struct { const char *n; Color c; } COLOR_TABLE[] = {
@@ -60,88 +59,150 @@ static const struct { const char *n; Color c; } COLOR_TABLE[] = {
     {"BRIGHT_MAGENTA", COL_BRIGHT_MAGENTA},
     {"BRIGHT_CYAN",    COL_BRIGHT_CYAN},
     {"BRIGHT_WHITE",   COL_BRIGHT_WHITE},
+    {"HIGHLIGHT",      COL_HIGHLIGHT},
     {NULL, COL_RESET}
 };
 
-void color_init(int mode_override) {
-    if (mode_override == 'n') { g_mode = COLOR_MODE_NONE; return; }
-    if (mode_override == 'a') { g_mode = COLOR_MODE_ANSI; return; }
-    if (mode_override == 'h') { g_mode = COLOR_MODE_HTML; return; }
+void color_init(ColorOut *co, int mode_override, FILE *fp) {
+    HANDLE hout;
+
+    co->mode = COLOR_MODE_NONE;
+    co->hout = INVALID_HANDLE_VALUE;
+    co->fp = fp;
+    co->buf = NULL;
+    co->len = co->cap = 0;
+    co->written = 0;
+    co->sgr_len = 0;
+    if (mode_override == 'n') { co->mode = COLOR_MODE_NONE; return; }
+    if (mode_override == 'a') { co->mode = COLOR_MODE_ANSI; return; }
+    if (mode_override == 'h') { co->mode = COLOR_MODE_HTML; return; }
 
-    /* Auto-detect */
-    g_hout = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (g_hout == INVALID_HANDLE_VALUE || g_hout == NULL) {
-        g_mode = COLOR_MODE_NONE;
+    /* Auto-detect (only a console stdout gets color) */
+    if (fp != stdout) return;
+    hout = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (hout == INVALID_HANDLE_VALUE || hout == NULL)
         return;
-    }
     {
         DWORD mode = 0;
-        if (!GetConsoleMode(g_hout, &mode)) {
-            g_mode = COLOR_MODE_NONE;
+        if (!GetConsoleMode(hout, &mode))
             return;
-        }
-        if (SetConsoleMode(g_hout, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
-            g_mode = COLOR_MODE_ANSI;
+        co->hout = hout;
+        if (SetConsoleMode(hout, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+            co->mode = COLOR_MODE_ANSI;
         else
-            g_mode = COLOR_MODE_WINCON;
+            co->mode = COLOR_MODE_WINCON;
     }
 }
 
-ColorMode color_mode(void) { return g_mode; }
+void color_init_buffer(ColorOut *co, int mode_override) {
+    color_init(co, mode_override ? mode_override : 'n', NULL);
+}
 
-static void html_escape_write(const char *text, int len) {
-    int i;
+void color_free(ColorOut *co) {
+    free(co->buf);
+    co->buf = NULL;
+    co->len = co->cap = 0;
+}
+
+ColorMode color_mode(const ColorOut *co) { return co->mode; }
+
+static void out_write(ColorOut *co, const char *text, size_t len) {
+    co->written += len;
+    if (co->fp) {
+        fwrite(text, 1, len, co->fp);
+        return;
+    }
+    if (co->len + len > co->cap) {
+        co->cap = co->cap ? co->cap * 2 : 4096;
+        while (co->len + len > co->cap) co->cap *= 2;
+        co->buf = (char *)realloc(co->buf, co->cap);
+    }
+    memcpy(co->buf + co->len, text, len);
+    co->len += len;
+}
+
+static void out_puts(ColorOut *co, const char *s) { out_write(co, s, strlen(s)); }
+
+static void html_escape_write(ColorOut *co, const char *text, int len) {
+    int i, run = 0;
     for (i = 0; i < len; i++) {
+        const char *esc;
         switch (text[i]) {
-        case '<': fputs("&lt;", stdout); break;
-        case '>': fputs("&gt;", stdout); break;
-        case '&': fputs("&amp;", stdout); break;
-        case '"': fputs("&quot;", stdout); break;
-        default:  fputc(text[i], stdout); break;
+        case '<': esc = "&lt;"; break;
+        case '>': esc = "&gt;"; break;
+        case '&': esc = "&amp;"; break;
+        case '"': esc = "&quot;"; break;
+        default:  continue;
         }
+        out_write(co, text + run, (size_t)(i - run));
+        out_puts(co, esc);
+        run = i + 1;
     }
+    out_write(co, text + run, (size_t)(len - run));
 }
 
-void color_write(Color c, const char *text, int len) {
+void color_write(ColorOut *co, Color c, const char *text, int len) {
     if ((unsigned)c >= (unsigned)COL_COUNT) c = COL_RESET;
-    switch (g_mode) {
+    switch (co->mode) {
     case COLOR_MODE_NONE:
-        fwrite(text, 1, len, stdout);
+        out_write(co, text, len);
         break;
     case COLOR_MODE_ANSI:
-        fputs(ANSI_CODES[c], stdout);
-        fwrite(text, 1, len, stdout);
-        fputs(ANSI_CODES[COL_RESET], stdout);
+        out_puts(co, ANSI_CODES[c]);
+        out_write(co, text, len);
+        out_puts(co, ANSI_CODES[COL_RESET]);
+        if (co->sgr_len) out_write(co, co->sgr, co->sgr_len);
         break;
     case COLOR_MODE_WINCON: {
         CONSOLE_SCREEN_BUFFER_INFO info;
         WORD saved = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
-        if (GetConsoleScreenBufferInfo(g_hout, &info))
+        if (GetConsoleScreenBufferInfo((HANDLE)co->hout, &info))
             saved = info.wAttributes;
         if (c != COL_RESET)
-            SetConsoleTextAttribute(g_hout, WIN_ATTRS[c]);
-        fwrite(text, 1, len, stdout);
-        fflush(stdout);
-        SetConsoleTextAttribute(g_hout, saved);
+            SetConsoleTextAttribute((HANDLE)co->hout, WIN_ATTRS[c]);
+        out_write(co, text, len);
+        fflush(co->fp);
+        SetConsoleTextAttribute((HANDLE)co->hout, saved);
         break;
     }
     case COLOR_MODE_HTML:
         if (c == COL_RESET || !HTML_COLORS[c]) {
-            html_escape_write(text, len);
+            html_escape_write(co, text, len);
         } else {
-            fprintf(stdout, "<span style=\"color:%s\">", HTML_COLORS[c]);
-            html_escape_write(text, len);
-            fputs("</span>", stdout);
+            out_puts(co, "<span style=\"color:");
+            out_puts(co, HTML_COLORS[c]);
+            out_puts(co, "\">");
+            html_escape_write(co, text, len);
+            out_puts(co, "</span>");
         }
         break;
     }
 }
 
-void color_write_plain(const char *text, int len) {
-    if (g_mode == COLOR_MODE_HTML)
-        html_escape_write(text, len);
+void color_write_plain(ColorOut *co, const char *text, int len) {
+    if (co->mode == COLOR_MODE_HTML)
+        html_escape_write(co, text, len);
     else
-        fwrite(text, 1, len, stdout);
+        out_write(co, text, len);
+}
+
+void color_write_escape(ColorOut *co, const char *seq, int len) {
+    int i, reset;
+
+    if (co->mode != COLOR_MODE_ANSI) return;
+    out_write(co, seq, len);
+    if (len < 3 || seq[1] != '[' || seq[len - 1] != 'm') return;
+    /* SGR: "ESC[m", "ESC[0m" and "ESC[0;..m" start over from the default */
+    if (seq[2] == 'm' || seq[2] == ';' || (seq[2] == '0' && (seq[3] == 'm' || seq[3] == ';')))
+        co->sgr_len = 0;
+    for (reset = 1, i = 2; i < len - 1; i++)
+        if (seq[i] != '0' && seq[i] != ';') reset = 0;
+    if (reset) return;
+    if (co->sgr_len + len > sizeof(co->sgr)) co->sgr_len = 0;
+    if ((size_t)len <= sizeof(co->sgr)) {
+        memcpy(co->sgr + co->sgr_len, seq, len);
+        co->sgr_len += len;
+    }
 }
 
 Color color_parse(const char *name) {
@@ -158,15 +219,18 @@ const char *color_name(Color c) {
     return "RESET";
 }
 
-void color_html_header(const char *cssfile) {
-    fputs("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>ccze output</title>\n", stdout);
-    if (cssfile)
-        fprintf(stdout, "<link rel=\"stylesheet\" href=\"%s\">\n", cssfile);
-    else
-        fputs("<style>body{background:#1e1e1e;color:#ccc;}</style>\n", stdout);
-    fputs("</head>\n<body>\n<pre>\n", stdout);
+void color_html_header(ColorOut *co, const char *cssfile) {
+    out_puts(co, "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>ccze output</title>\n");
+    if (cssfile) {
+        out_puts(co, "<link rel=\"stylesheet\" href=\"");
+        out_puts(co, cssfile);
+        out_puts(co, "\">\n");
+    } else {
+        out_puts(co, "<style>body{background:#1e1e1e;color:#ccc;}</style>\n");
+    }
+    out_puts(co, "</head>\n<body>\n<pre>\n");
 }
 
-void color_html_footer(void) {
-    fputs("</pre>\n</body>\n</html>\n", stdout);
+void color_html_footer(ColorOut *co) {
+    out_puts(co, "</pre>\n</body>\n</html>\n");
 }
@@ -1,6 +1,8 @@
 #ifndef CCZE_COLOR_H
 #define CCZE_COLOR_H
 
+#include <stdio.h>
+
 typedef enum {
     COLOR_MODE_NONE,
     COLOR_MODE_ANSI,
@@ -14,19 +16,42 @@ typedef enum {
     COL_BLUE, COL_MAGENTA, COL_CYAN, COL_WHITE,
     COL_BRIGHT_BLACK, COL_BRIGHT_RED, COL_BRIGHT_GREEN, COL_BRIGHT_YELLOW,
     COL_BRIGHT_BLUE, COL_BRIGHT_MAGENTA, COL_BRIGHT_CYAN, COL_BRIGHT_WHITE,
+    COL_HIGHLIGHT,   /* reverse video; used for --grep hits */
     COL_COUNT
 } Color;
 
-/* Initialize color output. mode_override: 0=auto, 'n'=none, 'a'=ansi, 'h'=html */
-void color_init(int mode_override);
+/* Renderer state: one per output stream */
+typedef struct {
+    ColorMode mode;
+    void     *hout;   /* console handle (COLOR_MODE_WINCON only) */
+    FILE     *fp;     /* NULL: output collects in buf */
+    char     *buf;
+    size_t    len;
+    size_t    cap;
+    unsigned long long written;  /* bytes of output so far */
+    char      sgr[64];           /* SGR sequences the input set (--ansi keep) */
+    size_t    sgr_len;
+} ColorOut;
+
+/* Initialize color output to fp. mode_override: 0=auto, 'n'=none, 'a'=ansi, 'h'=html */
+void color_init(ColorOut *co, int mode_override, FILE *fp);
 
-ColorMode color_mode(void);
+/* Initialize color output into co->buf (0 means 'n'). The caller
+ * consumes co->buf[0..len) and resets len; color_free() releases it. */
+void color_init_buffer(ColorOut *co, int mode_override);
+void color_free(ColorOut *co);
+
+ColorMode color_mode(const ColorOut *co);
 
 /* Write text wrapped in color */
-void color_write(Color c, const char *text, int len);
+void color_write(ColorOut *co, Color c, const char *text, int len);
 
 /* Write plain text (no color, but HTML-escaped in HTML mode) */
-void color_write_plain(const char *text, int len);
+void color_write_plain(ColorOut *co, const char *text, int len);
+
+/* Pass on an escape sequence from the input. Only ANSI mode writes it;
+ * the colors it sets are put back after each color_write(). */
+void color_write_escape(ColorOut *co, const char *seq, int len);
 
 /* Parse color name string -> Color enum. Returns COL_RESET on unknown. */
 Color color_parse(const char *name);
@@ -35,7 +60,7 @@ Color color_parse(const char *name);
 const char *color_name(Color c);
 
 /* HTML mode: write document header/footer */
-void color_html_header(const char *cssfile);
-void color_html_footer(void);
+void color_html_header(ColorOut *co, const char *cssfile);
+void color_html_footer(ColorOut *co);
 
 #endif /* CCZE_COLOR_H */
@@ -0,0 +1,130 @@
+#ifndef CCZE_ENGINE_H
+#define CCZE_ENGINE_H
+
+/* Internal engine state shared by the libccze sources. Not installed. */
+
+#ifndef PCRE2_CODE_UNIT_WIDTH
+#define PCRE2_CODE_UNIT_WIDTH 8
+#endif
+#include <pcre2.h>
+#include "libccze.h"
+#include "rules.h"
+
+/* Default global match limit; PCRE2's own default (10M) lets one bad
+ * pattern stall a line for seconds. */
+#define CCZE_DEFAULT_MATCH_LIMIT 1000000
+
+typedef struct Automaton Automaton;
+typedef struct Fanout Fanout;
+
+struct Ccze {
+    Rule                 *rules;
+    Rule                **rule_arr;    /* rules in file order, index = rule_id - 1 */
+    int                   nrules;
+    unsigned char        *bulk_safe;   /* per rule: can run over many lines at once */
+    Automaton            *automaton;   /* -o automaton: which rules can match a line */
+    Fanout               *fanout;      /* line_threads: workers for long lines */
+    size_t                big_line;    /* lines this long go to the workers */
+    CczeAnsi              ansi;        /* escape sequences in the input */
+    pcre2_code          **seg_re;      /* per rule: with PCRE2_USE_OFFSET_LIMIT, or NULL
+                                        * to run the rule over a long line in one go */
+    int                   errors;      /* rule file lines that failed to load */
+    pcre2_code           *syslog_re;
+    int                   wordcolor;
+    int                   remove_facility;
+    RuleLimits            limits;      /* global limits ("set" lines) */
+    pcre2_match_context  *global_mctx; /* global limits; used by the syslog parser */
+    pcre2_match_context **rule_mctx;   /* per rule; rules with equal limits share one */
+    pcre2_match_context **mctx;        /* distinct contexts (owned) */
+    int                   nmctx;
+    volatile long        *limit_hits;  /* per rule: lines skipped on a limit */
+    char                 *grep_lit;    /* --grep as a literal, or NULL */
+    size_t                grep_lit_len;
+    pcre2_code           *grep_re;     /* --grep as a regex, or NULL */
+    int                   grep_bad;    /* --grep failed to compile */
+    CczeLevel             min_level;
+};
+
+/* filter.c */
+void filter_init(Ccze *h, const CczeConfig *cfg);
+void filter_free(Ccze *h);
+
+/* Find the --grep hits in buf as [start, end) pairs. Returns the number
+ * of hits; *hits is malloc'd (or NULL when there are none). */
+int filter_hits(const Ccze *h, const char *buf, size_t len, size_t **hits);
+
+/* wordcolor.c: keywords, paths, URIs and numbers in text no rule claimed */
+typedef struct {
+    size_t       start, end;
+    CczeSpanKind kind;
+    Color        color;
+} WordToken;
+
+/* Build the lookup tables. Called by ccze_open(); the first call must
+ * come before any other thread uses the engine. */
+void wordcolor_init(void);
+
+/* Find the next colored token in text[from..len). Returns 0 if there is
+ * none; everything between tokens is plain. */
+int wordcolor_next(const char *text, size_t len, size_t from, WordToken *tok);
+
+/* automaton.c: all the rules as one DFA, to skip those that can't match */
+
+/* Returns NULL if none of the rules could be taken */
+Automaton *automaton_build(Rule *const *rules, int nrules);
+void automaton_free(Automaton *a);
+
+/* 1 if automaton_scan() reports the rule (index into rule_arr); other
+ * rules have to be run on every line */
+int automaton_covers(const Automaton *a, int rule);
+
+/* Append to hits the covered rules that may match somewhere in text,
+ * each once: seen (one byte per rule) must start out clear and is set
+ * for the rules reported. Returns the number appended; hits may be NULL
+ * when seen is all the caller needs. */
+int automaton_scan(const Automaton *a, const char *text, size_t len, unsigned char *seen, int *hits);
+
+/* fanout.c: worker threads sharing out the items of one job */
+typedef void (*FanoutFn)(int item, void *ud);
+
+/* nthreads counts the thread calling fanout_run(). NULL if no worker
+ * could be started. */
+Fanout *fanout_start(int nthreads);
+void fanout_stop(Fanout *f);
+
+/* Run fn on items 0..n-1, on the workers and the calling thread, and
+ * return once all are done */
+void fanout_run(Fanout *f, int n, FanoutFn fn, void *ud);
+
+/* ansi.c: escape sequences already in the input (CczeConfig.ansi) */
+typedef struct {
+    size_t at;       /* offset in the stripped text it comes before */
+    size_t from;     /* offset in the line */
+    size_t len;
+} AnsiSeq;
+
+typedef struct {
+    char    *text;   /* the line without its escape sequences */
+    size_t   len;
+    AnsiSeq *seqs;
+    int      nseqs;
+} AnsiLine;
+
+/* Length of the escape sequence starting at p[0], which is ESC; at least 1 */
+size_t ansi_seq_len(const char *p, size_t len);
+
+/* Take buf apart into its text and its escape sequences; ansi_free()
+ * releases al */
+void ansi_split(const char *buf, size_t len, AnsiLine *al);
+void ansi_free(AnsiLine *al);
+
+/* ccze_colorize_tier() of buf without its escape sequences, with the
+ * spans mapped back onto buf and cut where a sequence falls; each
+ * sequence is reported as a span of its own */
+void ansi_colorize(const Ccze *h, const char *buf, size_t len, CczeTier tier,
+                   CczeSpanFn fn, void *ud, CczeTimes *t);
+
+/* Non-zero if a pcre2_match() result means a match/depth/heap limit was hit */
+int engine_limit_error(int rc);
+
+#endif /* CCZE_ENGINE_H */
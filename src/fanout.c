@@ -0,0 +1,108 @@
+#include <windows.h>
+#include <stdlib.h>
+#include "engine.h"
+
+/* ----------------------------------------------------------------
+ * Fan-out workers (line_threads)
+ *
+ * fanout_run() hands the items of one job to the workers and works on
+ * them itself until none are left, then waits for the ones still
+ * running. The workers belong to the engine, which any number of
+ * threads may share; a second caller waits for the first job to end.
+ * ---------------------------------------------------------------- */
+typedef struct {
+    FanoutFn fn;
+    void    *ud;
+    int      n, next, active;
+} FanoutJob;
+
+struct Fanout {
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE work;      /* a job has items left, or closing */
+    CONDITION_VARIABLE done;      /* a job ran dry, or ended */
+    FanoutJob         *job;
+    int                closing;
+    HANDLE            *threads;
+    int                nthreads;
+};
+
+/* Run items of job until none are left; entered and left with the lock held */
+static void fanout_items(Fanout *f, FanoutJob *job) {
+    while (job->next < job->n) {
+        int i = job->next++;
+        job->active++;
+        LeaveCriticalSection(&f->lock);
+        job->fn(i, job->ud);
+        EnterCriticalSection(&f->lock);
+        job->active--;
+    }
+    if (!job->active) WakeAllConditionVariable(&f->done);
+}
+
+static DWORD WINAPI fanout_thread(void *arg) {
+    Fanout *f = (Fanout *)arg;
+
+    EnterCriticalSection(&f->lock);
+    for (;;) {
+        while (!f->closing && !(f->job && f->job->next < f->job->n))
+            SleepConditionVariableCS(&f->work, &f->lock, INFINITE);
+        if (f->closing) break;
+        fanout_items(f, f->job);
+    }
+    LeaveCriticalSection(&f->lock);
+    return 0;
+}
+
+Fanout *fanout_start(int nthreads) {
+    Fanout *f = (Fanout *)calloc(1, sizeof(Fanout));
+    int i;
+
+    InitializeCriticalSection(&f->lock);
+    InitializeConditionVariable(&f->work);
+    InitializeConditionVariable(&f->done);
+    f->threads = (HANDLE *)malloc(nthreads * sizeof(HANDLE));
+    for (i = 0; i < nthreads - 1; i++) {
+        f->threads[f->nthreads] = CreateThread(NULL, 0, fanout_thread, f, 0, NULL);
+        if (!f->threads[f->nthreads]) break;
+        f->nthreads++;
+    }
+    if (!f->nthreads) {
+        fanout_stop(f);
+        return NULL;
+    }
+    return f;
+}
+
+void fanout_run(Fanout *f, int n, FanoutFn fn, void *ud) {
+    FanoutJob job;
+
+    job.fn = fn;
+    job.ud = ud;
+    job.n = n;
+    job.next = job.active = 0;
+    EnterCriticalSection(&f->lock);
+    while (f->job) SleepConditionVariableCS(&f->done, &f->lock, INFINITE);
+    f->job = &job;
+    WakeAllConditionVariable(&f->work);
+    fanout_items(f, &job);
+    while (job.active) SleepConditionVariableCS(&f->done, &f->lock, INFINITE);
+    f->job = NULL;
+    WakeAllConditionVariable(&f->done);
+    LeaveCriticalSection(&f->lock);
+}
+
+void fanout_stop(Fanout *f) {
+    int i;
+    if (!f) return;
+    EnterCriticalSection(&f->lock);
+    f->closing = 1;
+    WakeAllConditionVariable(&f->work);
+    LeaveCriticalSection(&f->lock);
+    for (i = 0; i < f->nthreads; i++) {
+        WaitForSingleObject(f->threads[i], INFINITE);
+        CloseHandle(f->threads[i]);
+    }
+    DeleteCriticalSection(&f->lock);
+    free(f->threads);
+    free(f);
+}
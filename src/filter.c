@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "engine.h"
+
+/* ----------------------------------------------------------------
+ * Line filter (--grep / --min-level)
+ *
+ * Runs before any rule matching. A --grep pattern without regex
+ * metacharacters is searched as a plain literal; anything else goes
+ * through PCRE2 with JIT when it's available.
+ * ---------------------------------------------------------------- */
+
+static int is_literal(const char *pat) {
+    return strpbrk(pat, "\\^$.|?*+()[]{}") == NULL;
+}
+
+static const char *find_literal(const char *hay, size_t n, const char *needle, size_t m) {
+    const char *p = hay, *end = hay + n;
+    if (m == 0 || m > n) return NULL;
+    while ((p = (const char *)memchr(p, needle[0], (size_t)(end - p) - m + 1)) != NULL) {
+        if (memcmp(p, needle, m) == 0) return p;
+        p++;
+        if ((size_t)(end - p) < m) break;
+    }
+    return NULL;
+}
+
+void filter_init(Ccze *h, const CczeConfig *cfg) {
+    h->min_level = cfg->min_level;
+    if (!cfg->grep || !*cfg->grep) return;
+
+    if (is_literal(cfg->grep)) {
+        h->grep_lit = _strdup(cfg->grep);
+        h->grep_lit_len = strlen(cfg->grep);
+    } else {
+        int err;
+        PCRE2_SIZE erroff;
+        h->grep_re = pcre2_compile((PCRE2_SPTR)cfg->grep, PCRE2_ZERO_TERMINATED, 0,
+                                   &err, &erroff, NULL);
+        if (!h->grep_re) {
+            PCRE2_UCHAR errbuf[256];
+            pcre2_get_error_message(err, errbuf, sizeof(errbuf));
+            fprintf(stderr, "ccze: error: --grep: regex error at offset %d: %s\n",
+                    (int)erroff, (char *)errbuf);
+            h->grep_bad = 1;
+            return;
+        }
+        pcre2_jit_compile(h->grep_re, PCRE2_JIT_COMPLETE);
+    }
+}
+
+void filter_free(Ccze *h) {
+    free(h->grep_lit);
+    if (h->grep_re) pcre2_code_free(h->grep_re);
+}
+
+int filter_hits(const Ccze *h, const char *buf, size_t len, size_t **hits) {
+    size_t *v = NULL;
+    int n = 0, cap = 0;
+    size_t off = 0;
+    pcre2_match_data *md = NULL;
+
+    *hits = NULL;
+    if (!h->grep_lit && !h->grep_re) return 0;
+    if (h->grep_re) md = pcre2_match_data_create(1, NULL);
+
+    while (off < len) {
+        size_t s, e;
+        if (h->grep_lit) {
+            const char *p = find_literal(buf + off, len - off, h->grep_lit, h->grep_lit_len);
+            if (!p) break;
+            s = (size_t)(p - buf);
+            e = s + h->grep_lit_len;
+        } else {
+            PCRE2_SIZE *ov;
+            if (pcre2_match(h->grep_re, (PCRE2_SPTR)buf, len, off, 0, md, h->global_mctx) < 0) break;
+            ov = pcre2_get_ovector_pointer(md);
+            s = ov[0];
+            e = ov[1];
+            if (e <= s) { off = e + 1; continue; }
+        }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 8;
+            v = (size_t *)realloc(v, cap * 2 * sizeof(size_t));
+        }
+        v[2 * n] = s;
+        v[2 * n + 1] = e;
+        n++;
+        off = e;
+    }
+    if (md) pcre2_match_data_free(md);
+    *hits = v;
+    return n;
+}
+
+static int filter_text(const Ccze *h, const char *buf, size_t len) {
+    if (h->min_level && ccze_line_level(buf, len) < h->min_level) return 0;
+    if (h->grep_lit)
+        return find_literal(buf, len, h->grep_lit, h->grep_lit_len) != NULL;
+    if (h->grep_re) {
+        pcre2_match_data *md = pcre2_match_data_create(1, NULL);
+        int rc = pcre2_match(h->grep_re, (PCRE2_SPTR)buf, len, 0, 0, md, h->global_mctx);
+        pcre2_match_data_free(md);
+        return rc >= 0;
+    }
+    return 1;
+}
+
+int ccze_filter(const Ccze *h, const char *buf, size_t len) {
+    if (h->grep_bad) return 0;
+    if (h->ansi != CCZE_ANSI_RAW && (h->grep_lit || h->grep_re || h->min_level) &&
+        memchr(buf, 0x1B, len)) {
+        /* Match the text as it will be shown */
+        AnsiLine al;
+        int keep;
+        ansi_split(buf, len, &al);
+        keep = filter_text(h, al.text, al.len);
+        ansi_free(&al);
+        return keep;
+    }
+    return filter_text(h, buf, len);
+}
+
+int ccze_filter_ok(const Ccze *h) { return !h->grep_bad; }
+
+/* ----------------------------------------------------------------
+ * Level classifier
+ * ---------------------------------------------------------------- */
+static const struct { const char *word; CczeLevel level; } LEVEL_WORDS[] = {
+    {"FATAL", CCZE_LEVEL_CRIT},    {"CRIT", CCZE_LEVEL_CRIT},
+    {"CRITICAL", CCZE_LEVEL_CRIT}, {"EMERG", CCZE_LEVEL_CRIT},
+    {"ALERT", CCZE_LEVEL_CRIT},    {"PANIC", CCZE_LEVEL_CRIT},
+    {"SEVERE", CCZE_LEVEL_CRIT},
+    {"ERROR", CCZE_LEVEL_ERROR},   {"ERR", CCZE_LEVEL_ERROR},
+    {"FAILED", CCZE_LEVEL_ERROR},  {"FAILURE", CCZE_LEVEL_ERROR},
+    {"WARN", CCZE_LEVEL_WARN},     {"WARNING", CCZE_LEVEL_WARN},
+    {"CAUTION", CCZE_LEVEL_WARN},
+    {"NOTICE", CCZE_LEVEL_NOTICE},
+    {"INFO", CCZE_LEVEL_INFO},     {"INFORMATION", CCZE_LEVEL_INFO},
+    {"DEBUG", CCZE_LEVEL_DEBUG},   {"TRACE", CCZE_LEVEL_DEBUG},
+    {"VERBOSE", CCZE_LEVEL_DEBUG}, {"FINE", CCZE_LEVEL_DEBUG},
+    {"FINER", CCZE_LEVEL_DEBUG},   {"FINEST", CCZE_LEVEL_DEBUG},
+    {NULL, CCZE_LEVEL_NONE}
+};
+
+static CczeLevel level_word(const char *w, size_t wlen) {
+    int i;
+    for (i = 0; LEVEL_WORDS[i].word; i++) {
+        const char *k = LEVEL_WORDS[i].word;
+        if (strlen(k) == wlen && _strnicmp(w, k, wlen) == 0)
+            return LEVEL_WORDS[i].level;
+    }
+    return CCZE_LEVEL_NONE;
+}
+
+CczeLevel ccze_line_level(const char *buf, size_t len) {
+    static const CczeLevel SYSLOG_SEVERITY[8] = {
+        CCZE_LEVEL_CRIT, CCZE_LEVEL_CRIT, CCZE_LEVEL_CRIT, CCZE_LEVEL_ERROR,
+        CCZE_LEVEL_WARN, CCZE_LEVEL_NOTICE, CCZE_LEVEL_INFO, CCZE_LEVEL_DEBUG
+    };
+    CczeLevel best = CCZE_LEVEL_NONE;
+    size_t i = 0;
+
+    /* "<PRI>" prefix: severity is PRI & 7 */
+    if (len > 2 && buf[0] == '<' && isdigit((unsigned char)buf[1])) {
+        unsigned pri = 0;
+        for (i = 1; i < len && i < 5 && isdigit((unsigned char)buf[i]); i++)
+            pri = pri * 10 + (unsigned)(buf[i] - '0');
+        if (i < len && buf[i] == '>') return SYSLOG_SEVERITY[pri & 7];
+        i = 0;
+    }
+
+    while (i < len) {
+        size_t ws;
+        CczeLevel lv;
+        while (i < len && !isalpha((unsigned char)buf[i])) i++;
+        ws = i;
+        while (i < len && isalpha((unsigned char)buf[i])) i++;
+        if (i - ws < 3 || i - ws > 11) continue;
+        lv = level_word(buf + ws, i - ws);
+        if (lv > best) {
+            best = lv;
+            if (best == CCZE_LEVEL_CRIT) break;
+        }
+    }
+    return best;
+}
+
+static const char *LEVEL_NAMES[] = { "none", "debug", "info", "notice", "warn", "error", "crit" };
+
+const char *ccze_level_name(CczeLevel level) {
+    if ((unsigned)level > CCZE_LEVEL_CRIT) return "none";
+    return LEVEL_NAMES[level];
+}
+
+int ccze_parse_level(const char *name) {
+    int i;
+    for (i = CCZE_LEVEL_DEBUG; i <= CCZE_LEVEL_CRIT; i++)
+        if (_stricmp(name, LEVEL_NAMES[i]) == 0) return i;
+    if (_stricmp(name, "warning") == 0) return CCZE_LEVEL_WARN;
+    return -1;
+}
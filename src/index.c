@@ -0,0 +1,311 @@
+#include "index.h"
+#include "input.h"
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_MAGIC     "CCZI\x01\0\0\0"
+#define INDEX_HEADER    32
+#define INDEX_PROBE     64     /* lines to look ahead for a timestamp */
+#define INDEX_SEEK_SLOP 4096   /* stop bisecting the file below this */
+
+typedef struct {
+    unsigned long long off;
+    long long          ts;
+} IndexEntry;
+
+static char *index_path(const char *path) {
+    size_t n = strlen(path);
+    char *p = (char *)malloc(n + 6);
+    memcpy(p, path, n);
+    memcpy(p + n, ".cczi", 6);
+    return p;
+}
+
+static int file_size(const char *path, unsigned long long *size) {
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fad)) return 0;
+    *size = ((unsigned long long)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    return 1;
+}
+
+/* A year-less query time compares against the line time without its year */
+static long long query_key(long long q, long long t) {
+    return q < CCZE_TIME_YEAR ? t % CCZE_TIME_YEAR : t;
+}
+
+static void put_le(FILE *fp, unsigned long long v, int nbytes) {
+    unsigned char b[8];
+    int i;
+    for (i = 0; i < nbytes; i++) b[i] = (unsigned char)(v >> (8 * i));
+    fwrite(b, 1, nbytes, fp);
+}
+
+static unsigned long long get_le(const unsigned char *b, int nbytes) {
+    unsigned long long v = 0;
+    int i;
+    for (i = nbytes - 1; i >= 0; i--) v = (v << 8) | b[i];
+    return v;
+}
+
+/* ----------------------------------------------------------------
+ * Building
+ * ---------------------------------------------------------------- */
+int index_build(const Ccze *h, const char *path) {
+    FILE *fp, *out;
+    Input in;
+    LineBuf lb;
+    IndexEntry *v = NULL;
+    unsigned long long lines = 0;
+    long long pending = -1;   /* entry still looking for its timestamp */
+    long long last = INDEX_NO_TIME;  /* last timestamp read so far */
+    size_t n = 0, cap = 0, i;
+    char *ipath;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "ccze: error: cannot open file: %s\n", path);
+        return 0;
+    }
+    input_open(&in, fp);
+    linebuf_init(&lb);
+    while (input_readline(&in, &lb)) {
+        long long t;
+        if (lines % INDEX_STRIDE == 0) {
+            /* A stride without timestamps gets the last one before it: its
+             * lines may be later than the time of the entry before */
+            if (pending >= 0) v[pending].ts = last;
+            if (n == cap) {
+                cap = cap ? cap * 2 : 1024;
+                v = (IndexEntry *)realloc(v, cap * sizeof(IndexEntry));
+            }
+            v[n].off = in.line_off;
+            v[n].ts = INDEX_NO_TIME;
+            pending = (long long)n++;
+        }
+        if (ccze_line_time(h, lb.buf, lb.len, &t)) {
+            if (pending >= 0) v[pending].ts = t;
+            pending = -1;
+            last = t;
+        }
+        lines++;
+    }
+    if (pending >= 0) v[pending].ts = last;
+    linebuf_free(&lb);
+    input_close(&in);
+    fclose(fp);
+
+    ipath = index_path(path);
+    out = fopen(ipath, "wb");
+    if (!out) {
+        fprintf(stderr, "ccze: error: cannot write %s\n", ipath);
+        free(ipath);
+        free(v);
+        return 0;
+    }
+    fwrite(INDEX_MAGIC, 1, 8, out);
+    put_le(out, in.pos, 8);
+    put_le(out, INDEX_STRIDE, 4);
+    put_le(out, 0, 4);
+    put_le(out, n, 8);
+    for (i = 0; i < n; i++) {
+        put_le(out, v[i].off, 8);
+        put_le(out, (unsigned long long)v[i].ts, 8);
+    }
+    fclose(out);
+    fprintf(stderr, "ccze: indexed %llu lines of %s (%u entries) in %s\n",
+            lines, path, (unsigned)n, ipath);
+    free(ipath);
+    free(v);
+    return 1;
+}
+
+/* ----------------------------------------------------------------
+ * Seeking with the index
+ * ---------------------------------------------------------------- */
+
+/* Load path.cczi; 0 if it is missing, damaged or older than the file */
+static int index_load(const char *path, IndexEntry **entries, size_t *count, unsigned *stride) {
+    char *ipath = index_path(path);
+    FILE *fp = fopen(ipath, "rb");
+    unsigned char hdr[INDEX_HEADER], rec[16];
+    unsigned long long indexed, cur, isize, n, i;
+    IndexEntry *v;
+
+    if (!fp) {
+        free(ipath);
+        return 0;
+    }
+    if (fread(hdr, 1, INDEX_HEADER, fp) != INDEX_HEADER || memcmp(hdr, INDEX_MAGIC, 8) != 0) {
+        fprintf(stderr, "ccze: warning: %s is not a ccze index, ignoring it\n", ipath);
+        goto fail;
+    }
+    indexed = get_le(hdr + 8, 8);
+    if (!file_size(path, &cur) || cur < indexed) {
+        fprintf(stderr, "ccze: warning: %s is stale, ignoring it (rerun --build-index)\n", ipath);
+        goto fail;
+    }
+    *stride = (unsigned)get_le(hdr + 16, 4);
+    n = get_le(hdr + 24, 8);
+    if (*stride == 0 || n == 0) goto fail;
+    if (!file_size(ipath, &isize) || n > isize / 16 || isize != INDEX_HEADER + n * 16) {
+        fprintf(stderr, "ccze: warning: %s is not a ccze index, ignoring it\n", ipath);
+        goto fail;
+    }
+    v = (IndexEntry *)malloc((size_t)n * sizeof(IndexEntry));
+    if (!v) goto fail;
+    for (i = 0; i < n; i++) {
+        if (fread(rec, 1, 16, fp) != 16) {
+            free(v);
+            goto fail;
+        }
+        v[i].off = get_le(rec, 8);
+        v[i].ts = (long long)get_le(rec + 8, 8);
+    }
+    fclose(fp);
+    free(ipath);
+    *entries = v;
+    *count = (size_t)n;
+    return 1;
+
+fail:
+    fclose(fp);
+    free(ipath);
+    return 0;
+}
+
+/* Last entry whose time is before since, or 0 */
+static size_t index_find_time(const IndexEntry *v, size_t n, long long since) {
+    size_t lo = 0, hi = n;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (v[mid].ts == INDEX_NO_TIME || query_key(since, v[mid].ts) < since)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* ----------------------------------------------------------------
+ * Seeking without an index
+ * ---------------------------------------------------------------- */
+/* First line start at or after pos, and the first timestamp found within
+ * INDEX_PROBE lines of it. Returns 0 if none was found. */
+static int map_time_at(const Ccze *h, const FileMap *fm, size_t pos, size_t *line, long long *t) {
+    const char *end = fm->base + fm->size, *p;
+    int k;
+
+    if (pos > 0) {
+        p = (const char *)memchr(fm->base + pos - 1, '\n', fm->size - (pos - 1));
+        if (!p) return 0;
+        pos = (size_t)(p + 1 - fm->base);
+    }
+    *line = pos;
+    p = fm->base + pos;
+    for (k = 0; k < INDEX_PROBE && p < end; k++) {
+        const char *nl = (const char *)memchr(p, '\n', (size_t)(end - p));
+        const char *le = nl ? nl + 1 : end;
+        if (ccze_line_time(h, p, (size_t)(le - p), t)) return 1;
+        p = le;
+    }
+    return 0;
+}
+
+static size_t map_find_time(const Ccze *h, const FileMap *fm, long long since) {
+    size_t lo = 0, hi = fm->size;
+    while (hi - lo > INDEX_SEEK_SLOP) {
+        size_t mid = lo + (hi - lo) / 2, line;
+        long long t;
+        /* No timestamp nearby: searching lower only costs a longer skip */
+        if (!map_time_at(h, fm, mid, &line, &t) || line >= hi || query_key(since, t) >= since)
+            hi = mid;
+        else
+            lo = line;
+    }
+    return lo;
+}
+
+/* Offset of line number first (1-based), by counting newlines */
+static size_t map_find_line(const FileMap *fm, unsigned long long first, unsigned long long *lineno) {
+    const char *p = fm->base, *end = fm->base + fm->size;
+    unsigned long long n = 1;
+    while (n < first && p < end) {
+        const char *nl = (const char *)memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        p = nl + 1;
+        n++;
+    }
+    *lineno = n;
+    return (size_t)(p - fm->base);
+}
+
+int index_seek(const Ccze *h, const char *path, const RangeQuery *q,
+               unsigned long long *offset, unsigned long long *lineno) {
+    IndexEntry *v;
+    size_t n;
+    unsigned stride;
+    FileMap fm;
+    size_t bom;
+
+    *offset = 0;
+    *lineno = 1;
+    if (!q->has_lines && !q->has_since) return 1;
+
+    if (index_load(path, &v, &n, &stride)) {
+        size_t e = 0;
+        if (q->has_lines) {
+            e = (size_t)((q->first - 1) / stride);
+            if (e >= n) e = n - 1;
+        }
+        if (q->has_since) {
+            size_t et = index_find_time(v, n, q->since);
+            if (et > e) e = et;
+        }
+        *offset = v[e].off;
+        *lineno = (unsigned long long)e * stride + 1;
+        free(v);
+        return 1;
+    }
+
+    if (!filemap_open(&fm, path)) {
+        fprintf(stderr, "ccze: error: cannot map file: %s\n", path);
+        return 0;
+    }
+    /* UTF-16 can't be searched as bytes; the caller filters from the top */
+    if (fm.size > 0 && input_sniff(fm.base, fm.size, &bom) == ENC_UTF8) {
+        if (q->has_lines) {
+            *offset = map_find_line(&fm, q->first, lineno);
+        } else {
+            *offset = map_find_time(h, &fm, q->since);
+            *lineno = 0;
+        }
+    }
+    filemap_close(&fm);
+    return 1;
+}
+
+/* ----------------------------------------------------------------
+ * Forward filtering
+ * ---------------------------------------------------------------- */
+int range_line(const Ccze *h, Range *r, const char *buf, size_t len) {
+    const RangeQuery *q = &r->q;
+    unsigned long long n = r->lineno++;
+
+    if (q->has_lines) {
+        if (n < q->first) return 0;
+        if (n > q->last) return -1;
+    }
+    if (q->has_since || q->has_until) {
+        long long t;
+        if (ccze_line_time(h, buf, len, &t)) {
+            r->ts = t;
+            r->has_ts = 1;
+        }
+        /* Lines without a time belong to the last timestamped one */
+        if (q->has_since && (!r->has_ts || query_key(q->since, r->ts) < q->since)) return 0;
+        if (q->has_until && r->has_ts && query_key(q->until, r->ts) > q->until) return -1;
+    }
+    return 1;
+}
@@ -0,0 +1,51 @@
+#ifndef CCZE_INDEX_H
+#define CCZE_INDEX_H
+
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Sidecar line/time index (--build-index) and range queries
+ * (--lines, --since, --until)
+ *
+ * FILE.cczi holds one entry every INDEX_STRIDE lines (little-endian):
+ *   "CCZI" 0x01 0x00 0x00 0x00, u64 indexed file size, u32 stride,
+ *   u32 reserved, u64 nentries,
+ *   nentries x { u64 offset, i64 time }
+ * Entry i starts line i*stride + 1. Its time is the first timestamp at
+ * or after that line (see ccze_line_time), or when the stride has none,
+ * the last timestamp before it. An index stays usable while
+ * the file only grows, so an appended-to log needn't be re-indexed.
+ * ---------------------------------------------------------------- */
+#define INDEX_STRIDE  1024
+#define INDEX_NO_TIME ((long long)(-0x7fffffffffffffffLL - 1))
+
+typedef struct {
+    int                has_lines;
+    unsigned long long first, last;  /* 1-based, inclusive */
+    int                has_since, has_until;
+    long long          since, until; /* time keys; year-less keys ignore the year */
+} RangeQuery;
+
+/* Forward filter over the lines read from where index_seek() starts */
+typedef struct {
+    RangeQuery         q;
+    unsigned long long lineno;       /* number of the next line */
+    long long          ts;           /* time of the last timestamped line */
+    int                has_ts;
+} Range;
+
+/* Write path.cczi. Returns 0 on error (reported on stderr). */
+int index_build(const Ccze *h, const char *path);
+
+/* Find where to start reading for q: a line start at or before the first
+ * line in range, and that line's number (0 if unknown). Uses path.cczi
+ * when present and not stale, so the cost doesn't depend on file size;
+ * otherwise binary-searches a mapping of the file by time, or counts
+ * newlines for --lines. Returns 0 on error. */
+int index_seek(const Ccze *h, const char *path, const RangeQuery *q,
+               unsigned long long *offset, unsigned long long *lineno);
+
+/* Check the next line: 1 to show it, 0 to skip it, -1 once past the range */
+int range_line(const Ccze *h, Range *r, const char *buf, size_t len);
+
+#endif /* CCZE_INDEX_H */
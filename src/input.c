@@ -0,0 +1,338 @@
+#include "input.h"
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define INPUT_SSE2
+#endif
+
+#define INPUT_BLOCK 65536
+#define INPUT_SNIFF 4096     /* bytes examined for BOM-less UTF-16 */
+
+void linebuf_init(LineBuf *lb) {
+    lb->cap = 4096;
+    lb->buf = (char *)malloc(lb->cap);
+    lb->buf[0] = '\0';
+    lb->len = 0;
+}
+
+void linebuf_free(LineBuf *lb) { free(lb->buf); }
+
+void linebuf_append(LineBuf *lb, const char *text, size_t len) {
+    if (lb->len + len + 1 > lb->cap) {
+        while (lb->len + len + 1 > lb->cap) lb->cap *= 2;
+        lb->buf = (char *)realloc(lb->buf, lb->cap);
+    }
+    memcpy(lb->buf + lb->len, text, len);
+    lb->len += len;
+    lb->buf[lb->len] = '\0';
+}
+
+/* ----------------------------------------------------------------
+ * Encodings
+ * ---------------------------------------------------------------- */
+Encoding input_sniff(const char *buf, size_t len, size_t *bom) {
+    const unsigned char *b = (const unsigned char *)buf;
+    size_t i, pairs = len / 2, zeven = 0, zodd = 0;
+
+    *bom = 0;
+    if (len >= 3 && b[0] == 0xEF && b[1] == 0xBB && b[2] == 0xBF) {
+        *bom = 3;
+        return ENC_UTF8;
+    }
+    if (len >= 2 && b[0] == 0xFF && b[1] == 0xFE) {
+        *bom = 2;
+        return ENC_UTF16LE;
+    }
+    if (len >= 2 && b[0] == 0xFE && b[1] == 0xFF) {
+        *bom = 2;
+        return ENC_UTF16BE;
+    }
+    if (pairs > INPUT_SNIFF / 2) pairs = INPUT_SNIFF / 2;
+    for (i = 0; i < pairs; i++) {
+        zeven += b[2 * i] == 0;
+        zodd += b[2 * i + 1] == 0;
+    }
+    /* Log text is mostly ASCII, so UTF-16 has a NUL in most units, nearly
+     * always on the same side; binary data has them on both */
+    if (pairs >= 2 && zodd * 2 >= pairs && zeven * 16 < zodd) return ENC_UTF16LE;
+    if (pairs >= 2 && zeven * 2 >= pairs && zodd * 16 < zeven) return ENC_UTF16BE;
+    return ENC_UTF8;
+}
+
+static size_t put_utf8(char *out, unsigned cp) {
+    unsigned char *o = (unsigned char *)out;
+    if (cp < 0x800) {
+        o[0] = (unsigned char)(0xC0 | cp >> 6);
+        o[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        o[0] = (unsigned char)(0xE0 | cp >> 12);
+        o[1] = (unsigned char)(0x80 | (cp >> 6 & 0x3F));
+        o[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    o[0] = (unsigned char)(0xF0 | cp >> 18);
+    o[1] = (unsigned char)(0x80 | (cp >> 12 & 0x3F));
+    o[2] = (unsigned char)(0x80 | (cp >> 6 & 0x3F));
+    o[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Transcode UTF-16 in raw[0..len) into out (which must hold 3 bytes per
+ * unit) and set *outlen. A unit or surrogate pair cut off at the end is
+ * left for the next block unless final. Unpaired surrogates become
+ * U+FFFD. Returns the raw bytes consumed. */
+static size_t utf16_to_utf8(const unsigned char *raw, size_t len, int be, int final,
+                            char *out, size_t *outlen) {
+    size_t i = 0, o = 0;
+    unsigned u, lo;
+
+    while (i + 2 <= len) {
+#ifdef INPUT_SSE2
+        /* ASCII runs, eight units at a time */
+        while (i + 16 <= len) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(raw + i));
+            if (be) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFF80)),
+                                                  _mm_setzero_si128())) != 0xFFFF)
+                break;
+            _mm_storel_epi64((__m128i *)(out + o), _mm_packus_epi16(v, v));
+            i += 16;
+            o += 8;
+        }
+        if (i + 2 > len) break;
+#endif
+        u = be ? (unsigned)raw[i] << 8 | raw[i + 1] : (unsigned)raw[i + 1] << 8 | raw[i];
+        if (u < 0x80) {
+            out[o++] = (char)u;
+            i += 2;
+            continue;
+        }
+        if (u >= 0xD800 && u <= 0xDBFF) {
+            if (i + 4 > len) {
+                if (!final) break;
+                u = 0xFFFD;
+            } else {
+                lo = be ? (unsigned)raw[i + 2] << 8 | raw[i + 3] : (unsigned)raw[i + 3] << 8 | raw[i + 2];
+                if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                    u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 2;
+                } else {
+                    u = 0xFFFD;
+                }
+            }
+        } else if (u >= 0xDC00 && u <= 0xDFFF) {
+            u = 0xFFFD;
+        }
+        o += put_utf8(out + o, u);
+        i += 2;
+    }
+    /* A file with an odd length */
+    if (final && i < len) {
+        o += put_utf8(out + o, 0xFFFD);
+        i = len;
+    }
+    *outlen = o;
+    return i;
+}
+
+/* Bytes of the original file behind n bytes of text from rbuf. A UTF-8
+ * lead byte is one UTF-16 unit, except 4-byte sequences, which are two. */
+static size_t raw_bytes(const Input *in, const char *text, size_t n) {
+    const unsigned char *p = (const unsigned char *)text;
+    size_t i, units = 0;
+    if (in->enc == ENC_UTF8) return n;
+    for (i = 0; i < n; i++)
+        units += ((p[i] & 0xC0) != 0x80) + (p[i] >= 0xF0);
+    return units * 2;
+}
+
+/* ----------------------------------------------------------------
+ * Reader
+ * ---------------------------------------------------------------- */
+void input_open(Input *in, FILE *fp) {
+    size_t bom;
+    int n;
+
+    in->fd = _fileno(fp);
+    _setmode(in->fd, _O_BINARY);
+    in->rcap = INPUT_BLOCK;
+    in->rbuf = (char *)malloc(in->rcap);
+    in->rpos = in->rlen = 0;
+    in->eof = 0;
+    in->pos = in->line_off = 0;
+    in->enc = ENC_UTF8;
+    in->tbuf = NULL;
+    in->tlen = 0;
+
+    /* Sniff the first block */
+    n = _read(in->fd, in->rbuf, (unsigned)in->rcap);
+    if (n <= 0) {
+        in->eof = 1;
+        return;
+    }
+    in->enc = input_sniff(in->rbuf, (size_t)n, &bom);
+    in->pos = bom;
+    if (in->enc == ENC_UTF8) {
+        in->rpos = bom;
+        in->rlen = (size_t)n;
+        return;
+    }
+    in->tbuf = (char *)malloc(INPUT_BLOCK);
+    in->tlen = (size_t)n - bom;
+    memcpy(in->tbuf, in->rbuf + bom, in->tlen);
+    in->rcap = INPUT_BLOCK / 2 * 3 + 4;
+    in->rbuf = (char *)realloc(in->rbuf, in->rcap);
+}
+
+void input_close(Input *in) {
+    free(in->rbuf);
+    free(in->tbuf);
+}
+
+void input_seek(Input *in, unsigned long long offset) {
+    _lseeki64(in->fd, (__int64)offset, SEEK_SET);
+    in->rpos = in->rlen = 0;
+    in->tlen = 0;
+    in->eof = 0;
+    in->pos = in->line_off = offset;
+}
+
+static int input_fill(Input *in) {
+    int n;
+    if (in->eof) return 0;
+    if (in->enc == ENC_UTF8) {
+        n = _read(in->fd, in->rbuf, (unsigned)in->rcap);
+        if (n <= 0) { in->eof = 1; return 0; }
+        in->rpos = 0;
+        in->rlen = (size_t)n;
+        return 1;
+    }
+    for (;;) {
+        size_t out, used;
+        used = utf16_to_utf8((const unsigned char *)in->tbuf, in->tlen, in->enc == ENC_UTF16BE,
+                             in->eof, in->rbuf, &out);
+        memmove(in->tbuf, in->tbuf + used, in->tlen - used);
+        in->tlen -= used;
+        if (out > 0) {
+            in->rpos = 0;
+            in->rlen = out;
+            return 1;
+        }
+        if (in->eof) return 0;
+        /* Only part of a unit so far */
+        n = _read(in->fd, in->tbuf + in->tlen, (unsigned)(INPUT_BLOCK - in->tlen));
+        if (n <= 0) in->eof = 1;
+        else in->tlen += (size_t)n;
+    }
+}
+
+int input_readline(Input *in, LineBuf *lb) {
+    lb->len = 0;
+    lb->buf[0] = '\0';
+    in->line_off = in->pos;
+    for (;;) {
+        const char *start, *nl;
+        size_t avail;
+        if (in->rpos >= in->rlen && !input_fill(in)) break;
+        start = in->rbuf + in->rpos;
+        avail = in->rlen - in->rpos;
+        nl = (const char *)memchr(start, '\n', avail);
+        if (nl) {
+            size_t n = (size_t)(nl - start) + 1;
+            linebuf_append(lb, start, n);
+            in->rpos += n;
+            in->pos += raw_bytes(in, start, n);
+            if (lb->len >= 2 && lb->buf[lb->len - 2] == '\r') {
+                lb->buf[lb->len - 2] = '\n';
+                lb->buf[--lb->len] = '\0';
+            }
+            return 1;
+        }
+        linebuf_append(lb, start, avail);
+        in->rpos = in->rlen;
+        in->pos += raw_bytes(in, start, avail);
+    }
+    return lb->len > 0;
+}
+
+size_t input_read(Input *in, char *buf, size_t cap) {
+    size_t n;
+    if (in->rpos >= in->rlen && !input_fill(in)) return 0;
+    n = in->rlen - in->rpos;
+    if (n > cap) n = cap;
+    memcpy(buf, in->rbuf + in->rpos, n);
+    in->pos += raw_bytes(in, in->rbuf + in->rpos, n);
+    in->rpos += n;
+    return n;
+}
+
+int input_wait(Input *in, int timeout_ms) {
+    HANDLE h;
+    DWORD avail, start;
+
+    /* A partial line in the buffer still needs a read to finish */
+    if (in->eof || memchr(in->rbuf + in->rpos, '\n', in->rlen - in->rpos)) return 1;
+    h = (HANDLE)_get_osfhandle(in->fd);
+    switch (GetFileType(h)) {
+    case FILE_TYPE_PIPE:
+        start = GetTickCount();
+        for (;;) {
+            /* A broken pipe means the writer is gone; let the read see EOF */
+            if (!PeekNamedPipe(h, NULL, 0, NULL, &avail, NULL)) return 1;
+            if (avail > 0) return 1;
+            if ((int)(GetTickCount() - start) >= timeout_ms) return 0;
+            Sleep(1);
+        }
+    case FILE_TYPE_CHAR:
+        return WaitForSingleObject(h, (DWORD)timeout_ms) == WAIT_OBJECT_0;
+    default:
+        /* Disk files never block */
+        return 1;
+    }
+}
+
+long long input_backlog(Input *in) {
+    HANDLE h = (HANDLE)_get_osfhandle(in->fd);
+    DWORD avail = 0;
+
+    if (GetFileType(h) != FILE_TYPE_PIPE) return -1;
+    PeekNamedPipe(h, NULL, 0, NULL, &avail, NULL);
+    return (long long)(in->rlen - in->rpos) + avail;
+}
+
+/* ----------------------------------------------------------------
+ * Mapped files
+ * ---------------------------------------------------------------- */
+int filemap_open(FileMap *fm, const char *path) {
+    LARGE_INTEGER sz;
+    memset(fm, 0, sizeof(*fm));
+    fm->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fm->file == INVALID_HANDLE_VALUE) return 0;
+    if (!GetFileSizeEx(fm->file, &sz)) {
+        CloseHandle(fm->file);
+        return 0;
+    }
+    fm->size = (size_t)sz.QuadPart;
+    if (fm->size == 0) return 1;
+    fm->map = CreateFileMappingA(fm->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (fm->map) fm->base = (const char *)MapViewOfFile(fm->map, FILE_MAP_READ, 0, 0, 0);
+    if (!fm->base) {
+        if (fm->map) CloseHandle(fm->map);
+        CloseHandle(fm->file);
+        return 0;
+    }
+    return 1;
+}
+
+void filemap_close(FileMap *fm) {
+    if (fm->base) UnmapViewOfFile(fm->base);
+    if (fm->map) CloseHandle(fm->map);
+    CloseHandle(fm->file);
+}
@@ -0,0 +1,84 @@
+#ifndef CCZE_INPUT_H
+#define CCZE_INPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Dynamic line buffer (always NUL-terminated) */
+typedef struct {
+    char  *buf;
+    size_t cap;
+    size_t len;
+} LineBuf;
+
+void linebuf_init(LineBuf *lb);
+void linebuf_free(LineBuf *lb);
+
+/* Append len bytes to the buffer */
+void linebuf_append(LineBuf *lb, const char *text, size_t len);
+
+typedef enum { ENC_UTF8, ENC_UTF16LE, ENC_UTF16BE } Encoding;
+
+/* Guess the encoding of the first len bytes of a stream: a BOM, or for
+ * UTF-16 without one, NUL bytes on only one side of each code unit.
+ * *bom receives the length of the byte order mark (0 if none). */
+Encoding input_sniff(const char *buf, size_t len, size_t *bom);
+
+/* Buffered reader on top of a FILE's descriptor. The descriptor is read
+ * in binary mode; "\r\n" line endings are folded to "\n" here so offsets
+ * into the original file stay exact.
+ *
+ * The encoding is sniffed when the input is opened. UTF-16 is transcoded
+ * to UTF-8 block by block as it is read, and a leading BOM is dropped, so
+ * everything after the reader sees UTF-8. pos and line_off still count
+ * bytes of the original file. */
+typedef struct {
+    int    fd;
+    char  *rbuf;                 /* UTF-8 text */
+    size_t rpos;
+    size_t rlen;
+    size_t rcap;
+    int    eof;
+    Encoding enc;
+    char  *tbuf;                 /* raw UTF-16 block (NULL for UTF-8) */
+    size_t tlen;                 /* bytes in tbuf: a split unit or surrogate pair */
+    unsigned long long pos;      /* raw bytes consumed so far */
+    unsigned long long line_off; /* raw offset of the last line read */
+} Input;
+
+void input_open(Input *in, FILE *fp);
+void input_close(Input *in);
+
+/* Continue reading at a raw byte offset (regular files only). The
+ * offset must be a line start, as recorded in line_off. */
+void input_seek(Input *in, unsigned long long offset);
+
+/* Read one line (including its '\n') into lb and set in->line_off.
+ * Returns 0 at end of input. */
+int input_readline(Input *in, LineBuf *lb);
+
+/* Read up to cap bytes of UTF-8 text, with line endings untouched.
+ * Returns 0 at end of input. */
+size_t input_read(Input *in, char *buf, size_t cap);
+
+/* Wait up to timeout_ms for more input. Returns 1 if a read would not
+ * block (a whole line buffered, data pending, or EOF), 0 on timeout. */
+int input_wait(Input *in, int timeout_ms);
+
+/* Bytes of piped input ready to read without blocking: the unread part
+ * of the buffer and what the pipe holds. -1 if the input isn't a pipe. */
+long long input_backlog(Input *in);
+
+/* A read-only mapping of a whole file (base is NULL when it's empty) */
+typedef struct {
+    void       *file;            /* HANDLEs */
+    void       *map;
+    const char *base;
+    size_t      size;
+} FileMap;
+
+/* Returns 0 if the file can't be opened or mapped */
+int  filemap_open(FileMap *fm, const char *path);
+void filemap_close(FileMap *fm);
+
+#endif /* CCZE_INPUT_H */
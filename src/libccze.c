@@ -0,0 +1,1126 @@
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "engine.h"
+
+/* ----------------------------------------------------------------
+ * Span output
+ *
+ * Adjacent plain spans are coalesced so callers see one callback per
+ * uncolored run rather than one per word. --grep hits are cut out of
+ * whatever span they fall in (except tool spans, which must reach the
+ * tool whole) and reported as CCZE_SPAN_MATCH.
+ * ---------------------------------------------------------------- */
+typedef struct {
+    CczeSpanFn  fn;
+    void       *ud;
+    const char *buf;
+    CczeSpan    pending;
+    int         has_pending;
+    size_t     *hits;       /* --grep hits as [start, end) pairs */
+    int         nhits;
+    int         hit;        /* first hit not yet behind the output */
+    CczeTier    tier;
+    CczeTimes  *times;      /* ccze_colorize_tier() timing, else NULL */
+} SpanOut;
+
+static long long ticks(void) {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+static void span_flush(SpanOut *so) {
+    if (so->has_pending) {
+        so->fn(so->buf, &so->pending, so->ud);
+        so->has_pending = 0;
+    }
+}
+
+static void span_put(SpanOut *so, size_t off, size_t len, CczeSpanKind kind, Color c, int rule_id) {
+    if (!len) return;
+    if (so->has_pending && kind == CCZE_SPAN_PLAIN && so->pending.kind == CCZE_SPAN_PLAIN &&
+        so->pending.offset + so->pending.length == off) {
+        so->pending.length += len;
+        return;
+    }
+    span_flush(so);
+    so->pending.offset = off;
+    so->pending.length = len;
+    so->pending.color = c;
+    so->pending.kind = kind;
+    so->pending.rule_id = rule_id;
+    so->has_pending = 1;
+}
+
+static void span_emit(SpanOut *so, size_t off, size_t len, CczeSpanKind kind, Color c, int rule_id) {
+    size_t end = off + len;
+
+    if (so->nhits && kind != CCZE_SPAN_TOOL && kind != CCZE_SPAN_HIDDEN) {
+        while (off < end) {
+            size_t hs, he;
+            while (so->hit < so->nhits && so->hits[2 * so->hit + 1] <= off) so->hit++;
+            if (so->hit == so->nhits) break;
+            hs = so->hits[2 * so->hit];
+            he = so->hits[2 * so->hit + 1];
+            if (hs >= end) break;
+            if (hs > off) {
+                span_put(so, off, hs - off, kind, c, rule_id);
+                off = hs;
+            }
+            if (he > end) he = end;
+            span_put(so, off, he - off, CCZE_SPAN_MATCH, COL_HIGHLIGHT, 0);
+            off = he;
+        }
+    }
+    span_put(so, off, end - off, kind, c, rule_id);
+}
+
+/* ----------------------------------------------------------------
+ * Syslog facility stripping (-r)
+ *
+ * Returns the length of the "<pri>" or "facility.level: " prefix.
+ * ---------------------------------------------------------------- */
+static size_t facility_len(const char *line, size_t len) {
+    const char *p = line, *end = line + len;
+    if (p < end && *p == '<') {
+        p++;
+        while (p < end && *p != '>') p++;
+        if (p < end) p++;
+    } else {
+        const char *colon = NULL;
+        const char *s = line;
+        while (s < end && *s != ' ' && *s != '\n') {
+            if (*s == ':') { colon = s; break; }
+            s++;
+        }
+        if (colon && colon + 1 < end && colon[1] == ' ') p = colon + 2;
+    }
+    return (size_t)(p - line);
+}
+
+/* Report a plain-text span, applying wordcolor if enabled */
+static void emit_plain(const Ccze *h, SpanOut *so, size_t off, size_t len) {
+    WordToken tok;
+    size_t pos = 0;
+
+    if (h->wordcolor && (so->tier == CCZE_TIER_FULL || so->tier == CCZE_TIER_WORDCOLOR)) {
+        for (;;) {
+            long long t0 = so->times ? ticks() : 0;
+            int found = wordcolor_next(so->buf + off, len, pos, &tok);
+            if (so->times) so->times->wordcolor += ticks() - t0;
+            if (!found) break;
+            if (tok.start > pos) span_emit(so, off + pos, tok.start - pos, CCZE_SPAN_PLAIN, COL_RESET, 0);
+            span_emit(so, off + tok.start, tok.end - tok.start, tok.kind, tok.color, 0);
+            pos = tok.end;
+        }
+    }
+    if (pos < len) span_emit(so, off + pos, len - pos, CCZE_SPAN_PLAIN, COL_RESET, 0);
+}
+
+#define NO_RULE -1
+
+/* ----------------------------------------------------------------
+ * Rule matching
+ *
+ * Rules run in file order; each match is kept only if none of its
+ * characters were already claimed by an earlier rule. A rule that hits
+ * its match/depth/heap limit is dropped for the whole line.
+ * ---------------------------------------------------------------- */
+int engine_limit_error(int rc) {
+    return rc == PCRE2_ERROR_MATCHLIMIT || rc == PCRE2_ERROR_DEPTHLIMIT ||
+           rc == PCRE2_ERROR_HEAPLIMIT || rc == PCRE2_ERROR_NOMEMORY;
+}
+
+/* Claim [start, end) of color_map for rule r unless an earlier rule
+ * has any of it */
+static void claim(int *color_map, size_t start, size_t end, int r) {
+    size_t i;
+    for (i = start; i < end; i++)
+        if (color_map[i] != NO_RULE) return;
+    for (i = start; i < end; i++) color_map[i] = r;
+}
+
+/* Run rule r over one line's text, from offset (where an earlier run
+ * over the same text found nothing further) */
+static void match_rule(const Ccze *h, int r, const char *text, size_t len, PCRE2_SIZE offset,
+                       int *color_map, pcre2_match_data *md) {
+    pcre2_code *re = (pcre2_code *)h->rule_arr[r]->re;
+    size_t i;
+
+    while (offset < (PCRE2_SIZE)len) {
+        int rc = pcre2_match(re, (PCRE2_SPTR)text, len, offset, 0, md, h->rule_mctx[r]);
+        PCRE2_SIZE *ovector;
+        if (rc < 0) {
+            if (engine_limit_error(rc)) {
+                for (i = 0; i < len; i++)
+                    if (color_map[i] == r) color_map[i] = NO_RULE;
+                InterlockedIncrement(&h->limit_hits[r]);
+            }
+            return;
+        }
+        ovector = pcre2_get_ovector_pointer(md);
+        if (ovector[1] <= ovector[0]) { offset = ovector[1] + 1; continue; }
+        claim(color_map, ovector[0], ovector[1], r);
+        offset = ovector[1];
+    }
+}
+
+/* Report text whose characters rules have claimed in color_map */
+static void emit_claims(const Ccze *h, SpanOut *so, size_t off, size_t len, const int *color_map) {
+    size_t i = 0, j;
+    int r;
+
+    while (i < len) {
+        if (color_map[i] == NO_RULE) {
+            j = i;
+            while (j < len && color_map[j] == NO_RULE) j++;
+            emit_plain(h, so, off + i, j - i);
+        } else {
+            Rule *rule;
+            r = color_map[i];
+            rule = h->rule_arr[r];
+            j = i;
+            while (j < len && color_map[j] == r) j++;
+            if (rule->type == RULE_COLOR)
+                span_emit(so, off + i, j - i, CCZE_SPAN_RULE, rule->color, r + 1);
+            else
+                span_emit(so, off + i, j - i, CCZE_SPAN_TOOL, COL_CYAN, r + 1);
+        }
+        i = j;
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Long lines on many threads (line_threads)
+ *
+ * On a line of big_line bytes or more, the rules run on the fan-out
+ * workers: each rule, and for most rules each LINE_STRETCH bytes of the
+ * line, is a task that keeps its matches in a list of its own. The
+ * lists are then claimed in rule order, giving the same result as
+ * match_rule() one rule after another.
+ *
+ * A task for [a, b) runs the rule's usual chain of searches from a,
+ * with an offset limit so that no match starts at b or later. Every
+ * search sees the whole line, so lookbehind, ^ and \b behave as usual
+ * at a. Once the chain from the start of the line searches from an
+ * offset the task searched from too, the two agree from there on; when
+ * a match runs into a stretch past an offset the task searched from,
+ * the searches in between are rerun while claiming. Rules with \G,
+ * whose answer depends on where the search began, and rules with
+ * unbounded . repeats, whose first match in every stretch could run to
+ * the end of the line, are one task each.
+ * ---------------------------------------------------------------- */
+#define LINE_STRETCH (256 * 1024)
+
+#define SEARCH_NONE  ((PCRE2_SIZE)-1)   /* no match starting before b */
+#define SEARCH_LIMIT ((PCRE2_SIZE)-2)   /* a match/depth/heap limit was hit */
+
+typedef struct {
+    PCRE2_SIZE from;         /* offset searched from */
+    PCRE2_SIZE start, end;   /* the match; start may be SEARCH_NONE/_LIMIT */
+} Search;
+
+typedef struct {
+    int         r;
+    PCRE2_SIZE  a, b;        /* the stretch, or the whole line */
+    int         stretched;   /* a stretch: runs seg_re with an offset limit */
+    Search     *s;
+    int         n, cap;
+} LineTask;
+
+typedef struct {
+    const Ccze *h;
+    const char *text;
+    size_t      len;
+    LineTask   *tasks;
+} LineJob;
+
+/* 1 if a pattern finds the same matches searching a line stretch by
+ * stretch (see above) */
+static int pattern_stretchable(const char *p) {
+    int in_class = 0;
+    for (; *p; p++) {
+        if (p[0] == '\\' && p[1]) {
+            if (!in_class && p[1] == 'G') return 0;
+            p++;
+        } else if (in_class) {
+            if (p[0] == ']' && p[-1] != '[' && !(p[-1] == '^' && p[-2] == '[')) in_class = 0;
+        } else if (p[0] == '[') {
+            in_class = 1;
+        } else if (p[0] == '.' && strchr("*+{", p[1])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static pcre2_match_context *task_context(const Ccze *h, const LineTask *t) {
+    pcre2_match_context *mc;
+    if (!t->stretched) return h->rule_mctx[t->r];
+    mc = pcre2_match_context_copy(h->rule_mctx[t->r]);
+    pcre2_set_offset_limit(mc, t->b - 1);
+    return mc;
+}
+
+/* One search of task t's rule from offset; the match end goes to *end */
+static PCRE2_SIZE task_search(const Ccze *h, const LineTask *t, const char *text, size_t len,
+                              PCRE2_SIZE from, pcre2_match_context *mc, pcre2_match_data *md,
+                              PCRE2_SIZE *end) {
+    pcre2_code *re = t->stretched ? h->seg_re[t->r] : (pcre2_code *)h->rule_arr[t->r]->re;
+    int rc = pcre2_match(re, (PCRE2_SPTR)text, len, from, 0, md, mc);
+    PCRE2_SIZE *ov;
+    if (rc < 0) return engine_limit_error(rc) ? SEARCH_LIMIT : SEARCH_NONE;
+    ov = pcre2_get_ovector_pointer(md);
+    *end = ov[1];
+    return ov[0];
+}
+
+/* Where a chain searches next, after a match; empty matches are skipped
+ * as in match_rule() */
+static PCRE2_SIZE search_next(PCRE2_SIZE start, PCRE2_SIZE end) {
+    return end > start ? end : end + 1;
+}
+
+static void line_task(int i, void *ud) {
+    LineJob *job = (LineJob *)ud;
+    LineTask *t = &job->tasks[i];
+    pcre2_match_context *mc = task_context(job->h, t);
+    pcre2_match_data *md = pcre2_match_data_create(16, NULL);
+    PCRE2_SIZE from = t->a;
+
+    while (from < t->b) {
+        Search *s;
+        if (t->n == t->cap) {
+            t->cap = t->cap ? t->cap * 2 : 64;
+            t->s = (Search *)realloc(t->s, t->cap * sizeof(Search));
+        }
+        s = &t->s[t->n++];
+        s->from = from;
+        s->end = 0;
+        s->start = task_search(job->h, t, job->text, job->len, from, mc, md, &s->end);
+        if (s->start == SEARCH_NONE || s->start == SEARCH_LIMIT) break;
+        from = search_next(s->start, s->end);
+    }
+    pcre2_match_data_free(md);
+    if (t->stretched) pcre2_match_context_free(mc);
+}
+
+/* Index of the search t made from offset from, or -1 */
+static int task_search_at(const LineTask *t, PCRE2_SIZE from) {
+    int lo = 0, hi = t->n - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (t->s[mid].from == from) return mid;
+        if (t->s[mid].from < from) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/* Claim the matches of one rule's tasks (nt of them, in line order) */
+static void claim_tasks(const LineJob *job, const LineTask *t, int nt, int *color_map) {
+    const Ccze *h = job->h;
+    pcre2_match_data *md = NULL;
+    PCRE2_SIZE pos = 0, start, end = 0;
+    int k, i;
+    size_t j;
+
+    for (k = 0; k < nt; k++, t++) {
+        if (pos >= t->b) continue;
+        i = 0;
+        if (pos > t->a) {
+            /* Catch up with the task's chain */
+            pcre2_match_context *mc = task_context(h, t);
+            if (!md) md = pcre2_match_data_create(16, NULL);
+            while (pos < t->b && (i = task_search_at(t, pos)) < 0) {
+                start = task_search(h, t, job->text, job->len, pos, mc, md, &end);
+                if (start == SEARCH_LIMIT) {
+                    if (t->stretched) pcre2_match_context_free(mc);
+                    goto dropped;
+                }
+                if (start == SEARCH_NONE) {
+                    pos = t->b;
+                    break;
+                }
+                if (end > start) claim(color_map, start, end, t->r);
+                pos = search_next(start, end);
+            }
+            if (t->stretched) pcre2_match_context_free(mc);
+            if (i < 0 || pos >= t->b) continue;
+        }
+        for (; i < t->n; i++) {
+            const Search *s = &t->s[i];
+            if (s->start == SEARCH_LIMIT) goto dropped;
+            if (s->start == SEARCH_NONE) {
+                pos = t->b;
+                break;
+            }
+            if (s->end > s->start) claim(color_map, s->start, s->end, t->r);
+            pos = search_next(s->start, s->end);
+        }
+    }
+    if (md) pcre2_match_data_free(md);
+    return;
+
+dropped:
+    for (j = 0; j < job->len; j++)
+        if (color_map[j] == t->r) color_map[j] = NO_RULE;
+    InterlockedIncrement(&h->limit_hits[t->r]);
+    if (md) pcre2_match_data_free(md);
+}
+
+/* Run the rules over one long line on the fan-out workers; seen as
+ * from automaton_scan(), or NULL to run them all */
+static void fanout_rules(const Ccze *h, const char *text, size_t len, const unsigned char *seen,
+                         int *color_map) {
+    LineJob job;
+    int *first = (int *)malloc((h->nrules + 1) * sizeof(int));   /* rule -> its tasks */
+    int ntasks = 0, cap = 0, r, i;
+
+    job.h = h;
+    job.text = text;
+    job.len = len;
+    job.tasks = NULL;
+    for (r = 0; r < h->nrules; r++) {
+        PCRE2_SIZE a = 0;
+        first[r] = ntasks;
+        if (seen && !seen[r] && automaton_covers(h->automaton, r)) continue;
+        do {
+            LineTask *t;
+            if (ntasks == cap) {
+                cap = cap ? cap * 2 : 256;
+                job.tasks = (LineTask *)realloc(job.tasks, cap * sizeof(LineTask));
+            }
+            t = &job.tasks[ntasks++];
+            memset(t, 0, sizeof(*t));
+            t->r = r;
+            t->a = a;
+            t->stretched = h->seg_re[r] && len - a > LINE_STRETCH;
+            t->b = t->stretched ? a + LINE_STRETCH : len;
+            a = t->b;
+        } while (a < len);
+    }
+    first[h->nrules] = ntasks;
+
+    fanout_run(h->fanout, ntasks, line_task, &job);
+    for (r = 0; r < h->nrules; r++)
+        if (first[r + 1] > first[r]) claim_tasks(&job, &job.tasks[first[r]], first[r + 1] - first[r], color_map);
+
+    for (i = 0; i < ntasks; i++) free(job.tasks[i].s);
+    free(job.tasks);
+    free(first);
+}
+
+static void apply_rules(const Ccze *h, SpanOut *so, size_t off, size_t len) {
+    int *color_map;
+    unsigned char *seen = NULL;
+    int r;
+    size_t i;
+    pcre2_match_data *md;
+    long long t0;
+
+    if (!h->nrules || !len || so->tier != CCZE_TIER_FULL) {
+        emit_plain(h, so, off, len);
+        return;
+    }
+    t0 = so->times ? ticks() : 0;
+
+    /* The automaton's seen bytes ride along after the color map */
+    color_map = (int *)malloc(len * sizeof(int) + (h->automaton ? h->nrules : 0));
+    for (i = 0; i < len; i++) color_map[i] = NO_RULE;
+    if (h->automaton) {
+        seen = (unsigned char *)(color_map + len);
+        memset(seen, 0, h->nrules);
+        automaton_scan(h->automaton, so->buf + off, len, seen, NULL);
+    }
+
+    md = pcre2_match_data_create(16, NULL);
+    if (h->fanout && len >= h->big_line) {
+        fanout_rules(h, so->buf + off, len, seen, color_map);
+    } else if (seen) {
+        /* Skip the rules the automaton says can't match */
+        for (r = 0; r < h->nrules; r++)
+            if (seen[r] || !automaton_covers(h->automaton, r))
+                match_rule(h, r, so->buf + off, len, 0, color_map, md);
+    } else {
+        for (r = 0; r < h->nrules; r++) match_rule(h, r, so->buf + off, len, 0, color_map, md);
+    }
+    pcre2_match_data_free(md);
+    if (so->times) so->times->rules += ticks() - t0;
+
+    emit_claims(h, so, off, len, color_map);
+    free(color_map);
+}
+
+/* ----------------------------------------------------------------
+ * Syslog structural parser
+ *
+ * Matches: "Feb 22 00:00:18 hostname process[pid]: message"
+ * Colors each field like ccze's mod_syslog.c:
+ *   date     = bright cyan
+ *   hostname = bright blue
+ *   process  = green
+ *   [        = bright green
+ *   pid      = bright white
+ *   ]        = bright green
+ *   :        = green
+ *   message  = wordcolor + rules
+ *
+ * Returns 1 if line was handled as syslog, 0 otherwise.
+ * ---------------------------------------------------------------- */
+static pcre2_code *syslog_compile(void) {
+    int err;
+    PCRE2_SIZE erroff;
+    /* ccze regex: ^(\S*\s{1,2}\d{1,2}\s\d\d:\d\d:\d\d)\s(\S+)\s+((\S+:?)\s(.*))$ */
+    return pcre2_compile(
+        (PCRE2_SPTR)"^(\\S+\\s{1,2}\\d{1,2}\\s\\d\\d:\\d\\d:\\d\\d)\\s(\\S+)\\s+((\\S+?)(?:\\[(\\d+)\\])?:\\s(.*))$",
+        PCRE2_ZERO_TERMINATED, PCRE2_DOTALL, &err, &erroff, NULL);
+}
+
+/* ----------------------------------------------------------------
+ * Timestamps (--since/--until and the sidecar index)
+ *
+ * Accepts the syslog date the parser above matches ("Feb 22 00:00:18"),
+ * java.util.logging's "Feb 18, 2026 6:21:11 PM" and ISO 8601
+ * "2026-02-18 18:21:11" / "...T18:21:11".
+ * ---------------------------------------------------------------- */
+static int parse_num(const char *s, size_t len, size_t *i, int mind, int maxd, int *out) {
+    int n = 0, d = 0;
+    while (*i < len && d < maxd && isdigit((unsigned char)s[*i])) {
+        n = n * 10 + (s[*i] - '0');
+        (*i)++;
+        d++;
+    }
+    *out = n;
+    return d >= mind;
+}
+
+static int parse_clock(const char *s, size_t len, size_t *i, int *secs) {
+    int hh, mm, ss = 0;
+    if (!parse_num(s, len, i, 1, 2, &hh) || *i >= len || s[*i] != ':') return 0;
+    (*i)++;
+    if (!parse_num(s, len, i, 2, 2, &mm)) return 0;
+    if (*i + 1 < len && s[*i] == ':' && isdigit((unsigned char)s[*i + 1])) {
+        (*i)++;
+        if (!parse_num(s, len, i, 2, 2, &ss)) return 0;
+    }
+    if (*i + 2 < len && s[*i] == ' ' && toupper((unsigned char)s[*i + 2]) == 'M') {
+        char ap = (char)toupper((unsigned char)s[*i + 1]);
+        if (ap == 'A' || ap == 'P') {
+            if (hh == 12) hh = 0;
+            if (ap == 'P') hh += 12;
+            *i += 3;
+        }
+    }
+    *secs = hh * 3600 + mm * 60 + ss;
+    return 1;
+}
+
+static long long time_key(int year, int mon, int day, int secs) {
+    return ((long long)(year * 13 + mon) * 32 + day) * 86400 + secs;
+}
+
+/* Parse a timestamp at the start of s. Returns the bytes consumed, or 0 */
+static size_t parse_time(const char *s, size_t len, long long *t) {
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    size_t i = 0;
+    int year = 0, mon = 0, day, secs;
+
+    if (len >= 10 && isdigit((unsigned char)s[0]) && s[4] == '-') {
+        if (!parse_num(s, len, &i, 4, 4, &year) || s[i++] != '-') return 0;
+        if (!parse_num(s, len, &i, 2, 2, &mon) || i >= len || s[i++] != '-') return 0;
+        if (!parse_num(s, len, &i, 2, 2, &day)) return 0;
+        if (i >= len || (s[i] != ' ' && s[i] != 'T')) return 0;
+        i++;
+    } else {
+        const char *m;
+        char name[4];
+        if (len < 5) return 0;
+        name[0] = (char)toupper((unsigned char)s[0]);
+        name[1] = (char)tolower((unsigned char)s[1]);
+        name[2] = (char)tolower((unsigned char)s[2]);
+        name[3] = '\0';
+        m = strstr(months, name);
+        if (!m || (m - months) % 3) return 0;
+        mon = (int)(m - months) / 3 + 1;
+        i = 3;
+        while (i < len && s[i] == ' ') i++;
+        if (!parse_num(s, len, &i, 1, 2, &day)) return 0;
+        if (i + 1 < len && s[i] == ',' && s[i + 1] == ' ') {
+            i += 2;
+            if (!parse_num(s, len, &i, 4, 4, &year)) return 0;
+        }
+        if (i >= len || s[i] != ' ') return 0;
+        i++;
+    }
+    if (mon < 1 || mon > 12 || day < 1 || day > 31) return 0;
+    if (!parse_clock(s, len, &i, &secs)) return 0;
+    *t = time_key(year, mon, day, secs);
+    return i;
+}
+
+int ccze_parse_time(const char *text, long long *t) {
+    size_t len = strlen(text);
+    return parse_time(text, len, t) == len;
+}
+
+int ccze_line_time(const Ccze *h, const char *buf, size_t len, long long *t) {
+    size_t off = facility_len(buf, len);
+    if (h->syslog_re) {
+        pcre2_match_data *md = pcre2_match_data_create(2, NULL);
+        int rc = pcre2_match(h->syslog_re, (PCRE2_SPTR)(buf + off), len - off, 0, 0, md, h->global_mctx);
+        if (rc >= 0) {
+            PCRE2_SIZE *ov = pcre2_get_ovector_pointer(md);
+            size_t n = parse_time(buf + off + ov[2], ov[3] - ov[2], t);
+            pcre2_match_data_free(md);
+            return n > 0;
+        }
+        pcre2_match_data_free(md);
+    }
+    return parse_time(buf + off, len - off, t) > 0;
+}
+
+/* Match the syslog parser; on success ov[0..13] receives the groups */
+static int syslog_match(const Ccze *h, SpanOut *so, size_t off, size_t len, pcre2_match_data *md,
+                        PCRE2_SIZE *ov) {
+    long long t0;
+    int rc;
+
+    if (!h->syslog_re) return 0;
+    t0 = so->times ? ticks() : 0;
+    rc = pcre2_match(h->syslog_re, (PCRE2_SPTR)(so->buf + off), len, 0, 0, md, h->global_mctx);
+    if (so->times) so->times->rules += ticks() - t0;
+    if (rc < 0) return 0;
+    memcpy(ov, pcre2_get_ovector_pointer(md), 14 * sizeof(PCRE2_SIZE));
+    return 1;
+}
+
+/* Report the fields before the message */
+static void syslog_head(SpanOut *so, size_t off, const PCRE2_SIZE *ov) {
+    /* Group 1: date, then the separator */
+    span_emit(so, off + ov[2], ov[3] - ov[2], CCZE_SPAN_DATE, COL_BRIGHT_CYAN, 0);
+    span_emit(so, off + ov[3], ov[4] - ov[3], CCZE_SPAN_PLAIN, COL_RESET, 0);
+
+    /* Group 2: hostname */
+    span_emit(so, off + ov[4], ov[5] - ov[4], CCZE_SPAN_HOST, COL_BRIGHT_BLUE, 0);
+    span_emit(so, off + ov[5], ov[8] - ov[5], CCZE_SPAN_PLAIN, COL_RESET, 0);
+
+    /* Group 4: process name */
+    span_emit(so, off + ov[8], ov[9] - ov[8], CCZE_SPAN_PROC, COL_GREEN, 0);
+
+    /* Group 5: pid (optional) */
+    if (ov[10] != PCRE2_UNSET) {
+        span_emit(so, off + ov[10] - 1, 1, CCZE_SPAN_PUNCT, COL_BRIGHT_GREEN, 0);
+        span_emit(so, off + ov[10], ov[11] - ov[10], CCZE_SPAN_PID, COL_BRIGHT_WHITE, 0);
+        span_emit(so, off + ov[11], 1, CCZE_SPAN_PUNCT, COL_BRIGHT_GREEN, 0);
+    }
+
+    /* ":" and the whitespace before the message */
+    span_emit(so, off + ov[12] - 2, 1, CCZE_SPAN_PUNCT, COL_GREEN, 0);
+    span_emit(so, off + ov[12] - 1, 1, CCZE_SPAN_PLAIN, COL_RESET, 0);
+}
+
+static int process_syslog(const Ccze *h, SpanOut *so, size_t off, size_t len) {
+    pcre2_match_data *md = pcre2_match_data_create(16, NULL);
+    PCRE2_SIZE ov[14];
+    int ok = syslog_match(h, so, off, len, md, ov);
+
+    pcre2_match_data_free(md);
+    if (!ok) return 0;
+    syslog_head(so, off, ov);
+
+    /* Group 6: message — apply rules + wordcolor */
+    apply_rules(h, so, off + ov[12], ov[13] - ov[12]);
+
+    /* Trailing newline if present */
+    if (ov[13] < len)
+        span_emit(so, off + ov[13], len - ov[13], CCZE_SPAN_PLAIN, COL_RESET, 0);
+    return 1;
+}
+
+/* ----------------------------------------------------------------
+ * Lines in bulk (ccze_colorize_lines)
+ *
+ * On a short line, calling pcre2_match() once per rule costs more than
+ * the scanning. Here each line's rule text (the syslog message, or the
+ * whole line) is copied into one scratch buffer, each followed by a
+ * '\n', and a rule runs once over all of it. With PCRE2_MULTILINE the
+ * separator gives ^, $ and \b the same answers they give at the ends of
+ * a single line. A match that runs past the end of the line it began in
+ * would not have been found one line at a time, so the rest of that
+ * line is matched on its own, as is a line where a chunk-wide call fails
+ * (a match limit counts all the lines it scans). Lookaround, \A, \z, \G
+ * and verbs can see past the separator, and .* or [^x]* could run to the
+ * end of the chunk from every line they start in; rules with those run
+ * line by line.
+ * ---------------------------------------------------------------- */
+typedef struct {
+    size_t     off, len;      /* the line in buf */
+    size_t     skip;          /* -r facility prefix */
+    int        syslog;
+    PCRE2_SIZE ov[14];        /* syslog groups, relative to off + skip */
+    size_t     rs, re;        /* the rule text in the scratch buffer */
+} BulkLine;
+
+/* 1 if a pattern matches the same text in a chunk as on a lone line and
+ * can't run on across many lines (under DOTALL, .* or [^x]* could scan
+ * to the end of the chunk from every line they start in) */
+static int pattern_bulk_safe(const char *p) {
+    int in_class = 0, negated = 0, newline = 0;
+    for (; *p; p++) {
+        if (p[0] == '\\' && p[1]) {
+            if (!in_class && strchr("AzZG", p[1])) return 0;
+            if (in_class && (p[1] == 'n' || p[1] == 's')) newline = 1;
+            p++;
+        } else if (in_class) {
+            if (p[0] == ']' && p[-1] != '[' && !(p[-1] == '^' && p[-2] == '[')) {
+                in_class = 0;
+                if (negated && !newline && strchr("*+{", p[1])) return 0;
+            }
+        } else if (p[0] == '[') {
+            in_class = 1;
+            negated = p[1] == '^';
+            newline = 0;
+        } else if (p[0] == '.') {
+            if (strchr("*+{", p[1])) return 0;
+        } else if (p[0] == '(' && p[1] == '*') {
+            return 0;
+        } else if (p[0] == '(' && p[1] == '?') {
+            if (p[2] == '=' || p[2] == '!' || p[2] == '(') return 0;
+            if (p[2] == '<' && (p[3] == '=' || p[3] == '!')) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Line whose rule text (or the separator after it) holds scratch offset
+ * pos, searching on from line k */
+static int bulk_line_at(const BulkLine *ln, int n, int k, size_t pos) {
+    while (k + 1 < n && ln[k + 1].rs <= pos) k++;
+    return k;
+}
+
+static void bulk_match_rule(const Ccze *h, int r, const char *scratch, size_t slen,
+                            BulkLine *ln, int n, int *color_map, pcre2_match_data *md) {
+    pcre2_code *re = (pcre2_code *)h->rule_arr[r]->re;
+    PCRE2_SIZE offset = 0;
+    int k = 0;
+
+    if (!h->bulk_safe[r]) {
+        for (k = 0; k < n; k++)
+            match_rule(h, r, scratch + ln[k].rs, ln[k].re - ln[k].rs, 0, color_map + ln[k].rs, md);
+        return;
+    }
+    while (k < n) {
+        int rc = pcre2_match(re, (PCRE2_SPTR)scratch, slen, offset, 0, md, h->rule_mctx[r]);
+        PCRE2_SIZE *ov, start;
+        if (rc == PCRE2_ERROR_NOMATCH) return;
+        if (rc < 0) {
+            k = bulk_line_at(ln, n, k, offset);
+            match_rule(h, r, scratch + ln[k].rs, ln[k].re - ln[k].rs, offset - ln[k].rs,
+                       color_map + ln[k].rs, md);
+            if (++k < n) offset = ln[k].rs;
+            continue;
+        }
+        ov = pcre2_get_ovector_pointer(md);
+        start = pcre2_get_startchar(md);
+        k = bulk_line_at(ln, n, k, start);
+        if (offset < ln[k].rs) offset = ln[k].rs;
+        if (start < ln[k].re && ov[1] > ln[k].re) {
+            /* Runs into the separator or beyond: finish this line alone.
+             * Nothing was claimed past it, so the next line starts afresh */
+            match_rule(h, r, scratch + ln[k].rs, ln[k].re - ln[k].rs, offset - ln[k].rs,
+                       color_map + ln[k].rs, md);
+            if (++k < n) offset = ln[k].rs;
+            continue;
+        }
+        if (start >= ln[k].re) {
+            /* Starts at the separator: the line alone has nothing more */
+            if (++k < n) offset = ln[k].rs;
+            continue;
+        }
+        if (ov[1] <= ov[0]) {
+            offset = ov[1] + 1;
+        } else {
+            claim(color_map, ov[0], ov[1], r);
+            offset = ov[1];
+        }
+        /* Matching one line stops at its end */
+        if (offset >= ln[k].re && ++k < n) offset = ln[k].rs;
+    }
+}
+
+/* With the automaton: a rule it covers runs only on the lines it may
+ * match, chunk-wide if that is many of them */
+static void bulk_automaton(const Ccze *h, const char *scratch, size_t slen, BulkLine *ln, int n,
+                           int *color_map, pcre2_match_data *md) {
+    unsigned char *seen = (unsigned char *)calloc(h->nrules, 1);
+    int *hits = (int *)malloc(h->nrules * sizeof(int));
+    int *first = (int *)calloc(h->nrules + 1, sizeof(int));   /* rule -> its lines */
+    int *lines = NULL, *flat = NULL, *line_of = NULL;
+    int nflat = 0, cap = 0, k, r, j, m;
+
+    for (k = 0; k < n; k++) {
+        m = automaton_scan(h->automaton, scratch + ln[k].rs, ln[k].re - ln[k].rs, seen, hits);
+        if (nflat + m > cap) {
+            while (nflat + m > cap) cap = cap ? cap * 2 : 1024;
+            flat = (int *)realloc(flat, cap * sizeof(int));
+            line_of = (int *)realloc(line_of, cap * sizeof(int));
+        }
+        for (j = 0; j < m; j++) {
+            seen[hits[j]] = 0;
+            first[hits[j] + 1]++;
+            flat[nflat] = hits[j];
+            line_of[nflat++] = k;
+        }
+    }
+    for (r = 0; r < h->nrules; r++) first[r + 1] += first[r];
+    lines = (int *)malloc((nflat + 1) * sizeof(int));
+    memcpy(hits, first, h->nrules * sizeof(int));   /* next free slot per rule */
+    for (j = 0; j < nflat; j++) lines[hits[flat[j]]++] = line_of[j];
+
+    for (r = 0; r < h->nrules; r++) {
+        int cnt = first[r + 1] - first[r];
+        if (!automaton_covers(h->automaton, r) || (h->bulk_safe[r] && cnt * 4 > n)) {
+            bulk_match_rule(h, r, scratch, slen, ln, n, color_map, md);
+            continue;
+        }
+        for (j = first[r]; j < first[r + 1]; j++) {
+            k = lines[j];
+            match_rule(h, r, scratch + ln[k].rs, ln[k].re - ln[k].rs, 0, color_map + ln[k].rs, md);
+        }
+    }
+    free(seen);
+    free(hits);
+    free(first);
+    free(lines);
+    free(flat);
+    free(line_of);
+}
+
+static void bulk_colorize(const Ccze *h, const char *buf, size_t len, CczeSpanFn fn, void *ud,
+                          CczeTimes *t) {
+    BulkLine *ln;
+    char *scratch;
+    int *color_map;
+    int n = 0, cap = 64, k, r;
+    size_t pos = 0, slen = 0, i;
+    pcre2_match_data *md = pcre2_match_data_create(16, NULL);
+    SpanOut so;
+    long long t0 = t ? ticks() : 0;
+
+    memset(&so, 0, sizeof(so));
+    so.tier = CCZE_TIER_FULL;
+    ln = (BulkLine *)malloc(cap * sizeof(BulkLine));
+    scratch = (char *)malloc(2 * len + 1);   /* a separator per line at most doubles it */
+    while (pos < len) {
+        const char *nl = (const char *)memchr(buf + pos, '\n', len - pos);
+        BulkLine *l;
+        size_t rs;
+        if (n == cap) ln = (BulkLine *)realloc(ln, (cap *= 2) * sizeof(BulkLine));
+        l = &ln[n++];
+        l->off = pos;
+        l->len = nl ? (size_t)(nl - buf) + 1 - pos : len - pos;
+        l->skip = h->remove_facility ? facility_len(buf + pos, l->len) : 0;
+        so.buf = buf + pos;
+        l->syslog = syslog_match(h, &so, l->skip, l->len - l->skip, md, l->ov);
+        rs = l->syslog ? l->skip + l->ov[12] : l->skip;
+        l->rs = slen;
+        l->re = slen + (l->syslog ? l->skip + l->ov[13] : l->len) - rs;
+        memcpy(scratch + slen, buf + pos + rs, l->re - l->rs);
+        scratch[l->re] = '\n';
+        slen = l->re + 1;
+        pos += l->len;
+    }
+
+    color_map = (int *)malloc(slen * sizeof(int));
+    for (i = 0; i < slen; i++) color_map[i] = NO_RULE;
+    if (h->automaton) {
+        bulk_automaton(h, scratch, slen, ln, n, color_map, md);
+    } else {
+        for (r = 0; r < h->nrules; r++) bulk_match_rule(h, r, scratch, slen, ln, n, color_map, md);
+    }
+    pcre2_match_data_free(md);
+    if (t) t->rules += ticks() - t0;
+
+    so.fn = fn;
+    so.ud = ud;
+    so.times = t;
+    for (k = 0; k < n; k++) {
+        const BulkLine *l = &ln[k];
+        size_t off = l->skip;
+        so.buf = buf + l->off;
+        so.has_pending = 0;
+        so.nhits = filter_hits(h, so.buf, l->len, &so.hits);
+        so.hit = 0;
+        if (l->skip) span_emit(&so, 0, l->skip, CCZE_SPAN_HIDDEN, COL_RESET, 0);
+        if (l->syslog) {
+            syslog_head(&so, off, l->ov);
+            emit_claims(h, &so, off + l->ov[12], l->re - l->rs, color_map + l->rs);
+            if (l->ov[13] < l->len - off)
+                span_emit(&so, off + l->ov[13], l->len - off - l->ov[13], CCZE_SPAN_PLAIN, COL_RESET, 0);
+        } else {
+            emit_claims(h, &so, off, l->re - l->rs, color_map + l->rs);
+        }
+        span_flush(&so);
+        free(so.hits);
+    }
+    free(color_map);
+    free(scratch);
+    free(ln);
+}
+
+/* ----------------------------------------------------------------
+ * Public API
+ * ---------------------------------------------------------------- */
+void ccze_config_init(CczeConfig *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->wordcolor = 1;
+}
+
+static void apply_color_overrides(Rule *rules, const CczeConfig *cfg) {
+    int i;
+    Rule *r;
+    for (i = 0; i < cfg->num_overrides; i++) {
+        char key[64];
+        const char *kv = cfg->color_overrides[i];
+        const char *eq = strchr(kv, '=');
+        int klen;
+        Color newcol;
+        if (!eq) continue;
+        klen = (int)(eq - kv);
+        if (klen > 63) klen = 63;
+        memcpy(key, kv, klen);
+        key[klen] = '\0';
+        newcol = color_parse(eq + 1);
+        for (r = rules; r; r = r->next) {
+            if (r->type == RULE_COLOR && _stricmp(color_name(r->color), key) == 0)
+                r->color = newcol;
+        }
+    }
+}
+
+/* Effective limits: per-rule values override the global ones */
+static RuleLimits effective_limits(const RuleLimits *global, const RuleLimits *own) {
+    RuleLimits lim;
+    lim.match = own->match ? own->match : global->match;
+    lim.depth = own->depth ? own->depth : global->depth;
+    lim.heap = own->heap ? own->heap : global->heap;
+    return lim;
+}
+
+static pcre2_match_context *limits_context(const RuleLimits *lim) {
+    pcre2_match_context *mc = pcre2_match_context_create(NULL);
+    if (lim->match) pcre2_set_match_limit(mc, lim->match);
+    if (lim->depth) pcre2_set_depth_limit(mc, lim->depth);
+    if (lim->heap) pcre2_set_heap_limit(mc, lim->heap);
+    return mc;
+}
+
+/* One match context per distinct limit set, shared by the rules using it */
+static void build_match_contexts(Ccze *h) {
+    RuleLimits *seen;
+    int r, k;
+
+    if (!h->limits.match) h->limits.match = CCZE_DEFAULT_MATCH_LIMIT;
+    h->global_mctx = limits_context(&h->limits);
+    if (!h->nrules) return;
+
+    seen = (RuleLimits *)malloc(h->nrules * sizeof(RuleLimits));
+    h->mctx = (pcre2_match_context **)malloc(h->nrules * sizeof(pcre2_match_context *));
+    h->rule_mctx = (pcre2_match_context **)malloc(h->nrules * sizeof(pcre2_match_context *));
+    h->limit_hits = (volatile long *)calloc(h->nrules, sizeof(long));
+    for (r = 0; r < h->nrules; r++) {
+        RuleLimits lim = effective_limits(&h->limits, &h->rule_arr[r]->limits);
+        if (memcmp(&lim, &h->limits, sizeof(lim)) == 0) {
+            h->rule_mctx[r] = h->global_mctx;
+            continue;
+        }
+        for (k = 0; k < h->nmctx; k++)
+            if (memcmp(&seen[k], &lim, sizeof(lim)) == 0) break;
+        if (k == h->nmctx) {
+            seen[k] = lim;
+            h->mctx[h->nmctx++] = limits_context(&lim);
+        }
+        h->rule_mctx[r] = h->mctx[k];
+    }
+    free(seen);
+}
+
+Ccze *ccze_open(const CczeConfig *cfg) {
+    Ccze *h = (Ccze *)calloc(1, sizeof(Ccze));
+    Rule *rp;
+    int ri;
+
+    h->wordcolor = cfg->wordcolor;
+    if (h->wordcolor) wordcolor_init();
+    h->remove_facility = cfg->remove_facility;
+    h->ansi = cfg->ansi;
+    h->syslog_re = syslog_compile();
+
+    if (cfg->rcfile)
+        h->rules = rules_load(cfg->rcfile, &h->limits, &h->errors);
+    else if (cfg->builtin)
+        h->rules = rules_builtin(cfg->builtin, &h->limits);
+    if (h->rules && cfg->num_overrides > 0)
+        apply_color_overrides(h->rules, cfg);
+
+    for (rp = h->rules; rp; rp = rp->next) h->nrules++;
+    if (h->nrules) {
+        h->rule_arr = (Rule **)malloc(h->nrules * sizeof(Rule *));
+        ri = 0;
+        for (rp = h->rules; rp; rp = rp->next) h->rule_arr[ri++] = rp;
+    }
+    /* Where JIT isn't supported the interpreter is used as before */
+    if (cfg->jit) {
+        for (rp = h->rules; rp; rp = rp->next)
+            pcre2_jit_compile((pcre2_code *)rp->re, PCRE2_JIT_COMPLETE);
+        if (h->syslog_re) pcre2_jit_compile(h->syslog_re, PCRE2_JIT_COMPLETE);
+    }
+    if (h->nrules) {
+        h->bulk_safe = (unsigned char *)malloc(h->nrules);
+        for (ri = 0; ri < h->nrules; ri++)
+            h->bulk_safe[ri] = (unsigned char)pattern_bulk_safe(h->rule_arr[ri]->pattern_src);
+        if (cfg->automaton) h->automaton = automaton_build(h->rule_arr, h->nrules);
+        if (cfg->line_threads > 1) h->fanout = fanout_start(cfg->line_threads);
+    }
+    if (h->fanout) {
+        h->big_line = cfg->big_line ? cfg->big_line : CCZE_BIG_LINE;
+        h->seg_re = (pcre2_code **)calloc(h->nrules, sizeof(pcre2_code *));
+        for (ri = 0; ri < h->nrules; ri++) {
+            const char *src = h->rule_arr[ri]->pattern_src;
+            int err;
+            PCRE2_SIZE erroff;
+            if (!pattern_stretchable(src)) continue;
+            h->seg_re[ri] = pcre2_compile((PCRE2_SPTR)src, PCRE2_ZERO_TERMINATED,
+                                          PCRE2_DOTALL | PCRE2_MULTILINE | PCRE2_USE_OFFSET_LIMIT,
+                                          &err, &erroff, NULL);
+            if (h->seg_re[ri] && cfg->jit) pcre2_jit_compile(h->seg_re[ri], PCRE2_JIT_COMPLETE);
+        }
+    }
+    build_match_contexts(h);
+    filter_init(h, cfg);
+    return h;
+}
+
+void ccze_close(Ccze *h) {
+    int k;
+    if (!h) return;
+    for (k = 0; k < h->nmctx; k++) pcre2_match_context_free(h->mctx[k]);
+    pcre2_match_context_free(h->global_mctx);
+    free(h->mctx);
+    free(h->rule_mctx);
+    free((void *)h->limit_hits);
+    if (h->syslog_re) pcre2_code_free(h->syslog_re);
+    filter_free(h);
+    rules_free(h->rules);
+    free(h->rule_arr);
+    free(h->bulk_safe);
+    automaton_free(h->automaton);
+    fanout_stop(h->fanout);
+    for (k = 0; h->seg_re && k < h->nrules; k++)
+        if (h->seg_re[k]) pcre2_code_free(h->seg_re[k]);
+    free(h->seg_re);
+    free(h);
+}
+
+int ccze_errors(const Ccze *h) { return h->errors; }
+
+int ccze_rule_count(const Ccze *h) { return h->nrules; }
+
+long ccze_limit_hits(const Ccze *h, int rule_id) {
+    if (rule_id < 1 || rule_id > h->nrules) return 0;
+    return h->limit_hits[rule_id - 1];
+}
+
+void ccze_colorize(const Ccze *h, const char *buf, size_t len, CczeSpanFn fn, void *ud) {
+    ccze_colorize_tier(h, buf, len, CCZE_TIER_FULL, fn, ud, NULL);
+}
+
+void ccze_colorize_tier(const Ccze *h, const char *buf, size_t len, CczeTier tier,
+                        CczeSpanFn fn, void *ud, CczeTimes *t) {
+    SpanOut so;
+    size_t off = 0;
+
+    if (h->ansi != CCZE_ANSI_RAW && memchr(buf, 0x1B, len)) {
+        ansi_colorize(h, buf, len, tier, fn, ud, t);
+        return;
+    }
+    so.tier = tier;
+    so.times = t;
+    so.fn = fn;
+    so.ud = ud;
+    so.buf = buf;
+    so.has_pending = 0;
+    so.nhits = filter_hits(h, buf, len, &so.hits);
+    so.hit = 0;
+
+    /* Strip syslog facility if requested */
+    if (h->remove_facility) {
+        off = facility_len(buf, len);
+        span_emit(&so, 0, off, CCZE_SPAN_HIDDEN, COL_RESET, 0);
+    }
+
+    /* Try syslog structural parse first, then generic rule-based processing */
+    if (tier == CCZE_TIER_WORDCOLOR || tier == CCZE_TIER_PLAIN ||
+        !process_syslog(h, &so, off, len - off))
+        apply_rules(h, &so, off, len - off);
+
+    span_flush(&so);
+    free(so.hits);
+}
+
+const char *ccze_span_kind_name(CczeSpanKind kind) {
+    static const char *names[] = {
+        "plain", "hidden", "rule", "tool", "date", "host", "proc", "pid",
+        "punct", "word", "uri", "path", "number", "match", "ansi"
+    };
+    if ((unsigned)kind >= sizeof(names) / sizeof(names[0])) return "plain";
+    return names[kind];
+}
+
+void ccze_colorize_lines(const Ccze *h, const char *buf, size_t len, CczeSpanFn fn, void *ud,
+                         CczeTimes *t) {
+    size_t pos = 0, from = 0;
+    int ansi = h->ansi != CCZE_ANSI_RAW && memchr(buf, 0x1B, len);
+
+    if (!h->fanout && !ansi) {
+        bulk_colorize(h, buf, len, fn, ud, t);
+        return;
+    }
+    /* Long lines go alone, to be shared out among the workers, and so do
+     * lines with escape sequences */
+    while (pos < len) {
+        const char *nl = (const char *)memchr(buf + pos, '\n', len - pos);
+        size_t n = nl ? (size_t)(nl - buf) + 1 - pos : len - pos;
+        if ((h->fanout && n >= h->big_line) || (ansi && memchr(buf + pos, 0x1B, n))) {
+            if (pos > from) bulk_colorize(h, buf + from, pos - from, fn, ud, t);
+            ccze_colorize_tier(h, buf + pos, n, CCZE_TIER_FULL, fn, ud, t);
+            from = pos + n;
+        }
+        pos += n;
+    }
+    if (len > from) bulk_colorize(h, buf + from, len - from, fn, ud, t);
+}
+
+const char *ccze_tier_name(CczeTier tier) {
+    static const char *names[] = { "full", "wordcolor", "syslog", "plain" };
+    if ((unsigned)tier >= CCZE_TIER_COUNT) return "full";
+    return names[tier];
+}
+
+const void *ccze_match_context(const Ccze *h) { return h->global_mctx; }
+
+const char *ccze_tool_cmd(const Ccze *h, int rule_id) {
+    if (rule_id < 1 || rule_id > h->nrules) return NULL;
+    return h->rule_arr[rule_id - 1]->tool_cmd;
+}
+
+void ccze_list_rules(const Ccze *h) {
+    rules_list(h->rules);
+}
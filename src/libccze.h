@@ -0,0 +1,212 @@
+#ifndef CCZE_LIBCCZE_H
+#define CCZE_LIBCCZE_H
+
+/* ----------------------------------------------------------------
+ * libccze - embeddable colorizing engine
+ *
+ * A Ccze handle holds the compiled rule set and the syslog parser.
+ * It is immutable once ccze_open() returns, so one handle can be
+ * shared by any number of threads calling ccze_colorize() at once.
+ *
+ * ccze_colorize() does not render anything. It reports a sequence of
+ * spans that exactly tile the input buffer, in order; the caller
+ * decides how to draw them (see color.h for the stock renderers).
+ * ---------------------------------------------------------------- */
+
+#include <stddef.h>
+#include "color.h"
+
+typedef struct Ccze Ccze;
+
+typedef enum {
+    CCZE_SPAN_PLAIN,    /* uncolored text */
+    CCZE_SPAN_HIDDEN,   /* text to drop from output (facility prefix with -r) */
+    CCZE_SPAN_RULE,     /* color rule match */
+    CCZE_SPAN_TOOL,     /* tool rule match; pipe through ccze_tool_cmd() */
+    CCZE_SPAN_DATE,     /* syslog date */
+    CCZE_SPAN_HOST,     /* syslog hostname */
+    CCZE_SPAN_PROC,     /* syslog process name */
+    CCZE_SPAN_PID,      /* syslog pid */
+    CCZE_SPAN_PUNCT,    /* syslog "[", "]" and ":" */
+    CCZE_SPAN_WORD,     /* wordcolor keyword */
+    CCZE_SPAN_URI,      /* wordcolor URI */
+    CCZE_SPAN_PATH,     /* wordcolor path */
+    CCZE_SPAN_NUMBER,   /* wordcolor number */
+    CCZE_SPAN_MATCH,    /* --grep hit */
+    CCZE_SPAN_ANSI      /* escape sequence from the input (CCZE_ANSI_KEEP) */
+} CczeSpanKind;
+
+/* What to do with ANSI escape sequences already in the input */
+typedef enum {
+    CCZE_ANSI_RAW = 0,  /* nothing: they are text like any other */
+    CCZE_ANSI_STRIP,    /* report them as CCZE_SPAN_HIDDEN */
+    CCZE_ANSI_KEEP      /* report them as CCZE_SPAN_ANSI */
+} CczeAnsi;
+
+/* Severity classes for --min-level, least to most severe */
+typedef enum {
+    CCZE_LEVEL_NONE = 0,  /* no level keyword found */
+    CCZE_LEVEL_DEBUG,
+    CCZE_LEVEL_INFO,
+    CCZE_LEVEL_NOTICE,
+    CCZE_LEVEL_WARN,
+    CCZE_LEVEL_ERROR,
+    CCZE_LEVEL_CRIT
+} CczeLevel;
+
+typedef struct {
+    size_t       offset;  /* byte offset into the colorized buffer */
+    size_t       length;
+    Color        color;
+    CczeSpanKind kind;
+    int          rule_id; /* 1-based, as numbered by ccze_list_rules(); 0 if none */
+} CczeSpan;
+
+typedef void (*CczeSpanFn)(const char *buf, const CczeSpan *span, void *ud);
+
+#define CCZE_MAX_OVERRIDES 64
+
+/* Default CczeConfig.big_line */
+#define CCZE_BIG_LINE (1024 * 1024)
+
+/* A rule set compiled into the binary by tools/conf2c */
+typedef struct {
+    Color       color;
+    const char *tool_cmd;         /* tool rule if non-NULL */
+    const char *pattern;
+    unsigned    match_limit, depth_limit, heap_limit;  /* "limit" line; 0 = unset */
+} CczeBuiltinRule;
+
+typedef struct {
+    const CczeBuiltinRule *rules;
+    int                    nrules;
+    const unsigned char   *code;      /* pcre2_serialize_encode() of all patterns */
+    size_t                 code_len;
+    unsigned               match_limit, depth_limit, heap_limit;  /* "set" line */
+    const char            *source;    /* file the table was generated from */
+} CczeBuiltin;
+
+typedef struct {
+    const char *rcfile;           /* rule file; NULL for no rules */
+    int         wordcolor;        /* color keywords/paths/numbers in unmatched text */
+    int         remove_facility;  /* hide syslog facility/level prefix */
+    const char *color_overrides[CCZE_MAX_OVERRIDES]; /* "KEY=COLOR" */
+    int         num_overrides;
+    const char *grep;             /* only keep lines matching this (literal or PCRE2) */
+    CczeLevel   min_level;        /* only keep lines at least this severe */
+    int         jit;              /* JIT-compile the rules; pays off in long-running processes */
+    int         automaton;        /* find the rules a line can match in one DFA pass first */
+    int         line_threads;     /* > 1: run the rules on this many threads on long lines */
+    size_t      big_line;         /* how long, in bytes; 0 = CCZE_BIG_LINE */
+    CczeAnsi    ansi;             /* unless raw, the rules and --grep never see escapes */
+    const CczeBuiltin *builtin;   /* rules to use when rcfile is NULL */
+} CczeConfig;
+
+/* Fill cfg with defaults (wordcolor on, no rule file) */
+void ccze_config_init(CczeConfig *cfg);
+
+/* Load and compile the rule set (cfg->rcfile, else cfg->builtin). Never
+ * returns NULL; a missing or broken rule file leaves the handle with the
+ * rules that did compile. Built-in patterns are deserialized rather than
+ * compiled, unless they were serialized by a different PCRE2 build. */
+Ccze *ccze_open(const CczeConfig *cfg);
+void  ccze_close(Ccze *h);
+
+/* Number of rule file lines skipped because of errors (an unreadable
+ * file counts as one) */
+int ccze_errors(const Ccze *h);
+
+/* Number of rules loaded */
+int ccze_rule_count(const Ccze *h);
+
+/* Number of lines on which a rule was skipped because it hit its
+ * match/depth/heap limit */
+long ccze_limit_hits(const Ccze *h, int rule_id);
+
+/* Stress-test every rule against generated worst-case inputs and print
+ * a report to stderr. Returns the number of rules flagged. */
+int ccze_check_rules(const Ccze *h);
+
+/* Colorize len bytes of buf (one line or a multi-line record) and
+ * report its spans to fn. buf is not copied or modified. */
+void ccze_colorize(const Ccze *h, const char *buf, size_t len, CczeSpanFn fn, void *ud);
+
+/* How much of the engine to run, from everything down to nothing.
+ * Each tier is cheaper than the one before and emits fewer spans. */
+typedef enum {
+    CCZE_TIER_FULL,               /* syslog fields, rules, wordcolor */
+    CCZE_TIER_WORDCOLOR,          /* wordcolor only */
+    CCZE_TIER_SYSLOG,             /* syslog fields only */
+    CCZE_TIER_PLAIN,              /* the line as one plain span */
+    CCZE_TIER_COUNT
+} CczeTier;
+
+const char *ccze_tier_name(CczeTier tier);
+
+/* Time spent in ccze_colorize_tier(), in QueryPerformanceCounter ticks */
+typedef struct {
+    long long rules;              /* PCRE2: the syslog parser and the rules */
+    long long wordcolor;          /* keyword/path/URI/number lexer */
+} CczeTimes;
+
+/* ccze_colorize() at the given tier. If t is non-NULL, also add the
+ * time spent to *t; that reads the clock around every token, so callers
+ * time a sample of lines, not all. --grep hits are marked at every tier. */
+void ccze_colorize_tier(const Ccze *h, const char *buf, size_t len, CczeTier tier,
+                        CczeSpanFn fn, void *ud, CczeTimes *t);
+
+/* ccze_colorize() on each line of buf in turn, with the same spans, but
+ * running each rule once over all the lines rather than once per line.
+ * fn gets each line as its buf. Callers pass the lines that passed
+ * ccze_filter(), some hundred KB at a time. t is as for
+ * ccze_colorize_tier() and may be NULL. */
+void ccze_colorize_lines(const Ccze *h, const char *buf, size_t len, CczeSpanFn fn, void *ud,
+                         CczeTimes *t);
+
+/* Line filter (--grep / --min-level): returns 1 if the line should be
+ * kept. This is much cheaper than ccze_colorize(), so callers run it
+ * first and skip colorizing dropped lines. Kept lines get their grep
+ * hits reported as CCZE_SPAN_MATCH spans. */
+int ccze_filter(const Ccze *h, const char *buf, size_t len);
+
+/* 0 if the --grep pattern failed to compile */
+int ccze_filter_ok(const Ccze *h);
+
+/* Most severe level keyword (or syslog <PRI>) in a line */
+CczeLevel ccze_line_level(const char *buf, size_t len);
+
+/* Parse "debug", "info", "notice", "warn", "error" or "crit"; -1 if unknown */
+int ccze_parse_level(const char *name);
+
+/* "none", "debug", ... "crit" */
+const char *ccze_level_name(CczeLevel level);
+
+/* Timestamps are sortable keys, not epoch seconds: syslog dates have no
+ * year, so a key is ((year*13 + month)*32 + day)*86400 + seconds with
+ * year 0 when the text doesn't give one. key % CCZE_TIME_YEAR drops the
+ * year for comparing against a year-less time. */
+#define CCZE_TIME_YEAR ((long long)13 * 32 * 86400)
+
+/* Timestamp at the start of a line (after any facility prefix): syslog
+ * "Feb 22 00:00:18", "Feb 18, 2026 6:21:11 PM" or ISO 8601. Returns 1
+ * and sets *t if one was found. */
+int ccze_line_time(const Ccze *h, const char *buf, size_t len, long long *t);
+
+/* Parse a whole string in one of the formats above; returns 1 on success */
+int ccze_parse_time(const char *text, long long *t);
+
+/* Short lowercase name of a span kind ("rule", "date", ...) */
+const char *ccze_span_kind_name(CczeSpanKind kind);
+
+/* The global match/depth/heap limits ("set" line) as a PCRE2 8-bit
+ * match context, for callers running patterns of their own on the same
+ * terms. Owned by h; copy it to keep it past ccze_close(). */
+const void *ccze_match_context(const Ccze *h);
+
+/* Command line of a tool rule, or NULL */
+const char *ccze_tool_cmd(const Ccze *h, int rule_id);
+
+/* Print the loaded rules to stderr */
+void ccze_list_rules(const Ccze *h);
+
+#endif /* CCZE_LIBCCZE_H */
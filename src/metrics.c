@@ -0,0 +1,187 @@
+#include "metrics.h"
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+
+static long long ticks(void) {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+static double tick_secs(long long t) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (double)t / (double)freq.QuadPart;
+}
+
+void metrics_render(Metrics *m, Renderer *r, const char *buf, size_t len, CczeTier tier) {
+    long long t0 = ticks(), t1;
+
+    m->lines_out++;
+    if (++m->tick % METRICS_SAMPLE == 0) {
+        CczeTimes t = { 0, 0 };
+        long long tools = r->tool_ticks;
+        ccze_colorize_tier(r->engine, buf, len, tier, render_span, r, &t);
+        t1 = ticks();
+        m->s_total += t1 - t0;
+        m->s_rules += t.rules;
+        m->s_wordcolor += t.wordcolor;
+        m->s_tools += r->tool_ticks - tools;
+    } else {
+        ccze_colorize_tier(r->engine, buf, len, tier, render_span, r, NULL);
+        t1 = ticks();
+    }
+    m->busy += t1 - t0;
+}
+
+void metrics_render_lines(Metrics *m, Renderer *r, const char *buf, size_t len, unsigned n) {
+    long long t0 = ticks(), t1;
+
+    m->lines_out += n;
+    /* One chunk in METRICS_SAMPLE: the split is a share of the time, so
+     * sampling chunks rather than lines comes to the same */
+    if (++m->tick % METRICS_SAMPLE == 0) {
+        CczeTimes t = { 0, 0 };
+        long long tools = r->tool_ticks;
+        ccze_colorize_lines(r->engine, buf, len, render_span, r, &t);
+        t1 = ticks();
+        m->s_total += t1 - t0;
+        m->s_rules += t.rules;
+        m->s_wordcolor += t.wordcolor;
+        m->s_tools += r->tool_ticks - tools;
+    } else {
+        ccze_colorize_lines(r->engine, buf, len, render_span, r, NULL);
+        t1 = ticks();
+    }
+    m->busy += t1 - t0;
+}
+
+/* ----------------------------------------------------------------
+ * Dumps
+ * ---------------------------------------------------------------- */
+void metrics_dump(const Metrics *m, FILE *fp, int json, MetricsMark *prev) {
+    long long now = ticks();
+    unsigned long long lines = m->lines_in;
+    double up = tick_secs(now - m->started);
+    double since = tick_secs(now - (prev->at ? prev->at : m->started));
+    double rate = since > 0 ? (double)(lines - prev->lines) / since : 0;
+    double avg = up > 0 ? (double)lines / up : 0;
+    /* Tool time is exact; the sampled split of the rest is scaled to it */
+    double tools = tick_secs(m->r->tool_ticks);
+    double rest = tick_secs(m->busy) - tools;
+    long long s_rest = m->s_total - m->s_tools;
+    double rules, words, output;
+
+    if (rest < 0) rest = 0;
+    rules = s_rest > 0 ? rest * (double)m->s_rules / (double)s_rest : 0;
+    words = s_rest > 0 ? rest * (double)m->s_wordcolor / (double)s_rest : 0;
+    output = rest - rules - words;
+    if (output < 0) output = 0;
+    prev->lines = lines;
+    prev->at = now;
+
+    if (json) {
+        fprintf(fp, "{\"uptime_s\":%.1f,\"lines_in\":%llu,\"bytes_in\":%llu,\"lines_out\":%llu,"
+                    "\"bytes_out\":%llu,\"lines_per_s\":%.1f,\"lines_per_s_avg\":%.1f,",
+                up, lines, m->bytes_in, m->lines_out, m->r->out->written, rate, avg);
+        fprintf(fp, "\"busy_s\":%.3f,\"rules_s\":%.3f,\"wordcolor_s\":%.3f,\"tools_s\":%.3f,"
+                    "\"output_s\":%.3f,\"tool_runs\":%llu,\"tool_failures\":%llu,\"line_buffer\":%llu",
+                tools + rest, rules, words, tools, output,
+                m->r->tool_runs, m->r->tool_failures, (unsigned long long)m->lb->cap);
+        if (m->adapt)
+            fprintf(fp, ",\"tier\":\"%s\",\"tier_changes\":%llu,\"backlog\":%lld,\"write_share\":%.3f",
+                    ccze_tier_name(m->adapt->tier), m->adapt->changes, m->adapt->backlog,
+                    m->adapt->write_share);
+        fprintf(fp, "}\n");
+        return;
+    }
+    fprintf(fp, "%-24s %12.1f s\n", "uptime", up);
+    fprintf(fp, "%-24s %12llu   %.1f/s now, %.1f/s average\n", "lines in", lines, rate, avg);
+    fprintf(fp, "%-24s %12llu\n%-24s %12llu\n%-24s %12llu\n",
+            "bytes in", m->bytes_in, "lines out", m->lines_out, "bytes out", m->r->out->written);
+    fprintf(fp, "%-24s %12.3f s   %.1f%% of uptime\n", "busy", tools + rest,
+            up > 0 ? (tools + rest) * 100.0 / up : 0);
+    fprintf(fp, "%-24s %12.3f s\n%-24s %12.3f s\n%-24s %12.3f s\n%-24s %12.3f s\n",
+            "  rules", rules, "  wordcolor", words, "  tools", tools, "  output", output);
+    fprintf(fp, "%-24s %12llu\n%-24s %12llu\n%-24s %12llu bytes\n",
+            "tool runs", m->r->tool_runs, "tool failures", m->r->tool_failures,
+            "line buffer", (unsigned long long)m->lb->cap);
+    if (m->adapt) {
+        fprintf(fp, "%-24s %12s   %llu change%s\n", "tier", ccze_tier_name(m->adapt->tier),
+                m->adapt->changes, m->adapt->changes == 1 ? "" : "s");
+        fprintf(fp, "%-24s %12lld bytes\n%-24s %12.1f %%\n", "backlog", m->adapt->backlog,
+                "writing output", m->adapt->write_share * 100.0);
+    }
+}
+
+/* Write to PATH.tmp and move it over PATH, so readers never see half */
+static void metrics_write(Metrics *m, MetricsMark *prev) {
+    FILE *fp = fopen(m->tmp, "w");
+    if (!fp) return;
+    metrics_dump(m, fp, m->json, prev);
+    fclose(fp);
+    if (!MoveFileExA(m->tmp, m->path, MOVEFILE_REPLACE_EXISTING)) remove(m->tmp);
+}
+
+static DWORD WINAPI metrics_thread(void *arg) {
+    Metrics *m = (Metrics *)arg;
+    MetricsMark prev = { 0, 0 };
+
+    while (WaitForSingleObject((HANDLE)m->stop_event, (DWORD)m->interval_ms) == WAIT_TIMEOUT)
+        metrics_write(m, &prev);
+    metrics_write(m, &prev);
+    return 0;
+}
+
+/* ----------------------------------------------------------------
+ * Ctrl+Break
+ *
+ * The console runs the handler on a thread of its own. Ctrl+C is left
+ * to the default handler, which ends the process.
+ * ---------------------------------------------------------------- */
+static const Metrics *console_metrics;
+static MetricsMark    console_mark;
+
+static BOOL WINAPI on_console(DWORD event) {
+    if (event != CTRL_BREAK_EVENT || !console_metrics) return FALSE;
+    fprintf(stderr, "\n");
+    metrics_dump(console_metrics, stderr, 0, &console_mark);
+    fflush(stderr);
+    return TRUE;
+}
+
+void metrics_start(Metrics *m, const Renderer *r, const LineBuf *lb,
+                   const char *path, int interval_sec, int json) {
+    memset(m, 0, sizeof(*m));
+    m->r = r;
+    m->lb = lb;
+    m->json = json;
+    m->started = ticks();
+    console_metrics = m;
+    SetConsoleCtrlHandler(on_console, TRUE);
+
+    if (!path) return;
+    m->path = _strdup(path);
+    m->tmp = (char *)malloc(strlen(path) + 5);
+    strcpy(m->tmp, path);
+    strcat(m->tmp, ".tmp");
+    m->interval_ms = (interval_sec > 0 ? interval_sec : 10) * 1000;
+    m->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (m->stop_event) m->thread = CreateThread(NULL, 0, metrics_thread, m, 0, NULL);
+    if (!m->thread) fprintf(stderr, "ccze: warning: cannot start writing %s\n", path);
+}
+
+void metrics_stop(Metrics *m) {
+    SetConsoleCtrlHandler(on_console, FALSE);
+    console_metrics = NULL;
+    if (m->thread) {
+        SetEvent((HANDLE)m->stop_event);
+        WaitForSingleObject((HANDLE)m->thread, INFINITE);
+        CloseHandle((HANDLE)m->thread);
+    }
+    if (m->stop_event) CloseHandle((HANDLE)m->stop_event);
+    free(m->path);
+    free(m->tmp);
+    memset(m, 0, sizeof(*m));
+}
@@ -0,0 +1,66 @@
+#ifndef CCZE_METRICS_H
+#define CCZE_METRICS_H
+
+#include <stdio.h>
+#include "adapt.h"
+#include "input.h"
+#include "render.h"
+
+/* ----------------------------------------------------------------
+ * Live metrics (Ctrl+Break, --metrics-file)
+ *
+ * The main loop bumps plain counters as it goes; dumps read them from
+ * another thread: the console's Ctrl+Break handler (to stderr) or a
+ * thread that rewrites the metrics file every few seconds. Whole-line
+ * time is taken on every line; the split into rules, wordcolor, tools
+ * and output is taken on one line in METRICS_SAMPLE and scaled up, as
+ * reading the clock around every token costs about what the lexer does.
+ * ---------------------------------------------------------------- */
+#define METRICS_SAMPLE 16
+
+typedef struct {
+    volatile unsigned long long lines_in;    /* lines (or records) read */
+    volatile unsigned long long bytes_in;
+    volatile unsigned long long lines_out;   /* ... that passed --grep/--min-level */
+    volatile long long          busy;        /* ticks colorizing and writing */
+    volatile long long          s_total;     /* ticks of the sampled lines ... */
+    volatile long long          s_rules;     /* ... in PCRE2 */
+    volatile long long          s_wordcolor; /* ... in the wordcolor lexer */
+    volatile long long          s_tools;     /* ... in tool commands */
+    unsigned                    tick;        /* picks the sampled lines */
+    const Renderer             *r;           /* bytes out, tool runs */
+    const LineBuf              *lb;          /* line buffer size */
+    const Adapt                *adapt;       /* --adaptive tier, or NULL */
+    long long                   started;
+    char                       *path;        /* NULL: Ctrl+Break only */
+    char                       *tmp;
+    int                         json;
+    int                         interval_ms;
+    void                       *thread;
+    void                       *stop_event;
+} Metrics;
+
+/* Start collecting and hook Ctrl+Break. If path is set, also rewrite it
+ * every interval_sec seconds (text, or JSON if json), and once more at
+ * metrics_stop(). r and lb must outlive the Metrics. */
+void metrics_start(Metrics *m, const Renderer *r, const LineBuf *lb,
+                   const char *path, int interval_sec, int json);
+
+/* Colorize and render a line that passed the filters, timing it */
+void metrics_render(Metrics *m, Renderer *r, const char *buf, size_t len, CczeTier tier);
+
+/* The same for n such lines run through ccze_colorize_lines() at once */
+void metrics_render_lines(Metrics *m, Renderer *r, const char *buf, size_t len, unsigned n);
+
+/* Where the previous dump to a destination was, for the current rate */
+typedef struct {
+    unsigned long long lines;
+    long long          at;
+} MetricsMark;
+
+/* Write everything collected so far to fp; prev starts zeroed */
+void metrics_dump(const Metrics *m, FILE *fp, int json, MetricsMark *prev);
+
+void metrics_stop(Metrics *m);
+
+#endif /* CCZE_METRICS_H */
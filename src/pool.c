@@ -0,0 +1,118 @@
+#include "pool.h"
+#include <windows.h>
+#include <stdlib.h>
+
+#define POOL_QUEUE_PER_THREAD 2
+
+struct Pool {
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE not_empty;
+    CONDITION_VARIABLE not_full;
+    void             **queue;     /* ring buffer */
+    int                cap, head, count;
+    int                closing;
+    HANDLE            *threads;
+    int                nthreads;
+    PoolFn             fn;
+    void              *ud;
+};
+
+typedef struct {
+    Pool *pool;
+    int   worker;
+} PoolWorker;
+
+int pool_default_threads(void) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI pool_thread(void *arg) {
+    PoolWorker *w = (PoolWorker *)arg;
+    Pool *p = w->pool;
+    void *task;
+
+    for (;;) {
+        EnterCriticalSection(&p->lock);
+        while (p->count == 0 && !p->closing)
+            SleepConditionVariableCS(&p->not_empty, &p->lock, INFINITE);
+        if (p->count == 0) {
+            LeaveCriticalSection(&p->lock);
+            break;
+        }
+        task = p->queue[p->head];
+        p->head = (p->head + 1) % p->cap;
+        p->count--;
+        WakeConditionVariable(&p->not_full);
+        LeaveCriticalSection(&p->lock);
+
+        p->fn(task, w->worker, p->ud);
+    }
+    free(w);
+    return 0;
+}
+
+Pool *pool_create(int nthreads, PoolFn fn, void *ud) {
+    Pool *p = (Pool *)calloc(1, sizeof(Pool));
+    int i;
+
+    if (nthreads < 1) nthreads = 1;
+    InitializeCriticalSection(&p->lock);
+    InitializeConditionVariable(&p->not_empty);
+    InitializeConditionVariable(&p->not_full);
+    p->cap = nthreads * POOL_QUEUE_PER_THREAD;
+    p->queue = (void **)malloc(p->cap * sizeof(void *));
+    p->threads = (HANDLE *)malloc(nthreads * sizeof(HANDLE));
+    p->fn = fn;
+    p->ud = ud;
+
+    for (i = 0; i < nthreads; i++) {
+        PoolWorker *w = (PoolWorker *)malloc(sizeof(PoolWorker));
+        w->pool = p;
+        w->worker = i;
+        p->threads[i] = CreateThread(NULL, 0, pool_thread, w, 0, NULL);
+        if (!p->threads[i]) {
+            free(w);
+            break;
+        }
+        p->nthreads++;
+    }
+    if (p->nthreads == 0) {
+        DeleteCriticalSection(&p->lock);
+        free(p->threads);
+        free(p->queue);
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+int pool_threads(const Pool *p) { return p->nthreads; }
+
+void pool_submit(Pool *p, void *task) {
+    EnterCriticalSection(&p->lock);
+    while (p->count == p->cap)
+        SleepConditionVariableCS(&p->not_full, &p->lock, INFINITE);
+    p->queue[(p->head + p->count) % p->cap] = task;
+    p->count++;
+    WakeConditionVariable(&p->not_empty);
+    LeaveCriticalSection(&p->lock);
+}
+
+void pool_finish(Pool *p) {
+    int i;
+    EnterCriticalSection(&p->lock);
+    p->closing = 1;
+    WakeAllConditionVariable(&p->not_empty);
+    LeaveCriticalSection(&p->lock);
+
+    for (i = 0; i < p->nthreads; i++) {
+        WaitForSingleObject(p->threads[i], INFINITE);
+        CloseHandle(p->threads[i]);
+    }
+    DeleteCriticalSection(&p->lock);
+    free(p->threads);
+    free(p->queue);
+    free(p);
+}
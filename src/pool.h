@@ -0,0 +1,30 @@
+#ifndef CCZE_POOL_H
+#define CCZE_POOL_H
+
+/* ----------------------------------------------------------------
+ * Fixed-size worker thread pool
+ *
+ * Tasks are opaque pointers handed to one callback. The queue is
+ * bounded, so pool_submit() blocks while the workers are behind; the
+ * reader never gets more than a few chunks ahead of them.
+ * ---------------------------------------------------------------- */
+typedef struct Pool Pool;
+
+/* Run on a worker thread; worker is 0..nthreads-1, for per-thread state */
+typedef void (*PoolFn)(void *task, int worker, void *ud);
+
+/* Number of processors, the default thread count */
+int pool_default_threads(void);
+
+/* Start nthreads workers. Returns NULL if no thread could be started. */
+Pool *pool_create(int nthreads, PoolFn fn, void *ud);
+
+/* Number of workers actually running */
+int pool_threads(const Pool *p);
+
+void pool_submit(Pool *p, void *task);
+
+/* Run every queued task, stop the workers and free the pool */
+void pool_finish(Pool *p);
+
+#endif /* CCZE_POOL_H */
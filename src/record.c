@@ -0,0 +1,67 @@
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include "record.h"
+#include <pcre2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int record_init(RecordAsm *ra, const char *start_pattern, int max_lines, size_t max_bytes,
+                const void *mctx) {
+    int err;
+    PCRE2_SIZE erroff;
+
+    memset(ra, 0, sizeof(*ra));
+    ra->start_re = pcre2_compile((PCRE2_SPTR)start_pattern, PCRE2_ZERO_TERMINATED,
+                                 0, &err, &erroff, NULL);
+    if (!ra->start_re) {
+        PCRE2_UCHAR errbuf[256];
+        pcre2_get_error_message(err, errbuf, sizeof(errbuf));
+        fprintf(stderr, "ccze: error: record pattern: regex error at offset %d: %s\n",
+                (int)erroff, (char *)errbuf);
+        return 0;
+    }
+    ra->md = pcre2_match_data_create_from_pattern((pcre2_code *)ra->start_re, NULL);
+    /* A copy: --watch may close the engine while a record is pending */
+    if (mctx) ra->mctx = pcre2_match_context_copy((pcre2_match_context *)mctx);
+    ra->max_lines = max_lines > 0 ? max_lines : 1;
+    ra->max_bytes = max_bytes > 0 ? max_bytes : 1;
+    linebuf_init(&ra->rec);
+    return 1;
+}
+
+void record_free(RecordAsm *ra) {
+    if (!ra->start_re) return;
+    pcre2_match_data_free((pcre2_match_data *)ra->md);
+    pcre2_match_context_free((pcre2_match_context *)ra->mctx);
+    pcre2_code_free((pcre2_code *)ra->start_re);
+    linebuf_free(&ra->rec);
+    ra->start_re = NULL;
+}
+
+int record_pending(const RecordAsm *ra) { return ra->nlines > 0; }
+
+void record_flush(RecordAsm *ra, RecordFn fn, void *ctx) {
+    if (!ra->nlines) return;
+    fn(ra->rec.buf, (int)ra->rec.len, ra->offset, ctx);
+    ra->rec.len = 0;
+    ra->rec.buf[0] = '\0';
+    ra->nlines = 0;
+}
+
+/* A line that runs into a match limit doesn't start a record */
+static int is_record_start(RecordAsm *ra, const char *line, size_t len) {
+    return pcre2_match((pcre2_code *)ra->start_re, (PCRE2_SPTR)line, len, 0, PCRE2_ANCHORED,
+                       (pcre2_match_data *)ra->md, (pcre2_match_context *)ra->mctx) >= 0;
+}
+
+void record_push(RecordAsm *ra, const char *line, size_t len, unsigned long long offset,
+                 RecordFn fn, void *ctx) {
+    if (ra->nlines > 0 &&
+        (ra->rec.len + len > ra->max_bytes || is_record_start(ra, line, len)))
+        record_flush(ra, fn, ctx);
+
+    if (!ra->nlines) ra->offset = offset;
+    linebuf_append(&ra->rec, line, len);
+    if (++ra->nlines >= ra->max_lines)
+        record_flush(ra, fn, ctx);
+}
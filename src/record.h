@@ -0,0 +1,39 @@
+#ifndef CCZE_RECORD_H
+#define CCZE_RECORD_H
+
+#include "input.h"
+
+/* Called with each assembled record (one or more complete lines) and
+ * the input offset of its first line */
+typedef void (*RecordFn)(const char *rec, int len, unsigned long long offset, void *ctx);
+
+/* Groups continuation lines into logical records. A record starts at a
+ * line matching start_re and runs until the next such line, or until one
+ * of the size/line limits is reached. */
+typedef struct {
+    void    *start_re;
+    void    *md;
+    void    *mctx;      /* the engine's limits, copied */
+    int      max_lines;
+    size_t   max_bytes;
+    LineBuf  rec;
+    int      nlines;
+    unsigned long long offset;
+} RecordAsm;
+
+/* Compile the start-of-record pattern, to be run under the limits of
+ * mctx (ccze_match_context()). Returns 0 on a regex error. */
+int  record_init(RecordAsm *ra, const char *start_pattern, int max_lines, size_t max_bytes,
+                 const void *mctx);
+void record_free(RecordAsm *ra);
+
+/* Feed one physical line read at offset; completed records are passed to fn */
+void record_push(RecordAsm *ra, const char *line, size_t len, unsigned long long offset,
+                 RecordFn fn, void *ctx);
+
+/* Emit the pending record, if any */
+void record_flush(RecordAsm *ra, RecordFn fn, void *ctx);
+
+int  record_pending(const RecordAsm *ra);
+
+#endif /* CCZE_RECORD_H */
@@ -0,0 +1,103 @@
+#include "reload.h"
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    FILETIME mtime;
+    DWORD    size;
+    int      exists;
+} FileStamp;
+
+static void file_stamp(const char *path, FileStamp *fs) {
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    memset(fs, 0, sizeof(*fs));
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &fad)) {
+        fs->mtime = fad.ftLastWriteTime;
+        fs->size = fad.nFileSizeLow;
+        fs->exists = 1;
+    }
+}
+
+static int stamp_equal(const FileStamp *a, const FileStamp *b) {
+    return a->exists == b->exists && a->size == b->size &&
+           CompareFileTime(&a->mtime, &b->mtime) == 0;
+}
+
+static void reload_compile(Reloader *rl) {
+    LARGE_INTEGER freq, t0, t1;
+    Ccze *h, *old;
+    int errors;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+    h = ccze_open(&rl->cfg);
+    QueryPerformanceCounter(&t1);
+
+    errors = ccze_errors(h);
+    if (errors > 0) {
+        fprintf(stderr, "ccze: reload of %s failed (%d error%s), keeping previous rules\n",
+                rl->cfg.rcfile, errors, errors == 1 ? "" : "s");
+        ccze_close(h);
+        return;
+    }
+
+    /* If the main loop hasn't taken the last one yet, this one supersedes it */
+    old = (Ccze *)InterlockedExchangePointer((void *volatile *)&rl->pending, h);
+    if (old) ccze_close(old);
+
+    fprintf(stderr, "ccze: reloaded %s: %d rules compiled in %.1f ms\n",
+            rl->cfg.rcfile, ccze_rule_count(h),
+            (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart);
+}
+
+static DWORD WINAPI reload_thread(void *arg) {
+    Reloader *rl = (Reloader *)arg;
+    FileStamp cur, seen;
+
+    file_stamp(rl->cfg.rcfile, &cur);
+    while (WaitForSingleObject((HANDLE)rl->stop_event, (DWORD)rl->interval_ms) == WAIT_TIMEOUT) {
+        file_stamp(rl->cfg.rcfile, &seen);
+        if (stamp_equal(&seen, &cur) || !seen.exists) continue;
+
+        /* Let an editor finish writing before compiling */
+        do {
+            cur = seen;
+            if (WaitForSingleObject((HANDLE)rl->stop_event, 100) != WAIT_TIMEOUT) return 0;
+            file_stamp(rl->cfg.rcfile, &seen);
+        } while (!stamp_equal(&seen, &cur));
+
+        reload_compile(rl);
+    }
+    return 0;
+}
+
+int reload_start(Reloader *rl, const CczeConfig *cfg, int interval_ms) {
+    memset(rl, 0, sizeof(*rl));
+    rl->cfg = *cfg;
+    rl->interval_ms = interval_ms > 0 ? interval_ms : 1000;
+    rl->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!rl->stop_event) return 0;
+    rl->thread = CreateThread(NULL, 0, reload_thread, rl, 0, NULL);
+    if (!rl->thread) {
+        CloseHandle((HANDLE)rl->stop_event);
+        rl->stop_event = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+Ccze *reload_poll(Reloader *rl) {
+    if (!rl->pending) return NULL;
+    return (Ccze *)InterlockedExchangePointer((void *volatile *)&rl->pending, NULL);
+}
+
+void reload_stop(Reloader *rl) {
+    if (!rl->thread) return;
+    SetEvent((HANDLE)rl->stop_event);
+    WaitForSingleObject((HANDLE)rl->thread, INFINITE);
+    CloseHandle((HANDLE)rl->thread);
+    CloseHandle((HANDLE)rl->stop_event);
+    ccze_close(reload_poll(rl));
+    rl->thread = NULL;
+}
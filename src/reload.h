@@ -0,0 +1,32 @@
+#ifndef CCZE_RELOAD_H
+#define CCZE_RELOAD_H
+
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Rule file hot reload (--watch)
+ *
+ * A background thread polls the rule file's timestamp and size. On a
+ * change it compiles a complete new engine off the hot path; the main
+ * loop picks it up between lines with reload_poll(). A rule file with
+ * errors is rejected and the running rules are kept.
+ * ---------------------------------------------------------------- */
+typedef struct {
+    CczeConfig     cfg;
+    void          *thread;
+    void          *stop_event;
+    Ccze *volatile pending;
+    int            interval_ms;
+} Reloader;
+
+/* Start watching cfg->rcfile. cfg (and the strings it points to) must
+ * stay valid until reload_stop(). Returns 0 if the thread can't start. */
+int reload_start(Reloader *rl, const CczeConfig *cfg, int interval_ms);
+
+/* Returns a freshly compiled engine if one is ready, else NULL. The
+ * caller owns it and closes the engine it replaces. */
+Ccze *reload_poll(Reloader *rl);
+
+void reload_stop(Reloader *rl);
+
+#endif /* CCZE_RELOAD_H */
@@ -0,0 +1,61 @@
+#include "render.h"
+#include "tool.h"
+#include <windows.h>
+#include <stdlib.h>
+
+static void draw(Renderer *r, Color c, int plain, const char *text, int len) {
+    int i;
+    if (plain) color_write_plain(r->out, text, len);
+    else color_write(r->out, c, text, len);
+    for (i = 0; i < r->ntees; i++) {
+        ColorOut *co = tee_out(r->tees[i]);
+        if (plain) color_write_plain(co, text, len);
+        else color_write(co, c, text, len);
+        tee_commit(r->tees[i], 0);
+    }
+}
+
+void render_span(const char *buf, const CczeSpan *sp, void *ud) {
+    Renderer *r = (Renderer *)ud;
+    const char *text = buf + sp->offset;
+    int len = (int)sp->length;
+
+    switch (sp->kind) {
+    case CCZE_SPAN_HIDDEN:
+        break;
+    case CCZE_SPAN_ANSI:
+        /* Tee sinks are HTML or text, where there is nothing to restore */
+        color_write_escape(r->out, text, len);
+        break;
+    case CCZE_SPAN_PLAIN:
+        draw(r, COL_RESET, 1, text, len);
+        break;
+    case CCZE_SPAN_TOOL: {
+        LARGE_INTEGER t0, t1;
+        int olen = 0;
+        char *out;
+        QueryPerformanceCounter(&t0);
+        out = tool_run(ccze_tool_cmd(r->engine, sp->rule_id), text, len, &olen);
+        QueryPerformanceCounter(&t1);
+        r->tool_runs++;
+        r->tool_ticks += t1.QuadPart - t0.QuadPart;
+        if (out) {
+            while (olen > 0 && (out[olen - 1] == '\n' || out[olen - 1] == '\r')) olen--;
+            draw(r, sp->color, 0, out, olen);
+            free(out);
+        } else {
+            r->tool_failures++;
+            draw(r, COL_RESET, 1, text, len);
+        }
+        break;
+    }
+    default:
+        draw(r, sp->color, 0, text, len);
+        break;
+    }
+}
+
+void render_commit(Renderer *r) {
+    int i;
+    for (i = 0; i < r->ntees; i++) tee_commit(r->tees[i], 1);
+}
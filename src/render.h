@@ -0,0 +1,29 @@
+#ifndef CCZE_RENDER_H
+#define CCZE_RENDER_H
+
+#include "color.h"
+#include "libccze.h"
+#include "tee.h"
+
+/* ----------------------------------------------------------------
+ * Span renderer: draws the spans ccze_colorize() reports onto a
+ * ColorOut and any --tee sinks, piping tool spans through their command
+ * once for all of them.
+ * ---------------------------------------------------------------- */
+typedef struct {
+    const Ccze *engine;
+    ColorOut   *out;
+    Tee        *tees[TEE_MAX];
+    int         ntees;
+    unsigned long long tool_runs;     /* tool commands started */
+    unsigned long long tool_failures; /* ... that failed; the text went out as is */
+    long long          tool_ticks;    /* time in tools (QueryPerformanceCounter) */
+} Renderer;
+
+/* CczeSpanFn; ud is a Renderer */
+void render_span(const char *buf, const CczeSpan *sp, void *ud);
+
+/* Hand everything drawn on the tee sinks to their writers */
+void render_commit(Renderer *r);
+
+#endif /* CCZE_RENDER_H */
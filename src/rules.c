@@ -32,14 +32,39 @@ static char *next_token(char **p) {
     }
 }
 
-Rule *rules_load(const char *filepath) {
+/* Parse "match=N depth=N heap=N" tokens into lim. Returns 0 on a bad token. */
+static int parse_limits(char *p, RuleLimits *lim, int lineno) {
+    char *tok;
+    int ok = 1;
+    while ((tok = next_token(&p)) != NULL) {
+        char *eq = strchr(tok, '=');
+        unsigned val = eq ? (unsigned)strtoul(eq + 1, NULL, 10) : 0;
+        if (eq && strncmp(tok, "match=", 6) == 0)      lim->match = val;
+        else if (eq && strncmp(tok, "depth=", 6) == 0) lim->depth = val;
+        else if (eq && strncmp(tok, "heap=", 5) == 0)  lim->heap = val;
+        else {
+            fprintf(stderr, "ccze: warning: line %d: unknown limit '%s'\n", lineno, tok);
+            ok = 0;
+        }
+        free(tok);
+    }
+    return ok;
+}
+
+Rule *rules_load(const char *filepath, RuleLimits *global, int *nerrors) {
     FILE *f = fopen(filepath, "r");
     Rule *head = NULL, *tail = NULL;
     char line[1024];
     int lineno = 0;
+    int errors = 0;
+    RuleLimits next_limits;
 
+    memset(&next_limits, 0, sizeof(next_limits));
+    if (global) memset(global, 0, sizeof(*global));
+    if (nerrors) *nerrors = 0;
     if (!f) {
         fprintf(stderr, "ccze: warning: could not open rule file: %s\n", filepath);
+        if (nerrors) *nerrors = 1;
         return NULL;
     }
 
@@ -58,12 +83,24 @@ Rule *rules_load(const char *filepath) {
         type_tok = next_token(&p);
         if (!type_tok) continue;
 
+        /* "set match=N ..." sets global limits; "limit match=N ..." applies
+         * to the next rule only */
+        if (strcmp(type_tok, "set") == 0 || strcmp(type_tok, "limit") == 0) {
+            RuleLimits scratch;
+            RuleLimits *lim = type_tok[0] == 's' ? (global ? global : &scratch) : &next_limits;
+            free(type_tok);
+            if (!parse_limits(p, lim, lineno)) errors++;
+            continue;
+        }
+
         if (strcmp(type_tok, "color") == 0) rtype = RULE_COLOR;
         else if (strcmp(type_tok, "tool") == 0) rtype = RULE_TOOL;
         else {
             fprintf(stderr, "ccze: warning: line %d: unknown rule type '%s'\n",
                     lineno, type_tok);
             free(type_tok);
+            memset(&next_limits, 0, sizeof(next_limits));
+            errors++;
             continue;
         }
         free(type_tok);
@@ -71,6 +108,8 @@ Rule *rules_load(const char *filepath) {
         color_or_cmd = next_token(&p);
         if (!color_or_cmd) {
             fprintf(stderr, "ccze: warning: line %d: missing color/command\n", lineno);
+            memset(&next_limits, 0, sizeof(next_limits));
+            errors++;
             continue;
         }
 
@@ -83,6 +122,8 @@ Rule *rules_load(const char *filepath) {
         if (ntok == 0) {
             fprintf(stderr, "ccze: warning: line %d: missing regex pattern\n", lineno);
             free(color_or_cmd);
+            memset(&next_limits, 0, sizeof(next_limits));
+            errors++;
             continue;
         }
 
@@ -122,6 +163,8 @@ Rule *rules_load(const char *filepath) {
                         lineno, (int)err_offset, (char *)errbuf);
                 free(pattern);
                 free(tool_cmd);
+                memset(&next_limits, 0, sizeof(next_limits));
+                errors++;
                 continue;
             }
 
@@ -132,14 +175,76 @@ Rule *rules_load(const char *filepath) {
                 r->tool_cmd = tool_cmd;
                 r->pattern_src = pattern;
                 r->re = re;
+                r->limits = next_limits;
                 r->next = NULL;
                 if (!head) head = tail = r;
                 else { tail->next = r; tail = r; }
+                memset(&next_limits, 0, sizeof(next_limits));
             }
         }
     }
 
     fclose(f);
+    if (nerrors) *nerrors = errors;
+    return head;
+}
+
+static char *dup_str(const char *s) {
+    char *d;
+    if (!s) return NULL;
+    d = (char *)malloc(strlen(s) + 1);
+    strcpy(d, s);
+    return d;
+}
+
+Rule *rules_builtin(const CczeBuiltin *b, RuleLimits *global) {
+    pcre2_code **codes = NULL;
+    Rule *head = NULL, *tail = NULL;
+    int i;
+
+    if (global) {
+        global->match = b->match_limit;
+        global->depth = b->depth_limit;
+        global->heap = b->heap_limit;
+    }
+
+    /* Serialized codes only load into the PCRE2 build that wrote them */
+    if (b->code && b->nrules > 0 &&
+        pcre2_serialize_get_number_of_codes(b->code) == b->nrules) {
+        codes = (pcre2_code **)malloc(b->nrules * sizeof(pcre2_code *));
+        if (pcre2_serialize_decode(codes, b->nrules, b->code, NULL) != b->nrules) {
+            free(codes);
+            codes = NULL;
+        }
+    }
+
+    for (i = 0; i < b->nrules; i++) {
+        const CczeBuiltinRule *br = &b->rules[i];
+        pcre2_code *re;
+        Rule *r;
+
+        if (codes) {
+            re = codes[i];
+        } else {
+            int err_code;
+            PCRE2_SIZE err_offset;
+            re = pcre2_compile((PCRE2_SPTR)br->pattern, PCRE2_ZERO_TERMINATED,
+                               PCRE2_DOTALL | PCRE2_MULTILINE, &err_code, &err_offset, NULL);
+            if (!re) continue;
+        }
+        r = (Rule *)calloc(1, sizeof(Rule));
+        r->type = br->tool_cmd ? RULE_TOOL : RULE_COLOR;
+        r->color = br->color;
+        r->tool_cmd = dup_str(br->tool_cmd);
+        r->pattern_src = dup_str(br->pattern);
+        r->re = re;
+        r->limits.match = br->match_limit;
+        r->limits.depth = br->depth_limit;
+        r->limits.heap = br->heap_limit;
+        if (!head) head = tail = r;
+        else { tail->next = r; tail = r; }
+    }
+    free(codes);
     return head;
 }
 
@@ -163,6 +268,9 @@ void rules_list(Rule *head) {
             fprintf(stderr, "  %3d  color  %-16s  %s\n", i, color_name(r->color), r->pattern_src);
         else
             fprintf(stderr, "  %3d  tool   %-16s  %s\n", i, r->tool_cmd, r->pattern_src);
+        if (r->limits.match || r->limits.depth || r->limits.heap)
+            fprintf(stderr, "       limit  match=%u depth=%u heap=%u\n",
+                    r->limits.match, r->limits.depth, r->limits.heap);
     }
     if (i == 1) fprintf(stderr, "  (none)\n");
 }
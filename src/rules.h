@@ -2,21 +2,38 @@
 #define CCZE_RULES_H
 
 #include "color.h"
+#include "libccze.h"
 #include <stddef.h>
 
 typedef enum { RULE_COLOR, RULE_TOOL } RuleType;
 
+/* PCRE2 match/depth/heap limits; 0 means "use the global/default value".
+ * heap is in KiB, as for pcre2_set_heap_limit(). */
+typedef struct {
+    unsigned match;
+    unsigned depth;
+    unsigned heap;
+} RuleLimits;
+
 typedef struct Rule {
-    RuleType type;
-    Color    color;
-    char    *tool_cmd;
-    char    *pattern_src;
-    void    *re;
+    RuleType   type;
+    Color      color;
+    char      *tool_cmd;
+    char      *pattern_src;
+    void      *re;
+    RuleLimits limits;
     struct Rule *next;
 } Rule;
 
-/* Load rules from file. Returns head of linked list (or NULL on error). */
-Rule *rules_load(const char *filepath);
+/* Load rules from file. Returns head of linked list (or NULL on error).
+ * Global "set" limits are stored in *global if non-NULL.
+ * If nerrors is non-NULL it receives the number of lines that were
+ * skipped because of errors (an unreadable file counts as one). */
+Rule *rules_load(const char *filepath, RuleLimits *global, int *nerrors);
+
+/* Build rules from a table generated by tools/conf2c. Global limits are
+ * stored in *global if non-NULL. */
+Rule *rules_builtin(const CczeBuiltin *b, RuleLimits *global);
 
 /* Free all rules */
 void rules_free(Rule *head);
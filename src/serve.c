@@ -0,0 +1,371 @@
+#define FD_SETSIZE 1024
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include "serve.h"
+#include "input.h"
+#include "pool.h"
+#include "render.h"
+
+#define SERVE_MAX_CONN (FD_SETSIZE - 1)
+#define SERVE_HDR_MAX  64      /* longest accepted header line */
+#define SERVE_POLL_MS  2       /* select() timeout while workers are busy */
+
+typedef struct {
+    SOCKET        sock;
+    char         *in;          /* incap bytes */
+    size_t        inlen;
+    size_t        incap;       /* SERVE_CONN_BUF, more while one line is longer */
+    size_t        outpos;      /* bytes of co.buf already sent */
+    int           have_header;
+    int           eof;         /* client is done sending */
+    volatile long busy;        /* a worker owns in and co */
+    ColorOut      co;
+} Conn;
+
+typedef struct {
+    const Ccze *h;
+    Pool       *pool;
+    Conn       *conns[SERVE_MAX_CONN];
+    int         nconns;
+} Server;
+
+static int net_init(void) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "ccze: error: cannot initialize Winsock\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int make_addr(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "ccze: error: socket path too long: %s\n", path);
+        return 0;
+    }
+    strcpy(addr->sun_path, path);
+    return 1;
+}
+
+/* ----------------------------------------------------------------
+ * Server: workers
+ * ---------------------------------------------------------------- */
+static void serve_line(Renderer *r, char *line, size_t len) {
+    if (len >= 2 && line[len - 2] == '\r' && line[len - 1] == '\n') {
+        line[len - 2] = '\n';
+        len--;
+    }
+    if (!ccze_filter(r->engine, line, len)) return;
+    ccze_colorize(r->engine, line, len, render_span, r);
+}
+
+/* Colorize every complete line in the connection's buffer */
+static void serve_batch(void *task, int worker, void *ud) {
+    Server *sv = (Server *)ud;
+    Conn *c = (Conn *)task;
+    Renderer r;
+    size_t off = 0;
+    const char *nl;
+
+    (void)worker;
+    memset(&r, 0, sizeof(r));
+    r.engine = sv->h;
+    r.out = &c->co;
+    while ((nl = (const char *)memchr(c->in + off, '\n', c->inlen - off)) != NULL) {
+        size_t n = (size_t)(nl - (c->in + off)) + 1;
+        serve_line(&r, c->in + off, n);
+        off += n;
+    }
+    /* The tail at EOF, or a line the buffer couldn't grow for, goes as is */
+    if (off < c->inlen && (c->eof || (off == 0 && c->inlen == c->incap))) {
+        serve_line(&r, c->in + off, c->inlen - off);
+        off = c->inlen;
+    }
+    memmove(c->in, c->in + off, c->inlen - off);
+    c->inlen -= off;
+    /* Back to the usual size once a long line is done */
+    if (c->incap > SERVE_CONN_BUF && c->inlen <= SERVE_CONN_BUF) {
+        char *in = (char *)realloc(c->in, SERVE_CONN_BUF);
+        if (in) {
+            c->in = in;
+            c->incap = SERVE_CONN_BUF;
+        }
+    }
+    InterlockedExchange(&c->busy, 0);
+}
+
+/* ----------------------------------------------------------------
+ * Server: connection handling (main thread only)
+ * ---------------------------------------------------------------- */
+static void conn_close(Server *sv, int i) {
+    Conn *c = sv->conns[i];
+    closesocket(c->sock);
+    color_free(&c->co);
+    free(c->in);
+    free(c);
+    sv->conns[i] = sv->conns[--sv->nconns];
+}
+
+static void conn_accept(Server *sv, SOCKET listener) {
+    SOCKET s = accept(listener, NULL, NULL);
+    u_long nonblock = 1;
+    Conn *c;
+
+    if (s == INVALID_SOCKET) return;
+    if (sv->nconns == SERVE_MAX_CONN) {
+        closesocket(s);
+        return;
+    }
+    ioctlsocket(s, FIONBIO, &nonblock);
+    c = (Conn *)calloc(1, sizeof(Conn));
+    c->sock = s;
+    c->in = (char *)malloc(SERVE_CONN_BUF);
+    c->incap = SERVE_CONN_BUF;
+    sv->conns[sv->nconns++] = c;
+}
+
+/* Parse "CCZE1 mode=..." once it has arrived. Returns 0 on a bad header. */
+static int conn_header(Conn *c) {
+    const char *nl = (const char *)memchr(c->in, '\n', c->inlen);
+    const char *mode;
+    size_t n;
+    int m = 0;
+
+    if (!nl) return c->inlen < SERVE_HDR_MAX;
+    n = (size_t)(nl - c->in) + 1;
+    mode = c->in + strlen(SERVE_PROTO " mode=");
+    if (strncmp(c->in, SERVE_PROTO " mode=", strlen(SERVE_PROTO " mode=")) != 0) return 0;
+    if (strncmp(mode, "ansi", 4) == 0)      m = 'a';
+    else if (strncmp(mode, "html", 4) == 0) m = 'h';
+    else if (strncmp(mode, "none", 4) == 0) m = 'n';
+    else return 0;
+    color_init_buffer(&c->co, m);
+    c->have_header = 1;
+    memmove(c->in, c->in + n, c->inlen - n);
+    c->inlen -= n;
+    return 1;
+}
+
+/* Returns 0 if the connection should be dropped */
+static int conn_read(Server *sv, Conn *c) {
+    size_t from = c->inlen;   /* where a new line end can be */
+    int n;
+
+    /* A full buffer holds part of one line (the batch took the rest):
+     * make room for the whole of it */
+    if (c->have_header && c->inlen == c->incap && c->incap < SERVE_LINE_MAX) {
+        size_t cap = c->incap * 2 < SERVE_LINE_MAX ? c->incap * 2 : SERVE_LINE_MAX;
+        char *in = (char *)realloc(c->in, cap);
+        if (in) {
+            c->in = in;
+            c->incap = cap;
+        }
+    }
+    if (c->inlen == c->incap) {
+        /* Still full: the line goes out in pieces */
+        c->busy = 1;
+        pool_submit(sv->pool, c);
+        return 1;
+    }
+    n = recv(c->sock, c->in + c->inlen, (int)(c->incap - c->inlen), 0);
+    if (n == 0) {
+        c->eof = 1;
+    } else if (n < 0) {
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+    } else {
+        c->inlen += (size_t)n;
+    }
+    if (!c->have_header) {
+        if (!conn_header(c)) {
+            static const char msg[] = "ccze: bad request\n";
+            send(c->sock, msg, (int)sizeof(msg) - 1, 0);
+            return 0;
+        }
+        if (!c->have_header) return !c->eof;
+        from = 0;
+    }
+    /* A buffer filled without a line end grows on the next read */
+    if ((c->eof && c->inlen) || memchr(c->in + from, '\n', c->inlen - from)) {
+        c->busy = 1;
+        pool_submit(sv->pool, c);
+    }
+    return 1;
+}
+
+static int conn_write(Conn *c) {
+    int n = send(c->sock, c->co.buf + c->outpos, (int)(c->co.len - c->outpos), 0);
+    if (n < 0) return WSAGetLastError() == WSAEWOULDBLOCK;
+    c->outpos += (size_t)n;
+    if (c->outpos == c->co.len) c->outpos = c->co.len = 0;
+    return 1;
+}
+
+int serve_run(const char *path, const Ccze *h, int nthreads) {
+    Server sv;
+    struct sockaddr_un addr;
+    SOCKET listener;
+    int i;
+
+    if (!net_init()) return 1;
+    if (!make_addr(&addr, path)) return 1;
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        fprintf(stderr, "ccze: error: AF_UNIX sockets are not available\n");
+        return 1;
+    }
+    DeleteFileA(path);   /* a stale socket file from an earlier run */
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "ccze: error: cannot listen on %s\n", path);
+        closesocket(listener);
+        return 1;
+    }
+
+    memset(&sv, 0, sizeof(sv));
+    sv.h = h;
+    sv.pool = pool_create(nthreads, serve_batch, &sv);
+    if (!sv.pool) {
+        fprintf(stderr, "ccze: error: cannot start worker threads\n");
+        closesocket(listener);
+        return 1;
+    }
+    fprintf(stderr, "ccze: serving %d rules on %s with %d threads\n",
+            ccze_rule_count(h), path, pool_threads(sv.pool));
+
+    for (;;) {
+        fd_set rd, wr;
+        struct timeval tv;
+        SOCKET maxs = listener;
+        int busy = 0;
+
+        FD_ZERO(&rd);
+        FD_ZERO(&wr);
+        FD_SET(listener, &rd);
+        for (i = 0; i < sv.nconns; i++) {
+            Conn *c = sv.conns[i];
+            if (c->busy) {
+                busy = 1;
+                continue;
+            }
+            /* Nothing more is read until the last batch has gone out */
+            if (c->outpos < c->co.len) {
+                FD_SET(c->sock, &wr);
+            } else if (c->eof && c->inlen == 0) {
+                conn_close(&sv, i--);
+                continue;
+            } else if (!c->eof) {
+                FD_SET(c->sock, &rd);
+            }
+            if (c->sock > maxs) maxs = c->sock;
+        }
+
+        /* Workers can't wake select(), so poll while any are running */
+        tv.tv_sec = 0;
+        tv.tv_usec = SERVE_POLL_MS * 1000;
+        if (select((int)maxs + 1, &rd, &wr, NULL, busy ? &tv : NULL) < 0) {
+            fprintf(stderr, "ccze: error: select failed (%d)\n", WSAGetLastError());
+            break;
+        }
+
+        for (i = 0; i < sv.nconns; i++) {
+            Conn *c = sv.conns[i];
+            int ok = 1;
+            if (c->busy) continue;
+            if (FD_ISSET(c->sock, &wr)) ok = conn_write(c);
+            else if (FD_ISSET(c->sock, &rd)) ok = conn_read(&sv, c);
+            if (!ok) conn_close(&sv, i--);
+        }
+        if (FD_ISSET(listener, &rd)) conn_accept(&sv, listener);
+    }
+
+    pool_finish(sv.pool);
+    while (sv.nconns > 0) conn_close(&sv, sv.nconns - 1);
+    closesocket(listener);
+    WSACleanup();
+    return 1;
+}
+
+/* ----------------------------------------------------------------
+ * Client
+ * ---------------------------------------------------------------- */
+typedef struct {
+    SOCKET sock;
+    Input  in;
+} ClientFeed;
+
+/* Copy the input to the server, as UTF-8; send() blocking is the
+ * backpressure */
+static DWORD WINAPI client_feed(void *arg) {
+    ClientFeed *cf = (ClientFeed *)arg;
+    char buf[SERVE_CONN_BUF];
+    int n;
+
+    while ((n = (int)input_read(&cf->in, buf, sizeof(buf))) > 0) {
+        int off = 0;
+        while (off < n) {
+            int w = send(cf->sock, buf + off, n - off, 0);
+            if (w <= 0) return 1;
+            off += w;
+        }
+    }
+    shutdown(cf->sock, SD_SEND);
+    return 0;
+}
+
+int client_run(const char *path, ColorOut *out, FILE *in, const char *cssfile) {
+    struct sockaddr_un addr;
+    ClientFeed cf;
+    HANDLE thread;
+    char buf[SERVE_CONN_BUF], hdr[SERVE_HDR_MAX];
+    const char *mode;
+    int n;
+
+    if (!net_init()) return 1;
+    if (!make_addr(&addr, path)) return 1;
+    cf.sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (cf.sock == INVALID_SOCKET ||
+        connect(cf.sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "ccze: error: cannot connect to %s\n", path);
+        if (cf.sock != INVALID_SOCKET) closesocket(cf.sock);
+        WSACleanup();
+        return 1;
+    }
+
+    /* The console attribute API can't travel over a socket */
+    switch (color_mode(out)) {
+    case COLOR_MODE_ANSI: mode = "ansi"; break;
+    case COLOR_MODE_HTML: mode = "html"; break;
+    default:              mode = "none"; break;
+    }
+    n = snprintf(hdr, sizeof(hdr), SERVE_PROTO " mode=%s\n", mode);
+    send(cf.sock, hdr, n, 0);
+
+    input_open(&cf.in, in);
+    thread = CreateThread(NULL, 0, client_feed, &cf, 0, NULL);
+    if (!thread) {
+        fprintf(stderr, "ccze: error: cannot start input thread\n");
+        input_close(&cf.in);
+        closesocket(cf.sock);
+        WSACleanup();
+        return 1;
+    }
+
+    if (color_mode(out) == COLOR_MODE_HTML) color_html_header(out, cssfile);
+    while ((n = recv(cf.sock, buf, sizeof(buf), 0)) > 0) {
+        fwrite(buf, 1, (size_t)n, stdout);
+        fflush(stdout);
+    }
+    if (color_mode(out) == COLOR_MODE_HTML) color_html_footer(out);
+    fflush(stdout);
+
+    /* The feeder may be blocked reading a terminal; don't wait for it */
+    CloseHandle(thread);
+    closesocket(cf.sock);
+    WSACleanup();
+    return n < 0 ? 1 : 0;
+}
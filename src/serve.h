@@ -0,0 +1,36 @@
+#ifndef CCZE_SERVE_H
+#define CCZE_SERVE_H
+
+#include <stdio.h>
+#include "color.h"
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Colorizer daemon (--serve) and its client (--client)
+ *
+ * The server compiles the rule set once and colorizes any number of
+ * streams over a Unix domain socket. A client sends one header line,
+ *   CCZE1 mode=ansi|html|none
+ * then its raw log data, and shuts down its sending side at the end;
+ * the server streams the colored text back and closes the connection.
+ * HTML headers and footers are the client's job.
+ *
+ * Each connection holds at most SERVE_CONN_BUF bytes of input, and the
+ * server reads no more from it until the output of the last batch has
+ * been sent, so a slow reader throttles its own writer and nobody else.
+ * A single line longer than that grows the buffer, up to SERVE_LINE_MAX
+ * per connection; only a line longer still is cut into pieces that are
+ * colorized apart, so a match across a cut is lost.
+ * ---------------------------------------------------------------- */
+#define SERVE_PROTO    "CCZE1"
+#define SERVE_CONN_BUF 65536
+#define SERVE_LINE_MAX (16 * 1024 * 1024)
+
+/* Serve h on a socket at path until killed. Returns the exit status. */
+int serve_run(const char *path, const Ccze *h, int nthreads);
+
+/* Send in to the server at path and write the result to out. Returns
+ * the exit status. */
+int client_run(const char *path, ColorOut *out, FILE *in, const char *cssfile);
+
+#endif /* CCZE_SERVE_H */
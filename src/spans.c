@@ -0,0 +1,65 @@
+#include "spans.h"
+#include <stdlib.h>
+#include <string.h>
+#include <io.h>
+#include <fcntl.h>
+
+static void put_le(FILE *fp, unsigned long long v, int nbytes) {
+    unsigned char b[8];
+    int i;
+    for (i = 0; i < nbytes; i++) b[i] = (unsigned char)(v >> (8 * i));
+    fwrite(b, 1, nbytes, fp);
+}
+
+void spans_init(SpanWriter *sw, SpanFormat fmt, FILE *fp) {
+    sw->fmt = fmt;
+    sw->fp = fp;
+    sw->n = 0;
+    sw->cap = 64;
+    sw->v = (CczeSpan *)malloc(sw->cap * sizeof(CczeSpan));
+    if (fmt == SPANS_BIN) {
+        _setmode(_fileno(fp), _O_BINARY);
+        fwrite("CCZS\x01\0\0\0", 1, 8, fp);
+    }
+}
+
+void spans_free(SpanWriter *sw) { free(sw->v); }
+
+void spans_collect(const char *buf, const CczeSpan *span, void *ud) {
+    SpanWriter *sw = (SpanWriter *)ud;
+    (void)buf;
+    if (span->kind == CCZE_SPAN_PLAIN) return;
+    if (sw->n == sw->cap) {
+        sw->cap *= 2;
+        sw->v = (CczeSpan *)realloc(sw->v, sw->cap * sizeof(CczeSpan));
+    }
+    sw->v[sw->n++] = *span;
+}
+
+void spans_write_line(SpanWriter *sw, unsigned long long offset, size_t len) {
+    int i;
+
+    if (sw->fmt == SPANS_BIN) {
+        put_le(sw->fp, offset, 8);
+        put_le(sw->fp, len, 4);
+        put_le(sw->fp, (unsigned)sw->n, 4);
+        for (i = 0; i < sw->n; i++) {
+            const CczeSpan *sp = &sw->v[i];
+            put_le(sw->fp, sp->offset, 4);
+            put_le(sw->fp, sp->length, 4);
+            put_le(sw->fp, (unsigned)sp->color, 1);
+            put_le(sw->fp, (unsigned)sp->kind, 1);
+            put_le(sw->fp, (unsigned)sp->rule_id, 2);
+        }
+    } else {
+        fprintf(sw->fp, "{\"off\":%llu,\"len\":%u,\"spans\":[", offset, (unsigned)len);
+        for (i = 0; i < sw->n; i++) {
+            const CczeSpan *sp = &sw->v[i];
+            fprintf(sw->fp, "%s[%u,%u,\"%s\",\"%s\",%d]", i ? "," : "",
+                    (unsigned)sp->offset, (unsigned)sp->length,
+                    color_name(sp->color), ccze_span_kind_name(sp->kind), sp->rule_id);
+        }
+        fputs("]}\n", sw->fp);
+    }
+    sw->n = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef CCZE_SPANS_H
+#define CCZE_SPANS_H
+
+#include <stdio.h>
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Machine-readable span output (--spans)
+ *
+ * json: one object per line/record
+ *   {"off":OFFSET,"len":LEN,"spans":[[START,LEN,"COLOR","kind",RULE],...]}
+ *
+ * bin: "CCZS" 0x01 0x00 0x00 0x00, then per line/record (little-endian)
+ *   u64 offset, u32 length, u32 nspans,
+ *   nspans x { u32 start, u32 length, u8 color, u8 kind, u16 rule }
+ *
+ * OFFSET is the byte offset of the line in the input file; LEN and
+ * START are measured on the line with "\r\n" folded to "\n". For UTF-16
+ * input OFFSET still counts raw file bytes, while LEN and START count
+ * bytes of the line transcoded to UTF-8. Plain (uncolored) spans are
+ * omitted. RULE matches the numbering printed by -l, or 0 for built-in
+ * coloring.
+ * ---------------------------------------------------------------- */
+typedef enum { SPANS_JSON, SPANS_BIN } SpanFormat;
+
+typedef struct {
+    SpanFormat fmt;
+    FILE      *fp;
+    CczeSpan  *v;
+    int        n;
+    int        cap;
+} SpanWriter;
+
+void spans_init(SpanWriter *sw, SpanFormat fmt, FILE *fp);
+void spans_free(SpanWriter *sw);
+
+/* CczeSpanFn: collect one span of the current line */
+void spans_collect(const char *buf, const CczeSpan *span, void *ud);
+
+/* Write the collected spans for the line at offset and reset */
+void spans_write_line(SpanWriter *sw, unsigned long long offset, size_t len);
+
+#endif /* CCZE_SPANS_H */
@@ -0,0 +1,312 @@
+#include "stats.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STATS_CHUNK 1048576   /* bytes of input per worker task */
+#define STATS_TOP   10        /* entries shown per string table */
+
+/* ----------------------------------------------------------------
+ * String tables
+ * ---------------------------------------------------------------- */
+static size_t table_hash(const char *s, size_t n) {
+    size_t h = 2166136261u, i;
+    for (i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static void table_add(StatTable *t, const char *key, size_t klen, unsigned long long count);
+
+static void table_grow(StatTable *t) {
+    StatTable old = *t;
+    size_t i;
+    t->cap = old.cap ? old.cap * 2 : 64;
+    t->v = (StatEntry *)calloc(t->cap, sizeof(StatEntry));
+    t->n = 0;
+    for (i = 0; i < old.cap; i++) {
+        if (!old.v[i].key) continue;
+        table_add(t, old.v[i].key, old.v[i].klen, old.v[i].count);
+        free(old.v[i].key);
+    }
+    free(old.v);
+}
+
+static void table_add(StatTable *t, const char *key, size_t klen, unsigned long long count) {
+    size_t i;
+    if ((t->n + 1) * 10 > t->cap * 7) table_grow(t);
+    i = table_hash(key, klen) & (t->cap - 1);
+    while (t->v[i].key) {
+        if (t->v[i].klen == klen && memcmp(t->v[i].key, key, klen) == 0) {
+            t->v[i].count += count;
+            return;
+        }
+        i = (i + 1) & (t->cap - 1);
+    }
+    t->v[i].key = (char *)malloc(klen + 1);
+    memcpy(t->v[i].key, key, klen);
+    t->v[i].key[klen] = '\0';
+    t->v[i].klen = klen;
+    t->v[i].count = count;
+    t->n++;
+}
+
+static void table_free(StatTable *t) {
+    size_t i;
+    for (i = 0; i < t->cap; i++) free(t->v[i].key);
+    free(t->v);
+}
+
+static int entry_cmp(const void *a, const void *b) {
+    const StatEntry *x = *(const StatEntry *const *)a, *y = *(const StatEntry *const *)b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->key, y->key);
+}
+
+/* Most frequent entries first; returns how many were stored in top */
+static int table_top(const StatTable *t, const StatEntry **top, int max) {
+    const StatEntry **all;
+    size_t i, n = 0;
+    int k;
+    if (!t->n) return 0;
+    all = (const StatEntry **)malloc(t->n * sizeof(*all));
+    for (i = 0; i < t->cap; i++)
+        if (t->v[i].key) all[n++] = &t->v[i];
+    qsort(all, n, sizeof(*all), entry_cmp);
+    for (k = 0; k < max && (size_t)k < n; k++) top[k] = all[k];
+    free(all);
+    return k;
+}
+
+/* ----------------------------------------------------------------
+ * Counting
+ * ---------------------------------------------------------------- */
+void stats_init(Stats *st, int nrules) {
+    memset(st, 0, sizeof(*st));
+    st->nrules = nrules;
+    st->rule_hits = (unsigned long long *)calloc(nrules ? nrules : 1, sizeof(unsigned long long));
+}
+
+void stats_free(Stats *st) {
+    free(st->rule_hits);
+    table_free(&st->hosts);
+    table_free(&st->procs);
+    table_free(&st->words);
+}
+
+static void stats_span(const char *buf, const CczeSpan *sp, void *ud) {
+    Stats *st = (Stats *)ud;
+    const char *text = buf + sp->offset;
+
+    st->kinds[sp->kind]++;
+    switch (sp->kind) {
+    case CCZE_SPAN_RULE:
+    case CCZE_SPAN_TOOL:
+        if (sp->rule_id >= 1 && sp->rule_id <= st->nrules) st->rule_hits[sp->rule_id - 1]++;
+        break;
+    case CCZE_SPAN_HOST:
+        table_add(&st->hosts, text, sp->length, 1);
+        break;
+    case CCZE_SPAN_PROC:
+        table_add(&st->procs, text, sp->length, 1);
+        break;
+    case CCZE_SPAN_WORD:
+        table_add(&st->words, text, sp->length, 1);
+        break;
+    default:
+        break;
+    }
+}
+
+void stats_line(Stats *st, const Ccze *h, const char *buf, size_t len) {
+    if (!ccze_filter(h, buf, len)) return;
+    st->lines++;
+    st->bytes += len;
+    st->levels[ccze_line_level(buf, len)]++;
+    ccze_colorize(h, buf, len, stats_span, st);
+}
+
+void stats_merge(Stats *dst, const Stats *src) {
+    const StatTable *src_tabs[3];
+    StatTable *dst_tabs[3];
+    size_t i;
+    int k;
+
+    dst->lines += src->lines;
+    dst->bytes += src->bytes;
+    for (k = 0; k <= CCZE_LEVEL_CRIT; k++) dst->levels[k] += src->levels[k];
+    for (k = 0; k <= CCZE_SPAN_ANSI; k++) dst->kinds[k] += src->kinds[k];
+    for (k = 0; k < dst->nrules && k < src->nrules; k++) dst->rule_hits[k] += src->rule_hits[k];
+
+    src_tabs[0] = &src->hosts; src_tabs[1] = &src->procs; src_tabs[2] = &src->words;
+    dst_tabs[0] = &dst->hosts; dst_tabs[1] = &dst->procs; dst_tabs[2] = &dst->words;
+    for (k = 0; k < 3; k++)
+        for (i = 0; i < src_tabs[k]->cap; i++)
+            if (src_tabs[k]->v[i].key)
+                table_add(dst_tabs[k], src_tabs[k]->v[i].key, src_tabs[k]->v[i].klen,
+                          src_tabs[k]->v[i].count);
+}
+
+/* ----------------------------------------------------------------
+ * Output
+ * ---------------------------------------------------------------- */
+static void json_str(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+        else if (c < 0x20) fprintf(fp, "\\u%04x", c);
+        else fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static void print_table(FILE *fp, const char *title, const char *unit,
+                        const StatTable *t, int json) {
+    const StatEntry *top[STATS_TOP];
+    int n = table_top(t, top, STATS_TOP), k;
+
+    if (json) {
+        fprintf(fp, ",\"%s\":{", title);
+        for (k = 0; k < n; k++) {
+            if (k) fputc(',', fp);
+            json_str(fp, top[k]->key);
+            fprintf(fp, ":%llu", top[k]->count);
+        }
+        fputc('}', fp);
+        return;
+    }
+    fprintf(fp, "\n%-24s %12s\n", title, unit);
+    for (k = 0; k < n; k++)
+        fprintf(fp, "%-24.24s %12llu\n", top[k]->key, top[k]->count);
+    if (t->n > (size_t)n)
+        fprintf(fp, "(%llu more)\n", (unsigned long long)(t->n - n));
+}
+
+void stats_print(const Stats *st, FILE *fp, int json) {
+    int k;
+
+    if (json) {
+        fprintf(fp, "{\"lines\":%llu,\"bytes\":%llu,\"levels\":{", st->lines, st->bytes);
+        for (k = CCZE_LEVEL_CRIT; k >= CCZE_LEVEL_NONE; k--)
+            fprintf(fp, "%s\"%s\":%llu", k == CCZE_LEVEL_CRIT ? "" : ",",
+                    ccze_level_name((CczeLevel)k), st->levels[k]);
+        fputc('}', fp);
+    } else {
+        fprintf(fp, "%-24s %12llu\n%-24s %12llu\n\n%-24s %12s\n",
+                "lines", st->lines, "bytes", st->bytes, "level", "lines");
+        for (k = CCZE_LEVEL_CRIT; k >= CCZE_LEVEL_NONE; k--)
+            fprintf(fp, "%-24s %12llu\n", ccze_level_name((CczeLevel)k), st->levels[k]);
+    }
+
+    print_table(fp, "hosts", "lines", &st->hosts, json);
+    print_table(fp, "processes", "lines", &st->procs, json);
+    print_table(fp, "keywords", "hits", &st->words, json);
+
+    if (json) {
+        fputs(",\"rules\":{", fp);
+        for (k = 0; k < st->nrules; k++)
+            fprintf(fp, "%s\"%d\":%llu", k ? "," : "", k + 1, st->rule_hits[k]);
+        fputs("},\"kinds\":{", fp);
+        for (k = 0; k <= CCZE_SPAN_ANSI; k++)
+            fprintf(fp, "%s\"%s\":%llu", k ? "," : "", ccze_span_kind_name((CczeSpanKind)k), st->kinds[k]);
+        fputs("}}\n", fp);
+        return;
+    }
+    fprintf(fp, "\n%-24s %12s\n", "rule", "hits");
+    for (k = 0; k < st->nrules; k++)
+        if (st->rule_hits[k]) fprintf(fp, "%-24d %12llu\n", k + 1, st->rule_hits[k]);
+    fprintf(fp, "\n%-24s %12s\n", "span kind", "spans");
+    for (k = 0; k <= CCZE_SPAN_ANSI; k++)
+        if (st->kinds[k])
+            fprintf(fp, "%-24s %12llu\n", ccze_span_kind_name((CczeSpanKind)k), st->kinds[k]);
+}
+
+/* ----------------------------------------------------------------
+ * Threaded driver
+ *
+ * A chunk is a run of length-prefixed lines/records, so records with
+ * embedded newlines survive the trip to the worker intact.
+ * ---------------------------------------------------------------- */
+typedef struct {
+    char  *buf;
+    size_t len;
+    size_t cap;
+} StatsChunk;
+
+struct StatsRun {
+    const Ccze *h;
+    Pool       *pool;
+    Stats      *per;      /* one per worker */
+    int         nworkers;
+    StatsChunk *cur;
+};
+
+static void stats_chunk(void *task, int worker, void *ud) {
+    StatsRun *sr = (StatsRun *)ud;
+    StatsChunk *c = (StatsChunk *)task;
+    size_t off = 0;
+
+    while (off < c->len) {
+        unsigned n;
+        memcpy(&n, c->buf + off, sizeof(n));
+        off += sizeof(n);
+        stats_line(&sr->per[worker], sr->h, c->buf + off, n);
+        off += n;
+    }
+    free(c->buf);
+    free(c);
+}
+
+StatsRun *stats_start(const Ccze *h, int nthreads) {
+    StatsRun *sr = (StatsRun *)calloc(1, sizeof(StatsRun));
+    int k;
+
+    sr->h = h;
+    sr->pool = pool_create(nthreads, stats_chunk, sr);
+    /* No threads: count on the calling thread */
+    sr->nworkers = sr->pool ? pool_threads(sr->pool) : 1;
+    sr->per = (Stats *)malloc(sr->nworkers * sizeof(Stats));
+    for (k = 0; k < sr->nworkers; k++) stats_init(&sr->per[k], ccze_rule_count(h));
+    return sr;
+}
+
+static void stats_submit(StatsRun *sr) {
+    StatsChunk *c = sr->cur;
+    sr->cur = NULL;
+    if (!c) return;
+    if (sr->pool)
+        pool_submit(sr->pool, c);
+    else
+        stats_chunk(c, 0, sr);
+}
+
+void stats_feed(StatsRun *sr, const char *buf, size_t len) {
+    unsigned n = (unsigned)len;
+    if (!sr->cur) {
+        sr->cur = (StatsChunk *)malloc(sizeof(StatsChunk));
+        sr->cur->cap = STATS_CHUNK + 4096;
+        sr->cur->buf = (char *)malloc(sr->cur->cap);
+        sr->cur->len = 0;
+    }
+    if (sr->cur->len + sizeof(n) + len > sr->cur->cap) {
+        sr->cur->cap = sr->cur->len + sizeof(n) + len;
+        sr->cur->buf = (char *)realloc(sr->cur->buf, sr->cur->cap);
+    }
+    memcpy(sr->cur->buf + sr->cur->len, &n, sizeof(n));
+    memcpy(sr->cur->buf + sr->cur->len + sizeof(n), buf, len);
+    sr->cur->len += sizeof(n) + len;
+    if (sr->cur->len >= STATS_CHUNK) stats_submit(sr);
+}
+
+void stats_end(StatsRun *sr, Stats *total) {
+    int k;
+    stats_submit(sr);
+    if (sr->pool) pool_finish(sr->pool);
+    stats_init(total, ccze_rule_count(sr->h));
+    for (k = 0; k < sr->nworkers; k++) {
+        stats_merge(total, &sr->per[k]);
+        stats_free(&sr->per[k]);
+    }
+    free(sr->per);
+    free(sr);
+}
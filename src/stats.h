@@ -0,0 +1,61 @@
+#ifndef CCZE_STATS_H
+#define CCZE_STATS_H
+
+#include <stdio.h>
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Summary statistics (--stats)
+ *
+ * Lines are classified by the engine exactly as for colorizing, but the
+ * spans are counted instead of drawn: levels, syslog hosts and process
+ * names, wordcolor keywords, span kinds and per-rule hits. Input is cut
+ * into chunks that worker threads count into private Stats, merged at
+ * the end, so nothing is shared on the hot path.
+ * ---------------------------------------------------------------- */
+
+/* Counted strings (hosts, processes, keywords) */
+typedef struct {
+    char              *key;
+    size_t             klen;
+    unsigned long long count;
+} StatEntry;
+
+typedef struct {
+    StatEntry *v;       /* open addressing, key == NULL when free */
+    size_t     cap;
+    size_t     n;
+} StatTable;
+
+typedef struct {
+    unsigned long long lines;
+    unsigned long long bytes;
+    unsigned long long levels[CCZE_LEVEL_CRIT + 1];
+    unsigned long long kinds[CCZE_SPAN_ANSI + 1];
+    unsigned long long *rule_hits;  /* [nrules] */
+    int                nrules;
+    StatTable          hosts;
+    StatTable          procs;
+    StatTable          words;
+} Stats;
+
+void stats_init(Stats *st, int nrules);
+void stats_free(Stats *st);
+
+/* Count one line or record (if it passes ccze_filter()) */
+void stats_line(Stats *st, const Ccze *h, const char *buf, size_t len);
+
+/* Add src's counters into dst */
+void stats_merge(Stats *dst, const Stats *src);
+
+/* Print the summary as an aligned table, or as one JSON object */
+void stats_print(const Stats *st, FILE *fp, int json);
+
+/* Threaded driver: feed lines/records in order, then collect the total */
+typedef struct StatsRun StatsRun;
+
+StatsRun *stats_start(const Ccze *h, int nthreads);
+void      stats_feed(StatsRun *sr, const char *buf, size_t len);
+void      stats_end(StatsRun *sr, Stats *total);
+
+#endif /* CCZE_STATS_H */
@@ -0,0 +1,147 @@
+#include "tail.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TAIL_SSE2
+#endif
+
+/* Copy a line into lb, folding "\r\n" to "\n" as Input does */
+static void tail_copy(LineBuf *lb, const char *p, size_t len) {
+    lb->len = 0;
+    linebuf_append(lb, p, len);
+    if (lb->len >= 2 && lb->buf[lb->len - 2] == '\r' && lb->buf[lb->len - 1] == '\n') {
+        lb->buf[lb->len - 2] = '\n';
+        lb->buf[--lb->len] = '\0';
+    }
+}
+
+/* Newest first, the unterminated last line of a file is no longer last */
+static void tail_terminate(LineBuf *lb) {
+    if (lb->len == 0 || lb->buf[lb->len - 1] != '\n') linebuf_append(lb, "\n", 1);
+}
+
+/* Last '\n' in [base, end), or NULL */
+static const char *find_nl_back(const char *base, const char *end) {
+    const char *p = end;
+#ifdef TAIL_SSE2
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (p - base >= 16 &&
+           !_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p - 16)), nl)))
+        p -= 16;
+#endif
+    while (p > base)
+        if (*--p == '\n') return p;
+    return NULL;
+}
+
+/* ----------------------------------------------------------------
+ * Mapped files
+ * ---------------------------------------------------------------- */
+int tail_file(const Ccze *h, const char *path, unsigned long long n, int reverse,
+              TailFn fn, void *ud) {
+    FileMap fm;
+    LineBuf lb;
+    const char *start, *end, *e, *first;
+    unsigned long long kept = 0;
+    size_t bom;
+
+    if (!filemap_open(&fm, path)) {
+        fprintf(stderr, "ccze: error: cannot map file: %s\n", path);
+        return -1;
+    }
+    if (fm.size == 0) {
+        filemap_close(&fm);
+        return 1;
+    }
+    if (input_sniff(fm.base, fm.size, &bom) != ENC_UTF8) {
+        filemap_close(&fm);
+        return 0;
+    }
+
+    linebuf_init(&lb);
+    start = fm.base + bom;
+    end = fm.base + fm.size;
+    first = start;
+    /* Walk back one line at a time; [s, e) is the line, '\n' included */
+    for (e = end; e > start; ) {
+        const char *nl = find_nl_back(start, e - 1);
+        const char *s = nl ? nl + 1 : start;
+        tail_copy(&lb, s, (size_t)(e - s));
+        if (ccze_filter(h, lb.buf, lb.len)) {
+            kept++;
+            if (reverse) {
+                tail_terminate(&lb);
+                fn(lb.buf, lb.len, (unsigned long long)(s - fm.base), ud);
+            }
+        }
+        if (n && kept == n) {
+            first = s;
+            break;
+        }
+        e = s;
+    }
+
+    if (!reverse) {
+        const char *p = first;
+        while (p < end) {
+            const char *nl = (const char *)memchr(p, '\n', (size_t)(end - p));
+            const char *le = nl ? nl + 1 : end;
+            tail_copy(&lb, p, (size_t)(le - p));
+            fn(lb.buf, lb.len, (unsigned long long)(p - fm.base), ud);
+            p = le;
+        }
+    }
+    linebuf_free(&lb);
+    filemap_close(&fm);
+    return 1;
+}
+
+/* ----------------------------------------------------------------
+ * Streams
+ * ---------------------------------------------------------------- */
+typedef struct {
+    char              *text;
+    size_t             len;
+    unsigned long long off;
+} TailLine;
+
+void tail_input(const Ccze *h, Input *in, unsigned long long n, int reverse,
+                TailFn fn, void *ud) {
+    TailLine *v = NULL;
+    size_t cap = 0, count = 0, head = 0, i;
+    LineBuf lb;
+
+    /* With n, v is a ring of the last n kept lines; head is the oldest */
+    linebuf_init(&lb);
+    while (input_readline(in, &lb)) {
+        TailLine *t;
+        if (!ccze_filter(h, lb.buf, lb.len)) continue;
+        if (reverse) tail_terminate(&lb);
+        if (n && count == n) {
+            t = &v[head];
+            head = (head + 1) % count;
+            free(t->text);
+        } else {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 1024;
+                if (n && cap > n) cap = (size_t)n;
+                v = (TailLine *)realloc(v, cap * sizeof(TailLine));
+            }
+            t = &v[count++];
+        }
+        t->text = (char *)malloc(lb.len);
+        memcpy(t->text, lb.buf, lb.len);
+        t->len = lb.len;
+        t->off = in->line_off;
+    }
+    linebuf_free(&lb);
+
+    for (i = 0; i < count; i++) {
+        TailLine *t = &v[(head + (reverse ? count - 1 - i : i)) % count];
+        fn(t->text, t->len, t->off, ud);
+    }
+    for (i = 0; i < count; i++) free(v[i].text);
+    free(v);
+}
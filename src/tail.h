@@ -0,0 +1,32 @@
+#ifndef CCZE_TAIL_H
+#define CCZE_TAIL_H
+
+#include "input.h"
+#include "libccze.h"
+
+/* ----------------------------------------------------------------
+ * Reading from the end (--tail, --reverse)
+ *
+ * A regular UTF-8 file is mapped and scanned backwards from the end,
+ * counting only lines that pass the engine's filters (--grep,
+ * --min-level), so the cost follows the output rather than the file
+ * size. Pipes and UTF-16 input have to be read through, keeping just the
+ * lines that will be shown.
+ * ---------------------------------------------------------------- */
+
+/* Receives each line (with its '\n', CRLF folded) and its file offset */
+typedef void (*TailFn)(const char *line, size_t len, unsigned long long offset, void *ud);
+
+/* Pass the last n lines (0 = all) of path that pass the filters to fn,
+ * oldest first, or newest first if reverse. fn may also be handed lines
+ * in between that fail the filters and should drop them, as a normal
+ * read would. Returns 1 when done, 0 if the file can't be read
+ * backwards (use tail_input), -1 on error. */
+int tail_file(const Ccze *h, const char *path, unsigned long long n, int reverse,
+              TailFn fn, void *ud);
+
+/* The same for input that can't be mapped */
+void tail_input(const Ccze *h, Input *in, unsigned long long n, int reverse,
+                TailFn fn, void *ud);
+
+#endif /* CCZE_TAIL_H */
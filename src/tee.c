@@ -0,0 +1,121 @@
+#include "tee.h"
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Tee {
+    ColorOut           out;       /* drawn into out.buf */
+    FILE              *fp;
+    char              *path;
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE queued;    /* bytes waiting, or closing */
+    CONDITION_VARIABLE drained;   /* the writer took the queue */
+    char              *queue;
+    size_t             qlen, qcap;
+    int                closing;
+    int                failed;    /* a write failed; the rest is dropped */
+    HANDLE             thread;    /* NULL: tee_commit() writes itself */
+};
+
+static void tee_write(Tee *t, const char *buf, size_t len) {
+    if (!t->failed && fwrite(buf, 1, len, t->fp) != len) t->failed = 1;
+}
+
+static DWORD WINAPI tee_thread(void *arg) {
+    Tee *t = (Tee *)arg;
+    char *buf = NULL, *swap;
+    size_t cap = 0, len;
+
+    EnterCriticalSection(&t->lock);
+    for (;;) {
+        while (!t->qlen && !t->closing) SleepConditionVariableCS(&t->queued, &t->lock, INFINITE);
+        if (!t->qlen) break;
+        /* Take the queue whole and leave the empty buffer in its place */
+        swap = t->queue;
+        t->queue = buf;
+        buf = swap;
+        len = t->qcap;
+        t->qcap = cap;
+        cap = len;
+        len = t->qlen;
+        t->qlen = 0;
+        WakeConditionVariable(&t->drained);
+        LeaveCriticalSection(&t->lock);
+        tee_write(t, buf, len);
+        /* Someone may be following the file */
+        if (!t->failed && fflush(t->fp) != 0) t->failed = 1;
+        EnterCriticalSection(&t->lock);
+    }
+    LeaveCriticalSection(&t->lock);
+    free(buf);
+    return 0;
+}
+
+Tee *tee_open(const char *path, int mode, const char *cssfile) {
+    FILE *fp = fopen(path, "w");
+    Tee *t;
+
+    if (!fp) {
+        fprintf(stderr, "ccze: warning: cannot create %s\n", path);
+        return NULL;
+    }
+    t = (Tee *)calloc(1, sizeof(Tee));
+    t->fp = fp;
+    t->path = _strdup(path);
+    color_init_buffer(&t->out, mode);
+    if (mode == 'h') color_html_header(&t->out, cssfile);
+    InitializeCriticalSection(&t->lock);
+    InitializeConditionVariable(&t->queued);
+    InitializeConditionVariable(&t->drained);
+    t->thread = CreateThread(NULL, 0, tee_thread, t, 0, NULL);
+    return t;
+}
+
+ColorOut *tee_out(Tee *t) { return &t->out; }
+
+void tee_commit(Tee *t, int force) {
+    ColorOut *co = &t->out;
+
+    if (!co->len || (!force && co->len < TEE_BLOCK)) return;
+    if (!t->thread) {
+        tee_write(t, co->buf, co->len);
+        co->len = 0;
+        return;
+    }
+    EnterCriticalSection(&t->lock);
+    while (t->qlen >= TEE_BACKLOG) SleepConditionVariableCS(&t->drained, &t->lock, INFINITE);
+    if (t->qlen + co->len > t->qcap) {
+        t->qcap = t->qcap ? t->qcap : TEE_BLOCK * 2;
+        while (t->qlen + co->len > t->qcap) t->qcap *= 2;
+        t->queue = (char *)realloc(t->queue, t->qcap);
+    }
+    memcpy(t->queue + t->qlen, co->buf, co->len);
+    t->qlen += co->len;
+    WakeConditionVariable(&t->queued);
+    LeaveCriticalSection(&t->lock);
+    co->len = 0;
+}
+
+int tee_close(Tee *t) {
+    int ok;
+
+    if (color_mode(&t->out) == COLOR_MODE_HTML) color_html_footer(&t->out);
+    tee_commit(t, 1);
+    if (t->thread) {
+        EnterCriticalSection(&t->lock);
+        t->closing = 1;
+        WakeConditionVariable(&t->queued);
+        LeaveCriticalSection(&t->lock);
+        WaitForSingleObject(t->thread, INFINITE);
+        CloseHandle(t->thread);
+    }
+    if (fclose(t->fp) != 0) t->failed = 1;
+    ok = !t->failed;
+    if (!ok) fprintf(stderr, "ccze: error: writing %s failed\n", t->path);
+    DeleteCriticalSection(&t->lock);
+    color_free(&t->out);
+    free(t->queue);
+    free(t->path);
+    free(t);
+    return ok;
+}
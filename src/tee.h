@@ -0,0 +1,38 @@
+#ifndef CCZE_TEE_H
+#define CCZE_TEE_H
+
+#include <stdio.h>
+#include "color.h"
+
+/* ----------------------------------------------------------------
+ * Extra output files (--tee-html, --tee-text)
+ *
+ * The spans of each line are drawn onto every sink as well as onto
+ * stdout, so the rules run once however many copies are written. A
+ * sink renders into a buffer of its own; every TEE_BLOCK bytes (and
+ * whenever the input goes idle) the buffer is queued for a writer
+ * thread, so a slow disk doesn't hold up the terminal. Only when
+ * TEE_BACKLOG bytes are queued does rendering wait for the writer.
+ * ---------------------------------------------------------------- */
+#define TEE_MAX     4
+#define TEE_BLOCK   (64 * 1024)
+#define TEE_BACKLOG (64 * 1024 * 1024)
+
+typedef struct Tee Tee;
+
+/* Open path for writing in mode ('h' html, 'n' plain text) and start its
+ * writer. Returns NULL (after a warning) if the file can't be created. */
+Tee *tee_open(const char *path, int mode, const char *cssfile);
+
+/* The ColorOut to draw onto; call tee_commit() after drawing */
+ColorOut *tee_out(Tee *t);
+
+/* Queue what was drawn if it has reached TEE_BLOCK bytes, or at all
+ * when force is set */
+void tee_commit(Tee *t, int force);
+
+/* Write the rest, close the file and free t. Returns 0 if any write
+ * failed. */
+int tee_close(Tee *t);
+
+#endif /* CCZE_TEE_H */
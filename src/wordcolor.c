@@ -0,0 +1,231 @@
+#include <string.h>
+#include "engine.h"
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WORD_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+static unsigned first_bit(unsigned m) {
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (unsigned)i;
+}
+#else
+static unsigned first_bit(unsigned m) { return (unsigned)__builtin_ctz(m); }
+#endif
+#endif
+
+/* ----------------------------------------------------------------
+ * Word color (ccze-compatible)
+ *
+ * ccze uses prefix matching (strstr(word, prefix) == word).
+ * We do the same: if a word *starts with* a bad/good/error/system
+ * prefix, it gets that color. This handles "Failed", "Starting", etc.
+ * ---------------------------------------------------------------- */
+
+/* ccze error words - bold red */
+static const char *words_error[] = {
+    "error", "crit", "invalid", "fail", "false", "alarm", "fatal", NULL
+};
+/* ccze bad words - bold yellow */
+static const char *words_bad[] = {
+    "warn", "restart", "exit", "stop", "end", "shutting", "down", "close",
+    "unreach", "can't", "cannot", "skip", "deny", "disable", "ignored",
+    "miss", "oops", "not", "backdoor", "blocking", "ignoring",
+    "unable", "readonly", "offline", "terminate", "empty", "virus", NULL
+};
+/* ccze good words - bold green */
+static const char *words_good[] = {
+    "activ", "start", "ready", "online", "load", "ok", "register", "detected",
+    "configured", "enable", "listen", "open", "complete", "attempt", "done",
+    "check", "connect", "finish", "clean", "succeed", NULL
+};
+/* ccze system words - bold cyan */
+static const char *words_system[] = {
+    "ext2-fs", "reiserfs", "vfs", "iso", "isofs", "cslip", "ppp", "bsd",
+    "linux", "tcp/ip", "mtrr", "pci", "isa", "scsi", "ide", "atapi",
+    "bios", "cpu", "fpu", "discharging", "resume", NULL
+};
+
+/* Character classes. Token characters are what ccze treats as part of
+ * a word, path or URI: isalnum() plus / : - _ . */
+#define WC_TOKEN 1
+#define WC_DIGIT 2
+
+typedef struct {
+    const char *prefix;
+    int         len;
+    Color       color;
+} WordPrefix;
+
+#define WORD_MAX 128
+
+static unsigned char CLASS[256];
+static unsigned char LOWER[256];
+/* All prefixes bucketed by first letter; each bucket keeps the list
+ * order above, so the first hit is the one ccze would pick */
+static WordPrefix    PREFIXES[WORD_MAX];
+static int           BUCKET[27];       /* PREFIXES[BUCKET[l] .. BUCKET[l+1]) */
+static volatile long ready;
+
+void wordcolor_init(void) {
+    static const char **lists[4] = { words_error, words_bad, words_good, words_system };
+    static const Color colors[4] = { COL_BRIGHT_RED, COL_BRIGHT_YELLOW, COL_BRIGHT_GREEN, COL_BRIGHT_CYAN };
+    int count[26] = {0}, fill[26], c, k, i, n = 0;
+
+    if (ready) return;
+    for (c = 0; c < 256; c++) {
+        int alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        int digit = c >= '0' && c <= '9';
+        LOWER[c] = (unsigned char)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+        CLASS[c] = (unsigned char)((alpha || digit || c == '/' || c == ':' || c == '-' ||
+                                    c == '_' || c == '.' ? WC_TOKEN : 0) |
+                                   (digit ? WC_DIGIT : 0));
+    }
+    for (k = 0; k < 4; k++)
+        for (i = 0; lists[k][i]; i++) count[lists[k][i][0] - 'a']++;
+    for (c = 0; c < 26; c++) {
+        BUCKET[c] = fill[c] = n;
+        n += count[c];
+    }
+    BUCKET[26] = n;
+    for (k = 0; k < 4; k++)
+        for (i = 0; lists[k][i]; i++) {
+            WordPrefix *w = &PREFIXES[fill[lists[k][i][0] - 'a']++];
+            w->prefix = lists[k][i];
+            w->len = (int)strlen(lists[k][i]);
+            w->color = colors[k];
+        }
+    ready = 1;
+}
+
+static Color wordcolor_lookup(const char *word, size_t wlen) {
+    unsigned char first = LOWER[(unsigned char)word[0]];
+    int b, k;
+
+    if (first < 'a' || first > 'z') return COL_RESET;
+    for (b = BUCKET[first - 'a']; b < BUCKET[first - 'a' + 1]; b++) {
+        const WordPrefix *w = &PREFIXES[b];
+        if ((size_t)w->len > wlen) continue;
+        for (k = 1; k < w->len; k++)
+            if (LOWER[(unsigned char)word[k]] != (unsigned char)w->prefix[k]) break;
+        if (k == w->len) return w->color;
+    }
+    return COL_RESET;
+}
+
+/* Check if a token looks like a URI */
+static int is_uri(const char *word, size_t wlen) {
+    return wlen > 5 && (
+        (wlen > 7 && memcmp(word, "http://", 7) == 0) ||
+        (wlen > 8 && memcmp(word, "https://", 8) == 0) ||
+        (wlen > 6 && memcmp(word, "ftp://", 6) == 0));
+}
+
+/* ----------------------------------------------------------------
+ * Lexer
+ *
+ * One pass over the text: find where the next token starts, then where
+ * it ends while noting whether it is all digits. Bytes are classified
+ * with a 256-entry table; past 16 bytes, SSE2 classifies a block of 16
+ * at a time.
+ * ---------------------------------------------------------------- */
+#ifdef WORD_SSE2
+static __m128i in_range(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+}
+
+/* Token characters in v. "-./0123456789:" is one range; bytes >= 0x80
+ * are negative as signed chars and fall outside every range. */
+static unsigned token_mask(__m128i v) {
+    __m128i alpha = in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i punct = in_range(v, '-', ':');
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, punct), under));
+}
+#endif
+
+/* First token character at or after i, or len. Most gaps are a single
+ * space, so the table goes first and SSE2 only takes over long runs. */
+static size_t skip_space(const char *text, size_t i, size_t len) {
+    size_t stop = i + 16 < len ? i + 16 : len;
+    while (i < stop && !(CLASS[(unsigned char)text[i]] & WC_TOKEN)) i++;
+#ifdef WORD_SSE2
+    if (i < stop) return i;
+    while (i + 16 <= len) {
+        unsigned m = token_mask(_mm_loadu_si128((const __m128i *)(text + i)));
+        if (m) return i + first_bit(m);
+        i += 16;
+    }
+#endif
+    while (i < len && !(CLASS[(unsigned char)text[i]] & WC_TOKEN)) i++;
+    return i;
+}
+
+/* End of the token starting at i; *digits is cleared unless it's all
+ * digits. Same split as skip_space: words are short, hashes and base64
+ * blobs are not. */
+static size_t token_end(const char *text, size_t i, size_t len, int *digits) {
+    size_t stop = i + 16 < len ? i + 16 : len;
+    unsigned cls = WC_DIGIT, c;
+
+    while (i < stop && ((c = CLASS[(unsigned char)text[i]]) & WC_TOKEN)) {
+        cls &= c;
+        i++;
+    }
+#ifdef WORD_SSE2
+    if (i < stop) {
+        *digits = cls != 0;
+        return i;
+    }
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(text + i));
+        unsigned end = ~token_mask(v) & 0xFFFF;
+        unsigned dig = (unsigned)_mm_movemask_epi8(in_range(v, '0', '9'));
+        unsigned n = end ? first_bit(end) : 16;
+        if (~dig & ((1u << n) - 1)) cls = 0;
+        if (end) {
+            *digits = cls != 0;
+            return i + n;
+        }
+        i += 16;
+    }
+#endif
+    while (i < len && ((c = CLASS[(unsigned char)text[i]]) & WC_TOKEN)) {
+        cls &= c;
+        i++;
+    }
+    *digits = cls != 0;
+    return i;
+}
+
+int wordcolor_next(const char *text, size_t len, size_t from, WordToken *tok) {
+    size_t i = from;
+
+    while ((i = skip_space(text, i, len)) < len) {
+        size_t start = i, n;
+        int digits;
+
+        i = token_end(text, i, len, &digits);
+        n = i - start;
+        tok->start = start;
+        tok->end = i;
+        if (is_uri(text + start, n)) {
+            tok->kind = CCZE_SPAN_URI;
+            tok->color = COL_BRIGHT_GREEN;
+        } else if (n > 1 && text[start] == '/') {
+            tok->kind = CCZE_SPAN_PATH;
+            tok->color = COL_GREEN;
+        } else if (digits) {
+            tok->kind = CCZE_SPAN_NUMBER;
+            tok->color = COL_BRIGHT_WHITE;
+        } else if ((tok->color = wordcolor_lookup(text + start, n)) != COL_RESET) {
+            tok->kind = CCZE_SPAN_WORD;
+        } else {
+            continue;
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -60,6 +60,392 @@ if %errorlevel%==0 (
     set /a FAIL+=1
 )
 
+REM Test 6: record mode turns the stack trace into one record (5 records, not 18 lines)
+%CCZE% --spans json --record-start "[A-Z][a-z][a-z] [0-9]" "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+set RECORDS=0
+for /f %%n in ('find /c /v "" ^< "%TEMP%\ccze_actual.txt"') do set RECORDS=%%n
+if "%RECORDS%"=="5" (
+    echo [PASS] record mode groups continuation lines into one record
+    set /a PASS+=1
+) else (
+    echo [FAIL] record mode produced %RECORDS% records, expected 5
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 7: span output emits one JSON object per line
+%CCZE% --spans json "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"\"spans\":[" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] span output contains span lists
+    set /a PASS+=1
+) else (
+    echo [FAIL] span output missing span lists
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 8: --min-level drops INFO lines
+%CCZE% --no-color --min-level warn "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"INFO:" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==1 (
+    echo [PASS] --min-level warn drops INFO lines
+    set /a PASS+=1
+) else (
+    echo [FAIL] --min-level warn kept INFO lines
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 9: --lines shows only the requested lines
+%CCZE% --no-color --lines 4-4 "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"ConnectionPool" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /c:"HttpHandler" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [PASS] --lines selects a single line
+        set /a PASS+=1
+    ) else (
+        echo [FAIL] --lines output includes lines outside the range
+        set /a FAIL+=1
+    )
+) else (
+    echo [FAIL] --lines output missing the requested line
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 10: --stats prints a summary instead of colored text
+%CCZE% --stats-json "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"\"lines\":" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] --stats-json prints line counts
+    set /a PASS+=1
+) else (
+    echo [FAIL] --stats-json output missing line counts
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 11: UTF-16 input (as written by PowerShell Out-File) is transcoded
+powershell -NoProfile -Command "Get-Content '%~dp0java.log' | Out-File -Encoding unicode '%TEMP%\ccze_utf16.log'"
+%CCZE% -m none "%TEMP%\ccze_utf16.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"ConnectionPool" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] UTF-16 input is read as text
+    set /a PASS+=1
+) else (
+    echo [FAIL] UTF-16 input not transcoded
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_utf16.log" >nul 2>&1
+
+REM Test 12: --tail counts only the lines --grep keeps
+%CCZE% -m none --tail 1 --reverse --grep Exception "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"ConnectException" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /c:"SQLException" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [PASS] --tail selects the last matching line
+        set /a PASS+=1
+    ) else (
+        echo [FAIL] --tail output includes an earlier match
+        set /a FAIL+=1
+    )
+) else (
+    echo [FAIL] --tail output missing the last matching line
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 13: --metrics-file is written on exit
+del "%TEMP%\ccze_metrics.json" >nul 2>&1
+%CCZE% -m none --metrics-file "%TEMP%\ccze_metrics.json" --metrics-format json "%~dp0java.log" > nul 2>&1
+findstr /c:"lines_in" "%TEMP%\ccze_metrics.json" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] --metrics-file written
+    set /a PASS+=1
+) else (
+    echo [FAIL] --metrics-file missing or without counters
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_metrics.json" >nul 2>&1
+
+REM Test 14: --adaptive on piped input still shows every line
+type "%~dp0java.log" | %CCZE% -m none --adaptive > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"ConnectException" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] --adaptive passes piped input through
+    set /a PASS+=1
+) else (
+    echo [FAIL] --adaptive output missing lines
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 15: -o automaton still finds rule matches
+%CCZE% -o automaton --spans json "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"\"BRIGHT_BLACK\",\"rule\",24]" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] -o automaton keeps rule spans
+    set /a PASS+=1
+) else (
+    echo [FAIL] -o automaton lost rule spans
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 16: --line-threads leaves the spans of a line over 1 MB alone
+powershell -NoProfile -Command "$l = (Get-Content '%~dp0java.log') -join ' '; Set-Content -Encoding ascii '%TEMP%\ccze_big.log' (@(($l + ' ') * 2000) + (Get-Content '%~dp0java.log'))"
+%CCZE% --spans json "%TEMP%\ccze_big.log" > "%TEMP%\ccze_expected.txt" 2>&1
+%CCZE% --line-threads 2 --spans json "%TEMP%\ccze_big.log" > "%TEMP%\ccze_actual.txt" 2>&1
+fc /b "%TEMP%\ccze_expected.txt" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /c:"\"BRIGHT_BLACK\",\"rule\",24]" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [FAIL] --line-threads lost rule spans
+        set /a FAIL+=1
+    ) else (
+        echo [PASS] --line-threads keeps the spans of a long line
+        set /a PASS+=1
+    )
+) else (
+    echo [FAIL] --line-threads changed the spans of a long line
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_big.log" "%TEMP%\ccze_expected.txt" >nul 2>&1
+
+REM Test 17: --tee-html writes an HTML copy next to the terminal output
+del "%TEMP%\ccze_tee.html" >nul 2>&1
+%CCZE% -m none --tee-html "%TEMP%\ccze_tee.html" "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"<span style=" "%TEMP%\ccze_tee.html" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /c:"ConnectException" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [FAIL] --tee-html lost the terminal output
+        set /a FAIL+=1
+    ) else (
+        echo [PASS] --tee-html writes both outputs
+        set /a PASS+=1
+    )
+) else (
+    echo [FAIL] --tee-html file missing or uncolored
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_tee.html" >nul 2>&1
+
+REM Test 18: escape sequences in the input are taken out before --grep
+%CCZE% -m none --grep "ERROR failed" "%~dp0ansi.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"ERROR failed password" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] --ansi keep hides input escapes from --grep and plain output
+    set /a PASS+=1
+) else (
+    echo [FAIL] --ansi keep left input escapes in the line
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 19: -R/-O colorizes a directory into the same paths
+rmdir /s /q "%TEMP%\ccze_batch" >nul 2>&1
+%CCZE% -R "%~dp0." -O "%TEMP%\ccze_batch" -m html > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"<span style=" "%TEMP%\ccze_batch\java.log.html" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] -R writes colored copies under -O
+    set /a PASS+=1
+) else (
+    echo [FAIL] -R output missing or uncolored
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+rmdir /s /q "%TEMP%\ccze_batch" >nul 2>&1
+
+REM Test 20: --since through an index finds lines before a stride without timestamps
+(
+    for /l %%i in (1,1,512) do echo Feb 22 10:00:00 host app: early %%i
+    for /l %%i in (1,1,512) do echo Feb 22 11:30:00 host app: late %%i
+    for /l %%i in (1,1,1024) do echo continuation %%i
+    for /l %%i in (1,1,10) do echo Feb 22 12:05:00 host app: after %%i
+) > "%TEMP%\ccze_idx.log"
+%CCZE% --build-index "%TEMP%\ccze_idx.log" >nul 2>&1
+%CCZE% --no-color --since "Feb 22 11:00" "%TEMP%\ccze_idx.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"app: late 512" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /c:"app: early" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [PASS] --since with an index keeps lines before an untimed stride
+        set /a PASS+=1
+    ) else (
+        echo [FAIL] --since with an index shows lines before TIME
+        set /a FAIL+=1
+    )
+) else (
+    echo [FAIL] --since with an index dropped lines in range
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_idx.log" "%TEMP%\ccze_idx.log.cczi" >nul 2>&1
+
+REM Test 21: libccze spans tile each line exactly (no text lost or repeated)
+%CCZE% --no-color "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /x /c:"WARNING: Slow response 503" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /x /c:"ERROR: Connection failed to 192.168.1.100" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [FAIL] span output does not rebuild the IP address line
+        set /a FAIL+=1
+    ) else (
+        echo [PASS] spans rebuild whole lines exactly
+        set /a PASS+=1
+    )
+) else (
+    echo [FAIL] span output does not rebuild the WARNING line
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 22: --watch picks up a rule file changed while input is still coming
+echo color RED foo> "%TEMP%\ccze_watch.conf"
+powershell -NoProfile -Command "'foo bar'; Start-Sleep -Milliseconds 1500; Set-Content '%TEMP%\ccze_watch.conf' 'color GREEN bar'; Start-Sleep -Milliseconds 2500; 'foo bar'" | %CCZE% -A --watch -F "%TEMP%\ccze_watch.conf" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"[32mbar" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] --watch reloads the changed rule file
+    set /a PASS+=1
+) else (
+    echo [FAIL] --watch kept the old rules
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_watch.conf" >nul 2>&1
+
+REM Test 23: --check-rules flags a catastrophic pattern and exits with 1
+echo color RED (a*)*[b-z]> "%TEMP%\ccze_bad.conf"
+%CCZE% -F "%TEMP%\ccze_bad.conf" --check-rules > "%TEMP%\ccze_actual.txt" 2>&1
+if %errorlevel%==1 (
+    findstr /c:"LIMIT" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [FAIL] --check-rules failed without naming the limit
+        type "%TEMP%\ccze_actual.txt"
+        set /a FAIL+=1
+    ) else (
+        echo [PASS] --check-rules flags a backtracking rule
+        set /a PASS+=1
+    )
+) else (
+    echo [FAIL] --check-rules passed a backtracking rule
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_bad.conf" >nul 2>&1
+
+REM Test 24: a --client is colorized by a --serve daemon, and refuses engine options
+del "%TEMP%\ccze_test.sock" >nul 2>&1
+for /f %%p in ('powershell -NoProfile -Command "(Start-Process -PassThru -WindowStyle Hidden -FilePath '%CCZE%' -ArgumentList '--serve','%TEMP%\ccze_test.sock').Id"') do set SERVE_PID=%%p
+ping -n 3 127.0.0.1 >nul
+%CCZE% -m html --client "%TEMP%\ccze_test.sock" "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"<span style=" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    %CCZE% --grep ERROR --client "%TEMP%\ccze_test.sock" "%~dp0java.log" >nul 2>&1
+    if errorlevel 1 (
+        echo [PASS] --client output comes colorized from the daemon
+        set /a PASS+=1
+    ) else (
+        echo [FAIL] --client accepted --grep, which the daemon never sees
+        set /a FAIL+=1
+    )
+) else (
+    echo [FAIL] --client got no colorized output from the daemon
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+taskkill /f /pid %SERVE_PID% >nul 2>&1
+del "%TEMP%\ccze_test.sock" >nul 2>&1
+
+REM Test 25: without a ccze.conf the built-in rules are used
+mkdir "%TEMP%\ccze_builtin" >nul 2>&1
+copy /y "%~dp0..\ccze.exe" "%TEMP%\ccze_builtin\" >nul
+"%TEMP%\ccze_builtin\ccze.exe" --spans json "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"\"BRIGHT_BLACK\",\"rule\",24]" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] built-in rules colorize the timestamps like ccze.conf
+    set /a PASS+=1
+) else (
+    echo [FAIL] built-in rules missed the timestamps
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+rmdir /s /q "%TEMP%\ccze_builtin" >nul 2>&1
+
+REM Test 26: the path and number tokens are colorized by the word pass
+%CCZE% --spans json "%~dp0java.log" > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"\"path\",0]" "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    findstr /c:"\"number\",0]" "%TEMP%\ccze_actual.txt" >nul 2>&1
+    if errorlevel 1 (
+        echo [FAIL] no number spans from the word pass
+        set /a FAIL+=1
+    ) else (
+        echo [PASS] word pass finds paths and numbers
+        set /a PASS+=1
+    )
+) else (
+    echo [FAIL] no path spans from the word pass
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+
+REM Test 27: rules run over a chunk of lines give the same output as line by line
+%CCZE% -A "%~dp0java.log" > "%TEMP%\ccze_chunk.txt" 2>&1
+%CCZE% -A --record-start "^" "%~dp0java.log" > "%TEMP%\ccze_lines.txt" 2>&1
+fc /b "%TEMP%\ccze_chunk.txt" "%TEMP%\ccze_lines.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] chunked colorizing matches per-line colorizing
+    set /a PASS+=1
+) else (
+    echo [FAIL] chunked colorizing differs from per-line colorizing
+    fc "%TEMP%\ccze_chunk.txt" "%TEMP%\ccze_lines.txt"
+    set /a FAIL+=1
+)
+del "%TEMP%\ccze_chunk.txt" "%TEMP%\ccze_lines.txt" >nul 2>&1
+
+REM Test 28: -O inside -R is not scanned again, however the path is spelled
+rmdir /s /q "%TEMP%\ccze_batch" >nul 2>&1
+mkdir "%TEMP%\ccze_batch\in" >nul 2>&1
+copy /y "%~dp0java.log" "%TEMP%\ccze_batch\in\" >nul
+%CCZE% -R "%TEMP%\ccze_batch\in" -O "%TEMP%\ccze_batch\in\.\out\" -m ansi >nul 2>&1
+%CCZE% -R "%TEMP%\ccze_batch\in" -O "%TEMP%/ccze_batch/in/./out/" -m ansi > "%TEMP%\ccze_actual.txt" 2>&1
+findstr /c:"1 file," "%TEMP%\ccze_actual.txt" >nul 2>&1
+if %errorlevel%==0 (
+    echo [PASS] -R skips the output directory inside it
+    set /a PASS+=1
+) else (
+    echo [FAIL] -R colorized its own earlier output
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+rmdir /s /q "%TEMP%\ccze_batch" >nul 2>&1
+
+REM Test 29: -O naming the -R directory is refused and leaves the logs alone
+rmdir /s /q "%TEMP%\ccze_batch" >nul 2>&1
+mkdir "%TEMP%\ccze_batch" >nul 2>&1
+copy /y "%~dp0java.log" "%TEMP%\ccze_batch\" >nul
+%CCZE% -R "%TEMP%\ccze_batch" -O "%TEMP%\ccze_batch\.\" -m ansi > "%TEMP%\ccze_actual.txt" 2>&1
+if %errorlevel%==1 (
+    fc /b "%~dp0java.log" "%TEMP%\ccze_batch\java.log" >nul 2>&1
+    if errorlevel 1 (
+        echo [FAIL] -R wrote over its own input
+        set /a FAIL+=1
+    ) else (
+        echo [PASS] -O equal to -R is refused
+        set /a PASS+=1
+    )
+) else (
+    echo [FAIL] -O equal to -R was accepted
+    type "%TEMP%\ccze_actual.txt"
+    set /a FAIL+=1
+)
+rmdir /s /q "%TEMP%\ccze_batch" >nul 2>&1
+
 echo.
 echo Results: %PASS% passed, %FAIL% failed
 if %FAIL% GTR 0 exit /b 1
@@ -0,0 +1,107 @@
+/* ----------------------------------------------------------------
+ * conf2c - compile a rule file into C source (build step)
+ *
+ *   conf2c ccze.conf src\gen_rules.c
+ *
+ * Parses the rule file with the same loader ccze uses and writes a
+ * CczeBuiltin table named ccze_builtin: rule colors, tool commands,
+ * limits, and every pattern pre-compiled with pcre2_serialize_encode().
+ * A rule file with any error fails the build.
+ * ---------------------------------------------------------------- */
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rules.h"
+
+static void put_cstr(FILE *fp, const char *s) {
+    if (!s) {
+        fputs("NULL", fp);
+        return;
+    }
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+        else if (c == '\t') fputs("\\t", fp);
+        else if (c < 0x20 || c >= 0x7f) fprintf(fp, "\\%03o", c);
+        /* keep "??x" from being read as a trigraph */
+        else if (c == '?' && s[1] == '?') fputs("?\"\"", fp);
+        else fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+int main(int argc, char *argv[]) {
+    RuleLimits global;
+    Rule *rules, *r;
+    pcre2_code **codes;
+    uint8_t *bytes = NULL;
+    PCRE2_SIZE nbytes = 0;
+    int nerrors = 0, nrules = 0, i;
+    FILE *out;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: conf2c RULEFILE OUTPUT.c\n");
+        return 2;
+    }
+    rules = rules_load(argv[1], &global, &nerrors);
+    if (nerrors > 0) {
+        fprintf(stderr, "conf2c: %s: %d error%s\n", argv[1], nerrors, nerrors == 1 ? "" : "s");
+        rules_free(rules);
+        return 1;
+    }
+    for (r = rules; r; r = r->next) nrules++;
+
+    if (nrules > 0) {
+        codes = (pcre2_code **)malloc(nrules * sizeof(pcre2_code *));
+        for (r = rules, i = 0; r; r = r->next) codes[i++] = (pcre2_code *)r->re;
+        if (pcre2_serialize_encode((const pcre2_code **)codes, nrules, &bytes, &nbytes, NULL) < 0) {
+            fprintf(stderr, "conf2c: cannot serialize patterns\n");
+            return 1;
+        }
+        free(codes);
+    }
+
+    out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "conf2c: cannot write %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(out, "/* Generated from %s by tools/conf2c; do not edit. */\n", argv[1]);
+    fputs("#include \"libccze.h\"\n\n", out);
+
+    fputs("static const CczeBuiltinRule RULES[] = {\n", out);
+    for (r = rules; r; r = r->next) {
+        fprintf(out, "    { COL_%s, ", color_name(r->color));
+        put_cstr(out, r->type == RULE_TOOL ? r->tool_cmd : NULL);
+        fputs(", ", out);
+        put_cstr(out, r->pattern_src);
+        fprintf(out, ", %u, %u, %u },\n", r->limits.match, r->limits.depth, r->limits.heap);
+    }
+    if (nrules == 0) fputs("    { COL_RESET, NULL, \"\", 0, 0, 0 }\n", out);
+    fputs("};\n\n", out);
+
+    fputs("static const unsigned char CODE[] = {", out);
+    for (i = 0; i < (int)nbytes; i++)
+        fprintf(out, "%s0x%02x,", i % 16 ? " " : "\n    ", bytes[i]);
+    if (nbytes == 0) fputs("\n    0", out);
+    fputs("\n};\n\n", out);
+
+    fprintf(out, "const CczeBuiltin ccze_builtin = {\n"
+                 "    RULES, %d, %s, %u,\n"
+                 "    %u, %u, %u,\n"
+                 "    ",
+            nrules, nbytes ? "CODE" : "NULL", (unsigned)nbytes,
+            global.match, global.depth, global.heap);
+    put_cstr(out, argv[1]);
+    fputs("\n};\n", out);
+    fclose(out);
+
+    fprintf(stderr, "conf2c: %d rules, %u bytes of compiled patterns -> %s\n",
+            nrules, (unsigned)nbytes, argv[2]);
+    if (bytes) pcre2_serialize_free(bytes);
+    rules_free(rules);
+    return 0;
+}
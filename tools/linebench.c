@@ -0,0 +1,109 @@
+/* ----------------------------------------------------------------
+ * linebench - one giant line with and without line threads
+ *
+ *   linebench [MB] [RULEFILE] [THREADS]
+ *
+ * Builds a single line of MB megabytes (default 50) of minified JSON,
+ * like an API response captured in a log, and colorizes it with the
+ * rules in RULEFILE (default ccze.conf) on 1, 2, 4, ... up to THREADS
+ * (default 8) line threads. Prints the time and throughput of each run
+ * and whether its spans are the same as with one thread.
+ * ---------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libccze.h"
+
+static const char *NAMES[] = {
+    "id", "name", "status", "message", "url", "created_at", "user", "email", "path",
+    "level", "error", "count", "enabled", "tags", "duration_ms", "host", "region",
+};
+#define NNAMES (sizeof(NAMES) / sizeof(NAMES[0]))
+
+static const char *VALUES[] = {
+    "\"ok\"", "\"failed\"", "\"connection refused\"", "\"https://api.example.com/v2/items?page=3\"",
+    "\"/var/lib/app/data.db\"", "\"2024-03-01T12:34:56.789Z\"", "\"warning: disk almost full\"",
+    "\"alice@example.com\"", "\"10.0.12.7\"", "true", "false", "null", "[\"a\",\"b\",\"c\"]",
+    "\"ERROR timeout after 30s\"", "\"GET /index.html 200\"", "\"eu-west-1\"",
+};
+#define NVALUES (sizeof(VALUES) / sizeof(VALUES[0]))
+
+static unsigned seed = 1;
+
+static unsigned rnd(unsigned n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static char *make_line(size_t target, size_t *lenp) {
+    char *text = (char *)malloc(target + 1024);
+    size_t len = 0;
+    text[len++] = '[';
+    while (len < target) {
+        int fields = 4 + (int)rnd(8), f;
+        text[len++] = '{';
+        for (f = 0; f < fields; f++) {
+            const char *name = NAMES[rnd(NNAMES)];
+            if (rnd(3) == 0)
+                len += sprintf(text + len, "\"%s\":%u", name, rnd(100000));
+            else
+                len += sprintf(text + len, "\"%s\":%s", name, VALUES[rnd(NVALUES)]);
+            text[len++] = f + 1 < fields ? ',' : '}';
+        }
+        text[len++] = ',';
+    }
+    text[len - 1] = ']';
+    text[len++] = '\n';
+    *lenp = len;
+    return text;
+}
+
+static void hash_span(const char *buf, const CczeSpan *sp, void *ud) {
+    unsigned long long *h = (unsigned long long *)ud;
+    (void)buf;
+    *h = (*h ^ sp->offset) * 1099511628211ULL;
+    *h = (*h ^ sp->length) * 1099511628211ULL;
+    *h = (*h ^ (unsigned)sp->color) * 1099511628211ULL;
+    *h = (*h ^ (unsigned)sp->rule_id) * 1099511628211ULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    size_t target = (size_t)(argc > 1 ? atoi(argv[1]) : 50) << 20, len;
+    const char *rcfile = argc > 2 ? argv[2] : "ccze.conf";
+    int max_threads = argc > 3 ? atoi(argv[3]) : 8, threads;
+    unsigned long long first = 0;
+    double base = 0;
+    char *text = make_line(target, &len);
+
+    printf("%7s %9s %10s %8s %6s\n", "threads", "time", "rate", "speedup", "spans");
+    for (threads = 1; threads <= max_threads; threads *= 2) {
+        CczeConfig cfg;
+        Ccze *h;
+        unsigned long long hash = 14695981039346656037ULL;
+        double t0, secs;
+
+        ccze_config_init(&cfg);
+        cfg.rcfile = rcfile;
+        cfg.line_threads = threads;
+        h = ccze_open(&cfg);
+        t0 = now();
+        ccze_colorize(h, text, len, hash_span, &hash);
+        secs = now() - t0;
+        ccze_close(h);
+        if (threads == 1) {
+            first = hash;
+            base = secs;
+        }
+        printf("%7d %7.2f s %5.1f MB/s %7.2fx %6s\n", threads, secs, len / 1048576.0 / secs,
+               base / secs, hash == first ? "same" : "DIFFER");
+    }
+    free(text);
+    return 0;
+}
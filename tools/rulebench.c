@@ -0,0 +1,145 @@
+/* ----------------------------------------------------------------
+ * rulebench - how line cost grows with the number of rules, with and
+ * without the rule automaton (-o automaton)
+ *
+ *   rulebench [MB]
+ *
+ * For 50, 200 and 1000 generated rules (keyword lists, codes, key=value
+ * pairs, quoted strings, durations, and every 25th rule one with a
+ * lookahead, which the automaton takes to hold), writes the rules to
+ * rulebench.conf in the current directory, colorizes MB megabytes
+ * (default 16) of generated log lines one line at a time, and prints
+ * the time to open the rule set and the throughput each way.
+ * ---------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libccze.h"
+
+#define NVOCAB 4000
+#define CONF   "rulebench.conf"
+
+static char vocab[NVOCAB][12];
+static unsigned seed = 1;
+
+static unsigned rnd(unsigned n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static const char *word(void) { return vocab[rnd(NVOCAB)]; }
+
+static void make_vocab(void) {
+    static const char *syl[] = { "ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo", "ze", "an",
+                                 "el", "or", "us", "ix", "qu", "br", "st", "pl" };
+    int i, k;
+    for (i = 0; i < NVOCAB; i++) {
+        int n = 2 + (int)rnd(3);
+        vocab[i][0] = '\0';
+        for (k = 0; k < n; k++) strcat(vocab[i], syl[rnd(sizeof(syl) / sizeof(syl[0]))]);
+    }
+}
+
+static void write_rules(int n) {
+    FILE *fp = fopen(CONF, "w");
+    int i;
+    for (i = 0; i < n; i++) {
+        if (i % 25 == 24) {
+            fprintf(fp, "color CYAN \\b%s(?=:)\n", word());
+            continue;
+        }
+        switch (i % 6) {
+        case 0: fprintf(fp, "color RED \\b(?:%s|%s|%s)\\b\n", word(), word(), word()); break;
+        case 1: fprintf(fp, "color YELLOW \\b%c%c-\\d{3,5}\\b\n", 'A' + rnd(26), 'A' + rnd(26)); break;
+        case 2: fprintf(fp, "color GREEN \\b%s=\\S+\n", word()); break;
+        case 3: fprintf(fp, "color MAGENTA \"[^\"]*%s[^\"]*\"\n", word()); break;
+        case 4: fprintf(fp, "color BLUE \\b%s\\s+\\d+(?:\\.\\d+)?\\s*(?:ms|s)\\b\n", word()); break;
+        case 5: fprintf(fp, "color WHITE (?i)\\b%s\\b\n", word()); break;
+        }
+    }
+    fclose(fp);
+}
+
+/* 1 MB of lines of 6-14 words, some as key=value, codes or durations */
+static char *make_text(size_t *lenp) {
+    size_t cap = 1 << 20, len = 0;
+    char *text = (char *)malloc(cap);
+    while (len < cap - 512) {
+        int n = 6 + (int)rnd(9), w;
+        for (w = 0; w < n; w++) {
+            switch (rnd(10)) {
+            case 0: len += sprintf(text + len, "%s=%u", word(), rnd(1000)); break;
+            case 1: len += sprintf(text + len, "%c%c-%u", 'A' + rnd(26), 'A' + rnd(26), 100 + rnd(90000)); break;
+            case 2: len += sprintf(text + len, "%s %u ms", word(), rnd(5000)); break;
+            case 3: len += sprintf(text + len, "\"%s %s\"", word(), word()); break;
+            default: len += sprintf(text + len, "%s", word()); break;
+            }
+            text[len++] = w + 1 < n ? ' ' : '\n';
+        }
+    }
+    *lenp = len;
+    return text;
+}
+
+static void count_span(const char *buf, const CczeSpan *sp, void *ud) {
+    (void)buf;
+    (void)sp;
+    (*(unsigned long long *)ud)++;
+}
+
+static double run(const char *text, size_t len, size_t target, int automaton, double *open_secs,
+                  unsigned long long *spans) {
+    CczeConfig cfg;
+    Ccze *h;
+    size_t done = 0;
+    clock_t t0;
+    double secs;
+
+    ccze_config_init(&cfg);
+    cfg.rcfile = CONF;
+    cfg.wordcolor = 0;
+    cfg.automaton = automaton;
+    t0 = clock();
+    h = ccze_open(&cfg);
+    *open_secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    *spans = 0;
+    t0 = clock();
+    while (done < target) {
+        size_t off = 0;
+        while (off < len) {
+            const char *nl = (const char *)memchr(text + off, '\n', len - off);
+            size_t n = (size_t)(nl - (text + off)) + 1;
+            ccze_colorize(h, text + off, n, count_span, spans);
+            off += n;
+        }
+        done += len;
+    }
+    secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    ccze_close(h);
+    return done / 1048576.0 / secs;
+}
+
+int main(int argc, char *argv[]) {
+    static const int counts[] = { 50, 200, 1000 };
+    size_t target = (size_t)(argc > 1 ? atoi(argv[1]) : 16) << 20, len;
+    char *text;
+    int i;
+
+    make_vocab();
+    text = make_text(&len);
+    printf("%6s %10s %10s %10s %10s\n", "rules", "pcre2", "automaton", "open", "spans");
+    for (i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++) {
+        double plain, fast, open_plain, open_fast;
+        unsigned long long spans_plain, spans_fast;
+        write_rules(counts[i]);
+        plain = run(text, len, target, 0, &open_plain, &spans_plain);
+        fast = run(text, len, target, 1, &open_fast, &spans_fast);
+        printf("%6d %6.1f MB/s %6.1f MB/s %8.3f s %10s\n", counts[i], plain, fast, open_fast,
+               spans_plain == spans_fast ? "same" : "DIFFER");
+    }
+    remove(CONF);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* ----------------------------------------------------------------
+ * wordbench - microbenchmark for wordcolor (keywords, paths, URIs,
+ * numbers in text no rule matched)
+ *
+ *   wordbench [MB] [RULEFILE]
+ *
+ * Colorizes MB megabytes (default 64) of generated, wordcolor-heavy log
+ * lines through libccze, with no rules unless RULEFILE is given, and
+ * prints the throughput and the number of spans of each kind.
+ * ---------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libccze.h"
+
+static const char *WORDS[] = {
+    "Starting", "service", "connection", "failed", "error", "warning:", "ready",
+    "listening", "on", "port", "8080", "disabled", "the", "request", "timeout",
+    "/var/log/app.log", "http://example.com/api/v1", "user_id=42", "Done.",
+    "cannot", "open", "file", "12345", "cpu0:", "offline", "completed", "in",
+    "ms", "retrying", "-", "pci", "0x1f", "session", "closed", "by", "peer",
+    "sha256:9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08",
+};
+#define NWORDS (sizeof(WORDS) / sizeof(WORDS[0]))
+
+static unsigned long long kinds[CCZE_SPAN_ANSI + 1];
+
+static void count_span(const char *buf, const CczeSpan *sp, void *ud) {
+    (void)buf;
+    (void)ud;
+    kinds[sp->kind]++;
+}
+
+int main(int argc, char *argv[]) {
+    size_t target = (size_t)(argc > 1 ? atoi(argv[1]) : 64) << 20;
+    size_t cap = 1 << 20, len = 0, done = 0;
+    unsigned seed = 1;
+    char *text = (char *)malloc(cap);
+    CczeConfig cfg;
+    Ccze *h;
+    clock_t t0;
+    double secs;
+    int k;
+
+    /* 1 MB of lines of 8-20 words, replayed until target bytes are done */
+    while (len < cap - 256) {
+        int n = 8 + (int)((seed = seed * 1103515245 + 12345) >> 16) % 13, w;
+        for (w = 0; w < n; w++) {
+            const char *word = WORDS[((seed = seed * 1103515245 + 12345) >> 16) % NWORDS];
+            size_t wl = strlen(word);
+            memcpy(text + len, word, wl);
+            len += wl;
+            text[len++] = w + 1 < n ? ' ' : '\n';
+        }
+    }
+
+    ccze_config_init(&cfg);
+    cfg.rcfile = argc > 2 ? argv[2] : NULL;
+    h = ccze_open(&cfg);
+
+    t0 = clock();
+    while (done < target) {
+        size_t off = 0;
+        while (off < len) {
+            const char *nl = (const char *)memchr(text + off, '\n', len - off);
+            size_t n = (size_t)(nl - (text + off)) + 1;
+            ccze_colorize(h, text + off, n, count_span, NULL);
+            off += n;
+        }
+        done += len;
+    }
+    secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    printf("%.1f MB in %.3f s: %.1f MB/s (%d rules)\n",
+           done / 1048576.0, secs, done / 1048576.0 / secs, ccze_rule_count(h));
+    for (k = 0; k <= CCZE_SPAN_ANSI; k++)
+        if (kinds[k]) printf("  %-8s %llu\n", ccze_span_kind_name((CczeSpanKind)k), kinds[k]);
+    ccze_close(h);
+    free(text);
+    return 0;
+}